@@ -2,7 +2,51 @@
 
 mkdir -p bin
 
-gcc -Wall -Wextra -Wpedantic -g -o bin/main src/*.c src/chess/*.c -lm -lSDL2 -lSDL2_image -lSDL2_ttf -std=c11
+# Attack / ray lookup tables for the move generator
+gcc -Wall -Wextra -Wpedantic -g -std=c11 -o bin/gen_tables src/tools/gen_tables.c || exit 1
+./bin/gen_tables src/chess/tables.h src/chess/tables.c || exit 1
+
+# Sprite sheet and font glyphs baked into the binaries, the GUI doesn't read or decode files at startup
+gcc -Wall -Wextra -Wpedantic -g -std=c11 -o bin/gen_assets src/tools/gen_assets.c -lSDL2 -lSDL2_image -lSDL2_ttf || exit 1
+./bin/gen_assets src/assets src/embedded_assets.h src/embedded_assets.c || exit 1
+
+# Extra flags, e.g. CFLAGS="-DCHESS_STATS" ./build.sh to compile in the move generator counters,
+# CFLAGS="-DENGINE_STATS" to time move generation and evaluation in the search statistics (stats=<file>)
+# or CFLAGS="-O2 -march=native" to use the AVX2 NNUE kernels (SSE2 / scalar otherwise) and the SSSE3
+# packed position codec
+gcc -Wall -Wextra -Wpedantic -g -o bin/main src/*.c src/chess/*.c src/engine/*.c -lm -lpthread -lSDL2 -std=c11 $CFLAGS
+
+# Headless tools, these only need the SDL headers
+TOOLS_FLAGS="-Wall -Wextra -Wpedantic -g -O2 -std=c11 $CFLAGS"
+TOOLS_SRC="src/arena.c src/chess/*.c src/engine/*.c"
+
+gcc $TOOLS_FLAGS -o bin/tournament src/tools/tournament.c $TOOLS_SRC -lm -lpthread
+gcc $TOOLS_FLAGS -o bin/analysisd src/tools/analysisd.c $TOOLS_SRC -lm -lpthread
+gcc $TOOLS_FLAGS -o bin/matesolve src/tools/matesolve.c $TOOLS_SRC -lm -lpthread
+gcc $TOOLS_FLAGS -o bin/perft src/tools/perft.c $TOOLS_SRC -lm -lpthread
+gcc $TOOLS_FLAGS -o bin/pgnindex src/tools/pgnindex.c $TOOLS_SRC -lm -lpthread
+gcc $TOOLS_FLAGS -o bin/broadcastd src/tools/broadcastd.c $TOOLS_SRC -lm -lpthread
+
+# Texel tuning, ./bin/tune --out src/chess/eval_params.h positions.epd and rebuild
+gcc $TOOLS_FLAGS -o bin/tune src/tools/tune.c $TOOLS_SRC -lm -lpthread
+
+# Self-play training data, ./bin/datagen --out data, see src/tools/datagen.c for the format
+gcc $TOOLS_FLAGS -o bin/datagen src/tools/datagen.c $TOOLS_SRC -lm -lpthread
+
+# Persistent analysis cache, ./bin/cachetool analyze analysis.cache --depth 8 (see src/tools/cachetool.c)
+gcc $TOOLS_FLAGS -o bin/cachetool src/tools/cachetool.c $TOOLS_SRC -lm -lpthread
+
+# Game host load test, ./bin/hostbench --games 50000 --threads 8
+gcc $TOOLS_FLAGS -o bin/hostbench src/tools/hostbench.c $TOOLS_SRC -lm -lpthread
+
+# Headless board images, this one needs the SDL libraries as well (SDL_image for the PNG output)
+gcc $TOOLS_FLAGS -o bin/thumbnail src/tools/thumbnail.c src/board_view.c src/embedded_assets.c $TOOLS_SRC -lm -lpthread -lSDL2 -lSDL2_image
+
+# Batch kernel against the core's move generator, ./bin/batchcheck --positions 100000
+gcc $TOOLS_FLAGS -o bin/batchcheck src/tools/batchcheck.c $TOOLS_SRC -lm -lpthread
+
+# bench/baseline.json was recorded with the default flags, ./bin/bench --baseline bench/baseline.json
+gcc $TOOLS_FLAGS -o bin/bench src/tools/bench.c $TOOLS_SRC -lm -lpthread
 
 if [[ -z $1 ]]; then
     ./bin/main
@@ -0,0 +1,145 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+
+// Called on the analysis thread for every finished iteration. A full result ring means the
+// render thread is behind, the result is dropped, a deeper one follows shortly.
+static void publish_result(const SearchResult *search, void *ctx) {
+    Analysis *analysis = ctx;
+
+    unsigned tail = atomic_load_explicit(&analysis->result_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&analysis->result_head, memory_order_acquire);
+
+    if (tail - head == ANALYSIS_RESULT_SLOTS) {
+        return;
+    }
+
+    AnalysisResult *result = &analysis->results[tail & (ANALYSIS_RESULT_SLOTS - 1)];
+
+    result->generation = analysis->generation;
+    result->depth = search->depth;
+    result->score = search->score;
+    result->side_to_move = analysis->engine->stack[0].current_turn;
+    result->nodes = search->nodes;
+    result->pv_length = search->pv_length < ANALYSIS_MAX_PV ? search->pv_length : ANALYSIS_MAX_PV;
+    memcpy(result->pv, search->pv, sizeof(Move) * result->pv_length);
+
+    atomic_store_explicit(&analysis->result_tail, tail + 1, memory_order_release);
+}
+
+static int analysis_thread(void *data) {
+    Analysis *analysis = data;
+
+    while (!atomic_load(&analysis->quit)) {
+        unsigned head = atomic_load_explicit(&analysis->request_head, memory_order_relaxed);
+
+        if (head == atomic_load_explicit(&analysis->request_tail, memory_order_acquire)) {
+            SDL_SemWait(analysis->wakeup);
+            continue;
+        }
+
+        // only the newest position matters, skip everything older
+        unsigned tail = atomic_load_explicit(&analysis->request_tail, memory_order_acquire);
+        AnalysisRequest *request = &analysis->requests[(tail - 1) & (ANALYSIS_REQUEST_SLOTS - 1)];
+
+        // The render thread publishes a request before setting cancel. If cancel is cleared
+        // after that, a newer request is visible below and we go around again.
+        atomic_store(&analysis->cancel, false);
+
+        if (atomic_load_explicit(&analysis->request_tail, memory_order_acquire) != tail) {
+            atomic_store_explicit(&analysis->request_head, tail, memory_order_release);
+            continue;
+        }
+
+        analysis->generation = request->generation;
+        analysis->chess.white_at_bottom = request->white_at_bottom;
+        // no analysis of positions the move generator can't handle (an unpromoted pawn on the last rank)
+        if (Chess_from_position(&analysis->chess, &request->position)) {
+            Engine_search(analysis->engine, &analysis->chess, NULL, 0);
+        }
+
+        atomic_store_explicit(&analysis->request_head, tail, memory_order_release);
+    }
+
+    return 0;
+}
+
+void Analysis_start(Analysis *analysis) {
+    memset(analysis, 0, sizeof(*analysis));
+
+    Engine_init_chess(&analysis->chess);
+
+    analysis->engine = Engine_new((EngineConfig){.name = "analysis", .depth = ANALYSIS_MAX_DEPTH, .hash_mb = 16});
+    analysis->engine->cancel = &analysis->cancel;
+    analysis->engine->on_iteration = publish_result;
+    analysis->engine->callback_ctx = analysis;
+
+    analysis->wakeup = SDL_CreateSemaphore(0);
+    analysis->thread = SDL_CreateThread(analysis_thread, "analysis", analysis);
+
+    if (analysis->wakeup == NULL || analysis->thread == NULL) {
+        printf("Failed to start the analysis thread. Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+}
+
+void Analysis_stop(Analysis *analysis) {
+    atomic_store(&analysis->quit, true);
+    atomic_store(&analysis->cancel, true);
+    SDL_SemPost(analysis->wakeup);
+    SDL_WaitThread(analysis->thread, NULL);
+    SDL_DestroySemaphore(analysis->wakeup);
+
+    Engine_free(analysis->engine);
+    Engine_free_chess(&analysis->chess);
+}
+
+// Render thread only. Hands a snapshot of chess to the analysis thread and cancels whatever it
+// is working on. Never blocks, returns false when the request ring is full, try again next frame.
+bool Analysis_request(Analysis *analysis, const Chess *chess) {
+    unsigned tail = atomic_load_explicit(&analysis->request_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&analysis->request_head, memory_order_acquire);
+
+    if (tail - head == ANALYSIS_REQUEST_SLOTS) {
+        atomic_store(&analysis->cancel, true);
+        return false;
+    }
+
+    AnalysisRequest *request = &analysis->requests[tail & (ANALYSIS_REQUEST_SLOTS - 1)];
+
+    Position_from_chess(&request->position, chess);
+    request->white_at_bottom = chess->white_at_bottom;
+    request->generation = tail + 1;
+
+    atomic_store_explicit(&analysis->request_tail, tail + 1, memory_order_release);
+    atomic_store(&analysis->cancel, true);
+    SDL_SemPost(analysis->wakeup);
+
+    return true;
+}
+
+// Render thread only. Returns the newest result for the latest request, if there is a new one
+bool Analysis_poll(Analysis *analysis, AnalysisResult *result) {
+    unsigned head = atomic_load_explicit(&analysis->result_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&analysis->result_tail, memory_order_acquire);
+    unsigned latest = atomic_load_explicit(&analysis->request_tail, memory_order_relaxed);
+
+    bool found = false;
+
+    for (; head != tail; head++) {
+        const AnalysisResult *slot = &analysis->results[head & (ANALYSIS_RESULT_SLOTS - 1)];
+
+        if (slot->generation == latest) {
+            *result = *slot;
+            found = true;
+        }
+    }
+
+    atomic_store_explicit(&analysis->result_head, head, memory_order_release);
+
+    return found;
+}
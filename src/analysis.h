@@ -0,0 +1,69 @@
+#include "engine/engine.h"
+#include <SDL2/SDL_thread.h>
+#include <stdatomic.h>
+
+#ifndef ANALYSIS
+#define ANALYSIS
+
+// both have to be powers of two
+#define ANALYSIS_REQUEST_SLOTS 4
+#define ANALYSIS_RESULT_SLOTS 32
+
+#define ANALYSIS_MAX_DEPTH 8
+#define ANALYSIS_MAX_PV 8
+
+struct _AnalysisResult {
+    // which request (see Analysis_request) this result belongs to
+    uint32_t generation;
+    int depth;
+    // from the point of view of the side to move in the analysed position
+    int score;
+    enum Color side_to_move;
+    uint64_t nodes;
+    int pv_length;
+    Move pv[ANALYSIS_MAX_PV];
+};
+typedef struct _AnalysisResult AnalysisResult;
+
+struct _AnalysisRequest {
+    uint32_t generation;
+    // the worker never touches the render thread's Chess, it rebuilds its own from this
+    Position position;
+    // so that result moves are in the GUI's board coordinates
+    bool white_at_bottom;
+};
+typedef struct _AnalysisRequest AnalysisRequest;
+
+// Background analysis of the GUI position. The render thread is the only producer of
+// requests and the only consumer of results, the analysis thread the other way around,
+// so both channels are lock free single producer / single consumer rings.
+struct _Analysis {
+    SDL_Thread *thread;
+    // only used to put the worker to sleep while there is nothing to analyse
+    SDL_sem *wakeup;
+
+    AnalysisRequest requests[ANALYSIS_REQUEST_SLOTS];
+    atomic_uint request_head;
+    atomic_uint request_tail;
+
+    AnalysisResult results[ANALYSIS_RESULT_SLOTS];
+    atomic_uint result_head;
+    atomic_uint result_tail;
+
+    // set by the render thread when the position changed, stops the running search
+    atomic_bool cancel;
+    atomic_bool quit;
+
+    uint32_t generation;
+    Engine *engine;
+    // analysis thread only, the position being searched
+    Chess chess;
+};
+typedef struct _Analysis Analysis;
+
+void Analysis_start(Analysis *analysis);
+void Analysis_stop(Analysis *analysis);
+bool Analysis_request(Analysis *analysis, const Chess *chess);
+bool Analysis_poll(Analysis *analysis, AnalysisResult *result);
+
+#endif // !ANALYSIS
@@ -35,7 +35,11 @@ void *arena_alloc(Arena *a, size_t n_bytes) {
         return NULL;
     }
 
+    void *ptr = (char *)a->ptr + a->allocated_bytes;
     a->allocated_bytes += n_bytes;
 
-    return (char *)a->ptr + a->allocated_bytes + n_bytes;
+    return ptr;
 }
+
+// Everything allocated from the arena so far is invalidated
+void arena_reset(Arena *a) { a->allocated_bytes = 0; }
@@ -12,5 +12,6 @@ typedef struct _Arena Arena;
 
 void *arena_alloc(Arena *a, size_t n_bytes);
 Arena arena_init(size_t n_bytes);
+void arena_reset(Arena *a);
 
 #endif // !ARENA
@@ -0,0 +1,223 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+#include "board_view.h"
+#include "embedded_assets.h"
+
+#define COLOR_BLACK ((SDL_Color){0, 0, 0, 255})
+#define COLOR_WHITE ((SDL_Color){255, 255, 255, 255})
+
+#define CAPTURE_TRIANGLE_COLOR ((SDL_Color){255, 0, 0, 150})
+
+bool BoardAssets_init(BoardAssets *assets) {
+    *assets = (BoardAssets){0};
+    // SDL only reads the pixels of a surface that is turned into textures
+    assets->sprites = SDL_CreateRGBSurfaceWithFormatFrom((void *)SpritesPixels, SPRITES_WIDTH, SPRITES_HEIGHT, 32, SPRITES_WIDTH * 4,
+                                                         SDL_PIXELFORMAT_RGBA32);
+
+    if (assets->sprites == NULL) {
+        printf("Failed to create sprites. Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    for (int i = 0; i < BOARD_VIEW_LABELS; i++) {
+        char buf[2];
+
+        if (i < CHESS_BOARD_COLS) {
+            snprintf(buf, 2, "%c", 'a' + i);
+        } else {
+            snprintf(buf, 2, "%d", BOARD_VIEW_LABELS - i);
+        }
+
+        assets->labels[0][i] = BoardAssets_text(buf, COLOR_BLACK);
+        assets->labels[1][i] = BoardAssets_text(buf, COLOR_WHITE);
+
+        if (assets->labels[0][i] == NULL || assets->labels[1][i] == NULL) {
+            printf("Failed to render labels. Error: %s\n", SDL_GetError());
+            BoardAssets_free(assets);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// One line of text from the embedded glyph atlas, characters outside of it are drawn as spaces.
+// No kerning, the glyphs are put next to each other
+SDL_Surface *BoardAssets_text(const char *text, SDL_Color color) {
+    int width = 0;
+
+    for (const char *c = text; *c != '\0'; c++) {
+        int glyph = *c >= GLYPH_FIRST && *c < GLYPH_FIRST + GLYPH_COUNT ? *c - GLYPH_FIRST : 0;
+        width += GlyphX[glyph + 1] - GlyphX[glyph];
+    }
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width > 0 ? width : 1, GLYPH_ATLAS_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+
+    if (surface == NULL) {
+        return NULL;
+    }
+
+    SDL_LockSurface(surface);
+
+    for (int row = 0; row < GLYPH_ATLAS_HEIGHT; row++) {
+        uint8_t *out = (uint8_t *)surface->pixels + (size_t)row * surface->pitch;
+        const uint8_t *coverage = GlyphAtlas + (size_t)row * GLYPH_ATLAS_WIDTH;
+
+        for (const char *c = text; *c != '\0'; c++) {
+            int glyph = *c >= GLYPH_FIRST && *c < GLYPH_FIRST + GLYPH_COUNT ? *c - GLYPH_FIRST : 0;
+
+            for (int x = GlyphX[glyph]; x < GlyphX[glyph + 1]; x++) {
+                *out++ = color.r;
+                *out++ = color.g;
+                *out++ = color.b;
+                *out++ = (uint8_t)(coverage[x] * color.a / 255);
+            }
+        }
+    }
+
+    SDL_UnlockSurface(surface);
+
+    return surface;
+}
+
+void BoardAssets_free(BoardAssets *assets) {
+    SDL_FreeSurface(assets->sprites);
+
+    for (int i = 0; i < BOARD_VIEW_LABELS; i++) {
+        SDL_FreeSurface(assets->labels[0][i]);
+        SDL_FreeSurface(assets->labels[1][i]);
+    }
+
+    *assets = (BoardAssets){0};
+}
+
+// Creating the textures converts the shared surfaces, views must not be initialised concurrently
+bool BoardView_init(BoardView *view, SDL_Renderer *renderer, const BoardAssets *assets, int cell_size) {
+    *view = (BoardView){.renderer = renderer, .cell_size = cell_size};
+    view->sprites = SDL_CreateTextureFromSurface(renderer, assets->sprites);
+
+    bool ok = view->sprites != NULL;
+
+    for (int i = 0; i < BOARD_VIEW_LABELS && ok; i++) {
+        view->labels[0][i] = SDL_CreateTextureFromSurface(renderer, assets->labels[0][i]);
+        view->labels[1][i] = SDL_CreateTextureFromSurface(renderer, assets->labels[1][i]);
+        ok = view->labels[0][i] != NULL && view->labels[1][i] != NULL;
+    }
+
+    if (!ok) {
+        printf("Failed to create board textures. Error: %s\n", SDL_GetError());
+        BoardView_free(view);
+    }
+
+    return ok;
+}
+
+void BoardView_free(BoardView *view) {
+    if (view->sprites != NULL) {
+        SDL_DestroyTexture(view->sprites);
+    }
+
+    for (int i = 0; i < BOARD_VIEW_LABELS; i++) {
+        for (int color = 0; color < 2; color++) {
+            if (view->labels[color][i] != NULL) {
+                SDL_DestroyTexture(view->labels[color][i]);
+            }
+        }
+    }
+
+    *view = (BoardView){0};
+}
+
+// Red triangles in the four corners of the cell at (x, y)
+void BoardView_capture_marker(BoardView *view, int x, int y) {
+    SDL_Vertex *v = view->vertices;
+    float left = (float)x, top = (float)y;
+    float size = (float)view->cell_size, triangle = view->cell_size / 5.f;
+
+    // top left
+    v[0] = (SDL_Vertex){{left, top}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[1] = (SDL_Vertex){{left + triangle, top}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[2] = (SDL_Vertex){{left, top + triangle}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+
+    // top right
+    v[3] = (SDL_Vertex){{left + size, top}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[4] = (SDL_Vertex){{left + size - triangle, top}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[5] = (SDL_Vertex){{left + size, top + triangle}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+
+    // bottom right
+    v[6] = (SDL_Vertex){{left + size, top + size}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[7] = (SDL_Vertex){{left + size - triangle, top + size}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[8] = (SDL_Vertex){{left + size, top + size - triangle}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+
+    // bottom left
+    v[9] = (SDL_Vertex){{left, top + size}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[10] = (SDL_Vertex){{left, top + size - triangle}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+    v[11] = (SDL_Vertex){{left + triangle, top + size}, CAPTURE_TRIANGLE_COLOR, {1, 1}};
+
+    if (SDL_RenderGeometry(view->renderer, NULL, v, 12, NULL, 0) != 0) {
+        printf("SDL_RenderGeometry error: %s\n", SDL_GetError());
+    }
+}
+
+// Board with its top left corner at (x, y). The highlighted cell gets a blue border,
+// (-1, -1) for none
+void BoardView_draw(BoardView *view, const Chess *game, int x, int y, Pos highlight) {
+    SDL_Renderer *renderer = view->renderer;
+    int cell_size = view->cell_size;
+    int font_size = cell_size / 5;
+    int border = cell_size / 24;
+
+    if (highlight.col != -1 && highlight.row != -1) {
+        SDL_Rect cell_dst = (SDL_Rect){.x = x + highlight.col * cell_size, .y = y + highlight.row * cell_size, .w = cell_size, .h = cell_size};
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
+        SDL_RenderFillRect(renderer, &cell_dst);
+    }
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Cell *cell = &game->board[row][col];
+            int cell_x = x + col * cell_size;
+            int cell_y = y + row * cell_size;
+
+            if (cell->color == ColorWhite) {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            } else {
+                SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+            }
+
+            SDL_Rect cell_dst = (SDL_Rect){.x = cell_x, .y = cell_y, .w = cell_size, .h = cell_size};
+
+            if (row == highlight.row && col == highlight.col) {
+                cell_dst.x += border;
+                cell_dst.y += border;
+                cell_dst.w -= 2 * border;
+                cell_dst.h -= 2 * border;
+            }
+
+            SDL_RenderFillRect(renderer, &cell_dst);
+
+            if (cell->piece.type != UndefPieceType) {
+                SDL_RenderCopy(renderer, view->sprites, &cell->piece.sprite_loc, &cell_dst);
+            }
+
+            if ((game->kingInCheck[ColorBlack] && Chess_is_piece(&cell->piece, King, ColorBlack)) ||
+                (game->kingInCheck[ColorWhite] && Chess_is_piece(&cell->piece, King, ColorWhite))) {
+                BoardView_capture_marker(view, cell_x, cell_y);
+            }
+
+            int text = cell->color == ColorWhite ? 0 : 1;
+
+            if (row == CHESS_BOARD_ROWS - 1) {
+                SDL_Rect label = {.x = cell_x + cell_size - font_size, .y = cell_y + cell_size - font_size * 2, .w = font_size, .h = font_size * 2};
+                SDL_RenderCopy(renderer, view->labels[text][col], NULL, &label);
+            }
+
+            if (col == 0) {
+                SDL_Rect label = {.x = cell_x, .y = cell_y + cell_size - font_size * 2, .w = font_size, .h = font_size * 2};
+                SDL_RenderCopy(renderer, view->labels[text][CHESS_BOARD_COLS + row], NULL, &label);
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#include "chess/chess.h"
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_surface.h>
+
+#ifndef BOARD_VIEW
+#define BOARD_VIEW
+
+// file letters a-h, then rank numbers 8-1
+#define BOARD_VIEW_LABELS (CHESS_BOARD_COLS + CHESS_BOARD_ROWS)
+
+// Built from the pixels embedded at build time (see src/tools/gen_assets.c) and shared by every
+// BoardView, read only after BoardAssets_init
+struct _BoardAssets {
+    // wraps the embedded pixels, nothing is copied
+    SDL_Surface *sprites;
+    // [0] black text for white cells, [1] white text for black cells
+    SDL_Surface *labels[2][BOARD_VIEW_LABELS];
+};
+typedef struct _BoardAssets BoardAssets;
+
+// Draws boards with one renderer, the window's or a software one on a surface. Sprites and
+// labels are turned into textures once, nothing is created while drawing.
+struct _BoardView {
+    SDL_Renderer *renderer;
+    SDL_Texture *sprites;
+    SDL_Texture *labels[2][BOARD_VIEW_LABELS];
+
+    int cell_size;
+    SDL_Vertex vertices[12];
+};
+typedef struct _BoardView BoardView;
+
+bool BoardAssets_init(BoardAssets *assets);
+void BoardAssets_free(BoardAssets *assets);
+SDL_Surface *BoardAssets_text(const char *text, SDL_Color color);
+
+bool BoardView_init(BoardView *view, SDL_Renderer *renderer, const BoardAssets *assets, int cell_size);
+void BoardView_free(BoardView *view);
+void BoardView_draw(BoardView *view, const Chess *game, int x, int y, Pos highlight);
+void BoardView_capture_marker(BoardView *view, int x, int y);
+
+#endif // !BOARD_VIEW
@@ -0,0 +1,350 @@
+#include "batch.h"
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// One lane per position, as many lanes as the target's vector registers hold. GCC lowers the
+// vector operators to AVX2 (-march=native), SSE2 or plain 64 bit code, so there is a single
+// kernel for every target.
+#if defined(__AVX2__)
+#define BATCH_VEC_LANES 4
+#else
+#define BATCH_VEC_LANES 2
+#endif
+
+typedef uint64_t BatchVec __attribute__((vector_size(BATCH_VEC_LANES * sizeof(uint64_t))));
+
+_Static_assert(CHESS_BATCH_WIDTH % BATCH_VEC_LANES == 0, "a block has to be a whole number of vectors");
+
+#define NOT_FILE_A 0xfefefefefefefefeull
+#define NOT_FILE_H 0x7f7f7f7f7f7f7f7full
+#define NOT_FILE_AB 0xfcfcfcfcfcfcfcfcull
+#define NOT_FILE_GH 0x3f3f3f3f3f3f3f3full
+#define ROW_5 0x0000ff0000000000ull
+
+#define SQUARE_BIT(row, col) (1ull << ((row) * CHESS_BOARD_COLS + (col)))
+
+static inline BatchVec load(const uint64_t *lanes) {
+    BatchVec v;
+    memcpy(&v, lanes, sizeof(v));
+    return v;
+}
+
+// all ones in the lanes where v != 0
+static inline BatchVec nonzero(BatchVec v) { return (BatchVec)(v != 0); }
+
+static inline BatchVec select(BatchVec mask, BatchVec a, BatchVec b) { return (mask & a) | (~mask & b); }
+
+static inline BatchVec popcount(BatchVec v) {
+#if BATCH_VEC_LANES == 4
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+    __m256i x = (__m256i)v;
+    __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+    __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+
+    return (BatchVec)_mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+#else
+    // bit counts per byte, then summed per lane
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+
+#if defined(__SSE2__)
+    return (BatchVec)_mm_sad_epu8((__m128i)v, _mm_setzero_si128());
+#else
+    return (v * 0x0101010101010101ull) >> 56;
+#endif
+#endif
+}
+
+// Shifts every square one step in direction, dropping what falls off the board
+static inline BatchVec shift(BatchVec b, enum RayDirection direction) {
+    switch (direction) {
+        case RayUp: return b >> 8;
+        case RayDown: return b << 8;
+        case RayRight: return (b << 1) & NOT_FILE_A;
+        case RayLeft: return (b >> 1) & NOT_FILE_H;
+        case RayUpRight: return (b >> 7) & NOT_FILE_A;
+        case RayUpLeft: return (b >> 9) & NOT_FILE_H;
+        case RayDownRight: return (b << 9) & NOT_FILE_A;
+        case RayDownLeft: return (b << 7) & NOT_FILE_H;
+    }
+
+    return b;
+}
+
+// Kogge-Stone: slides gen along direction through the empty squares. Returns the squares each
+// slider attacks, up to and including the first blocker.
+static inline BatchVec slide(BatchVec gen, BatchVec empty, enum RayDirection direction) {
+    static const int steps[8] = {[RayUp] = -8, [RayDown] = 8, [RayRight] = 1, [RayLeft] = -1,
+                                 [RayUpRight] = -7, [RayUpLeft] = -9, [RayDownRight] = 9, [RayDownLeft] = 7};
+
+    int step = steps[direction];
+
+    // wrapping around the board edge is stopped by the file masks in prop
+    BatchVec prop = empty;
+
+    if (step == 1 || step == 9 || step == -7) {
+        prop &= NOT_FILE_A;
+    } else if (step == -1 || step == -9 || step == 7) {
+        prop &= NOT_FILE_H;
+    }
+
+    for (int n = 1; n <= 4; n *= 2) {
+        int amount = step * n;
+
+        gen |= prop & (amount > 0 ? gen << amount : gen >> -amount);
+        prop &= amount > 0 ? prop << amount : prop >> -amount;
+    }
+
+    return shift(gen, direction);
+}
+
+static inline BatchVec knight_jumps(BatchVec b, int jump) {
+    switch (jump) {
+        case 0: return (b >> 17) & NOT_FILE_H;
+        case 1: return (b >> 15) & NOT_FILE_A;
+        case 2: return (b >> 10) & NOT_FILE_GH;
+        case 3: return (b >> 6) & NOT_FILE_AB;
+        case 4: return (b << 17) & NOT_FILE_A;
+        case 5: return (b << 15) & NOT_FILE_H;
+        case 6: return (b << 10) & NOT_FILE_AB;
+        default: return (b << 6) & NOT_FILE_GH;
+    }
+}
+
+static inline BatchVec knight_attacks(BatchVec b) {
+    BatchVec attacks = {0};
+
+    for (int jump = 0; jump < 8; jump++) {
+        attacks |= knight_jumps(b, jump);
+    }
+
+    return attacks;
+}
+
+static inline BatchVec king_attacks(BatchVec b) {
+    BatchVec attacks = {0};
+
+    for (int direction = 0; direction < 8; direction++) {
+        attacks |= shift(b, direction);
+    }
+
+    return attacks;
+}
+
+// pawns_move_up: ours, otherwise theirs (the board is flipped for black)
+static inline BatchVec pawn_attacks(BatchVec pawns, bool pawns_move_up) {
+    return pawns_move_up ? shift(pawns, RayUpLeft) | shift(pawns, RayUpRight) : shift(pawns, RayDownLeft) | shift(pawns, RayDownRight);
+}
+
+static inline BatchVec attacks_of(const BatchVec *pieces, BatchVec empty, bool pawns_move_up) {
+    BatchVec straight = pieces[Rook] | pieces[Queen];
+    BatchVec diagonal = pieces[Bishop] | pieces[Queen];
+
+    BatchVec attacks = pawn_attacks(pieces[Pawn], pawns_move_up) | knight_attacks(pieces[Knight]) | king_attacks(pieces[King]);
+
+    for (int direction = 0; direction < 8; direction++) {
+        attacks |= slide(RAY_IS_STRAIGHT(direction) ? straight : diagonal, empty, direction);
+    }
+
+    return attacks;
+}
+
+// Pieces to move and the squares they may go to
+struct Movers {
+    BatchVec pieces[PIECE_TYPE_COUNT];
+    BatchVec targets;
+};
+
+// Number of moves of everything in movers except the king. Every (piece set, direction) pair
+// maps origins to distinct destinations, so popcounts of the shifted sets count the moves.
+static inline BatchVec count_moves(const struct Movers *movers, BatchVec empty, BatchVec them) {
+    BatchVec count = {0};
+    BatchVec targets = movers->targets;
+
+    BatchVec pawns = movers->pieces[Pawn];
+    BatchVec push = shift(pawns, RayUp) & empty;
+    BatchVec double_push = shift(push & ROW_5, RayUp) & empty & targets;
+    BatchVec captures[2] = {shift(pawns, RayUpLeft) & them & targets, shift(pawns, RayUpRight) & them & targets};
+
+    push &= targets;
+
+    // promotions count once, like any other move
+    count += popcount(push) + popcount(double_push) + popcount(captures[0]) + popcount(captures[1]);
+
+    for (int jump = 0; jump < 8; jump++) {
+        count += popcount(knight_jumps(movers->pieces[Knight], jump) & targets);
+    }
+
+    BatchVec straight = movers->pieces[Rook] | movers->pieces[Queen];
+    BatchVec diagonal = movers->pieces[Bishop] | movers->pieces[Queen];
+
+    for (int direction = 0; direction < 8; direction++) {
+        count += popcount(slide(RAY_IS_STRAIGHT(direction) ? straight : diagonal, empty, direction) & targets);
+    }
+
+    return count;
+}
+
+void Batch_load_block(PositionBlock *block, const Position *positions, int count) {
+    memset(block, 0, sizeof(*block));
+    block->count = count;
+
+    for (int lane = 0; lane < count; lane++) {
+        const Position *position = &positions[lane];
+        enum Color us = position->side_to_move;
+
+        // by square code (see POSITION_SQUARE), [0] collects the empty squares
+        uint64_t boards[16] = {0};
+
+        for (int square = 0; square < CHESS_BOARD_ROWS * CHESS_BOARD_COLS; square++) {
+            boards[position->squares[square]] |= 1ull << square;
+        }
+
+        for (int type = King; type <= Pawn; type++) {
+            block->us[type][lane] = boards[POSITION_SQUARE(type, us)];
+            block->them[type][lane] = boards[POSITION_SQUARE(type, 1 - us)];
+            block->us[UndefPieceType][lane] |= block->us[type][lane];
+            block->them[UndefPieceType][lane] |= block->them[type][lane];
+        }
+
+        uint8_t rights = position->castling >> (us * 2);
+
+        block->castle_rooks[lane] = (rights & POSITION_CASTLE_KING_SIDE ? SQUARE_BIT(7, 7) : 0) | (rights & POSITION_CASTLE_QUEEN_SIDE ? SQUARE_BIT(7, 0) : 0);
+        block->side_to_move[lane] = us;
+
+        // black plays up the board too
+        if (us == ColorBlack) {
+            for (int type = 0; type < PIECE_TYPE_COUNT; type++) {
+                block->us[type][lane] = __builtin_bswap64(block->us[type][lane]);
+                block->them[type][lane] = __builtin_bswap64(block->them[type][lane]);
+            }
+        }
+    }
+}
+
+// Lanes first .. first + BATCH_VEC_LANES - 1 of block
+static void analyze_lanes(const PositionBlock *block, int first, BatchInfo *out) {
+    BatchVec us[PIECE_TYPE_COUNT], them[PIECE_TYPE_COUNT];
+
+    for (int type = 0; type < PIECE_TYPE_COUNT; type++) {
+        us[type] = load(&block->us[type][first]);
+        them[type] = load(&block->them[type][first]);
+    }
+
+    BatchVec ours = us[UndefPieceType];
+    BatchVec theirs = them[UndefPieceType];
+    BatchVec king = us[King];
+    BatchVec empty = ~(ours | theirs);
+
+    BatchVec their_straight = them[Rook] | them[Queen];
+    BatchVec their_diagonal = them[Bishop] | them[Queen];
+
+    BatchVec our_attacks = attacks_of(us, empty, true);
+    BatchVec their_attacks = attacks_of(them, empty, false);
+
+    // Checks and pins, looking out from our king. pin_lines / pinned are per line through the
+    // king (up / down, left / right and the two diagonals): pinned pieces may only move along it
+    BatchVec checkers = (knight_attacks(king) & them[Knight]) | (pawn_attacks(king, true) & them[Pawn]);
+    BatchVec check_rays = {0};
+    BatchVec behind_king = {0};
+    BatchVec pinned[4] = {{0}};
+    BatchVec pin_lines[4] = {{0}};
+
+    for (int direction = 0; direction < 8; direction++) {
+        BatchVec sliders = RAY_IS_STRAIGHT(direction) ? their_straight : their_diagonal;
+        BatchVec ray = slide(king, empty, direction);
+        BatchVec checker = ray & sliders;
+        BatchVec checked = nonzero(checker);
+
+        checkers |= checker;
+        check_rays |= ray & checked;
+        // stepping back along the checking ray is still check
+        behind_king |= shift(king, RAY_OPPOSITE(direction)) & checked;
+
+        BatchVec blocker = ray & ours;
+        BatchVec beyond = slide(blocker, empty, direction);
+        BatchVec is_pinned = nonzero(beyond & sliders) & nonzero(blocker);
+        int line = (direction & 1) | ((direction & 4) >> 1);
+
+        pinned[line] |= blocker & is_pinned;
+        pin_lines[line] |= (ray | beyond) & is_pinned;
+    }
+
+    // no check: anywhere, one: capture or block, two: only the king moves
+    BatchVec in_check = nonzero(checkers);
+    BatchVec double_check = nonzero(checkers & (checkers - 1));
+    BatchVec check_mask = select(in_check, (checkers | check_rays) & ~double_check, ~(BatchVec){0});
+
+    struct Movers movers = {.targets = ~ours & check_mask};
+    BatchVec all_pinned = pinned[0] | pinned[1] | pinned[2] | pinned[3];
+
+    for (int type = Queen; type <= Pawn; type++) {
+        movers.pieces[type] = us[type] & ~all_pinned;
+    }
+
+    BatchVec legal_moves = count_moves(&movers, empty, theirs);
+
+    for (int line = 0; line < 4; line++) {
+        struct Movers pinned_movers = {.targets = movers.targets & pin_lines[line]};
+
+        for (int type = Queen; type <= Pawn; type++) {
+            pinned_movers.pieces[type] = us[type] & pinned[line];
+        }
+
+        legal_moves += count_moves(&pinned_movers, empty, theirs);
+    }
+
+    // their_attacks stops at our king, behind_king covers the squares it would uncover
+    BatchVec king_targets = king_attacks(king) & ~ours & ~their_attacks & ~behind_king;
+    legal_moves += popcount(king_targets);
+
+    // Castling: king and rook in place, nothing in between, not out of, through or into check
+    BatchVec castle_rooks = load(&block->castle_rooks[first]) & us[Rook];
+    BatchVec can_castle = nonzero(king & SQUARE_BIT(7, 4)) & ~in_check;
+    BatchVec king_side = nonzero(castle_rooks & SQUARE_BIT(7, 7));
+    BatchVec queen_side = nonzero(castle_rooks & SQUARE_BIT(7, 0));
+
+    king_side &= ~nonzero((SQUARE_BIT(7, 5) | SQUARE_BIT(7, 6)) & (~empty | their_attacks));
+    queen_side &= ~nonzero((SQUARE_BIT(7, 1) | SQUARE_BIT(7, 2) | SQUARE_BIT(7, 3)) & ~empty);
+    queen_side &= ~nonzero((SQUARE_BIT(7, 2) | SQUARE_BIT(7, 3)) & their_attacks);
+
+    legal_moves += (king_side & can_castle & 1) + (queen_side & can_castle & 1);
+
+    for (int lane = 0; lane < BATCH_VEC_LANES && first + lane < block->count; lane++) {
+        enum Color side = block->side_to_move[first + lane];
+        bool flipped = side == ColorBlack;
+
+        out[lane] = (BatchInfo){
+            .checkers = flipped ? __builtin_bswap64(checkers[lane]) : checkers[lane],
+            .in_check = in_check[lane] != 0,
+            .legal_moves = (int)legal_moves[lane],
+        };
+
+        out[lane].attacks[side] = flipped ? __builtin_bswap64(our_attacks[lane]) : our_attacks[lane];
+        out[lane].attacks[1 - side] = flipped ? __builtin_bswap64(their_attacks[lane]) : their_attacks[lane];
+    }
+}
+
+void Batch_analyze_block(const PositionBlock *block, BatchInfo *out) {
+    for (int first = 0; first < block->count; first += BATCH_VEC_LANES) {
+        analyze_lanes(block, first, out + first);
+    }
+}
+
+// Convenience wrapper over the block API for positions in an array
+void Batch_analyze(const Position *positions, size_t count, BatchInfo *out) {
+    PositionBlock block;
+
+    for (size_t i = 0; i < count; i += CHESS_BATCH_WIDTH) {
+        int n = count - i < CHESS_BATCH_WIDTH ? (int)(count - i) : CHESS_BATCH_WIDTH;
+
+        Batch_load_block(&block, positions + i, n);
+        Batch_analyze_block(&block, out + i);
+    }
+}
@@ -0,0 +1,40 @@
+#include "chess.h"
+#include <stdint.h>
+
+#ifndef CHESS_BATCH__
+#define CHESS_BATCH__
+
+// Positions handled per kernel call, one 64 bit lane each (a single AVX2 register)
+#define CHESS_BATCH_WIDTH 4
+
+// CHESS_BATCH_WIDTH positions in structure of arrays layout, as bitboards over the Position
+// squares (bit 0 = a8 ... bit 63 = h1). Boards with black to move are flipped vertically, so the
+// side to move always plays up the board and every lane runs the same instructions.
+struct _PositionBlock {
+    // [UndefPieceType] = all pieces of that side
+    uint64_t us[PIECE_TYPE_COUNT][CHESS_BATCH_WIDTH];
+    uint64_t them[PIECE_TYPE_COUNT][CHESS_BATCH_WIDTH];
+    // our rooks that still have their castling right
+    uint64_t castle_rooks[CHESS_BATCH_WIDTH];
+    enum Color side_to_move[CHESS_BATCH_WIDTH];
+    int count;
+};
+typedef struct _PositionBlock PositionBlock;
+
+struct _BatchInfo {
+    // squares attacked by [color], over the Position squares
+    uint64_t attacks[2];
+    // pieces giving check to the side to move
+    uint64_t checkers;
+    bool in_check;
+    // Legal moves of the side to move. A promotion counts as one move (there is no piece choice
+    // in the move generator) and en passant isn't counted (Position has no ep square)
+    int legal_moves;
+};
+typedef struct _BatchInfo BatchInfo;
+
+void Batch_load_block(PositionBlock *block, const Position *positions, int count);
+void Batch_analyze_block(const PositionBlock *block, BatchInfo *out);
+void Batch_analyze(const Position *positions, size_t count, BatchInfo *out);
+
+#endif // !CHESS_BATCH__
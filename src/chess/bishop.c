@@ -10,12 +10,12 @@ void Chess_calculate_bishop_moves(Chess *game, Piece *piece, int num_moves) {
     }
 
     // Top Right
-    process_moves(game, piece, -1, 1);
+    process_moves(game, piece, RayUpRight);
     // Top Left
-    process_moves(game, piece, -1, -1);
+    process_moves(game, piece, RayUpLeft);
     // Bottom Right
-    process_moves(game, piece, 1, 1);
+    process_moves(game, piece, RayDownRight);
     // Bottom Left
-    process_moves(game, piece, 1, -1);
+    process_moves(game, piece, RayDownLeft);
 }
 
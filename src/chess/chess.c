@@ -1,6 +1,8 @@
 #include "chess.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 Piece *Chess_find_piece(Chess *game, enum PieceType type, enum Color pieceColor) {
     for (int i = 0; i < CHESS_BOARD_ROWS; i++) {
@@ -14,7 +16,18 @@ Piece *Chess_find_piece(Chess *game, enum PieceType type, enum Color pieceColor)
     return NULL;
 }
 
-bool Chess_is_piece(Piece *piece, enum PieceType type, enum Color pieceColor) { return piece->color == pieceColor && piece->type == type; }
+bool Chess_is_piece(const Piece *piece, enum PieceType type, enum Color pieceColor) { return piece->color == pieceColor && piece->type == type; }
+
+// Seeds the state that Chess_make_move keeps up to date from the pieces on the board
+static void init_incremental_state(Chess *chess) {
+    Chess_eval_init(chess);
+
+    // refreshed lazily on the first NNUE evaluation
+    chess->nnue.computed[ColorBlack] = false;
+    chess->nnue.computed[ColorWhite] = false;
+
+    chess->hash = Chess_hash_compute(chess);
+}
 
 void Chess_init_board(Chess *chess) {
     for (size_t row = 0; row < CHESS_BOARD_ROWS; row++) {
@@ -56,4 +69,358 @@ void Chess_init_board(Chess *chess) {
         PUT_PIECE(chess->board, white_pawn_row, i, Pawn, ColorWhite, 5);
         PUT_PIECE(chess->board, black_pawn_row, i, Pawn, ColorBlack, 11);
     }
+
+    init_incremental_state(chess);
+}
+
+// Piece type / color -> sprite number, see PUT_PIECE
+static inline int sprite_number(enum PieceType type, enum Color color) {
+    static const int white_sprites[7] = {0, 0, 1, 4, 2, 3, 5};
+
+    return white_sprites[type] + (color == ColorBlack ? SPRITE_SHEET_COLS : 0);
+}
+
+// Empties the board for Chess_load_fen / Chess_from_position. The arena is reset, so move lists
+// have to be recalculated afterwards
+static void clear_board(Chess *chess) {
+    arena_reset(&chess->arena);
+
+    chess->clicked_piece = NULL;
+    chess->kingInCheck[0] = chess->kingInCheck[1] = NULL;
+    chess->only_available_white_moves = chess->only_available_black_moves = NULL;
+    chess->num_available_white_moves = chess->num_available_black_moves = 0;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            chess->board[row][col] = (Cell){.color = (row + col) % 2 == 0 ? ColorWhite : ColorBlack};
+            chess->board[row][col].piece.pos = (Pos){row, col};
+        }
+    }
+}
+
+static void put_piece(Chess *chess, int row, int col, enum PieceType type, enum Color color) {
+    PUT_PIECE(chess->board, row, col, type, color, sprite_number(type, color));
+
+    // pawns off their starting row have lost the double push
+    if (type == Pawn) {
+        int start_row = (color == ColorWhite) == chess->white_at_bottom ? CHESS_BOARD_ROWS - 2 : 1;
+        chess->board[row][col].piece.has_moved = row != start_row;
+    }
+}
+
+static inline int back_row(const Chess *chess, enum Color color) {
+    return (color == ColorWhite) == chess->white_at_bottom ? CHESS_BOARD_ROWS - 1 : 0;
+}
+
+// Castling rights are expressed with has_moved of the king and rooks
+static void set_castling_rights(Chess *chess, enum Color color, bool king_side, bool queen_side) {
+    int row = back_row(chess, color);
+
+    for (int r = 0; r < CHESS_BOARD_ROWS; r++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            Piece *piece = &chess->board[r][col].piece;
+
+            if (Chess_is_piece(piece, King, color)) {
+                piece->has_moved = r != row || !(king_side || queen_side);
+            } else if (Chess_is_piece(piece, Rook, color)) {
+                piece->has_moved = r != row || !((col == 0 && queen_side) || (col == CHESS_BOARD_COLS - 1 && king_side));
+            }
+        }
+    }
+}
+
+static void get_castling_rights(const Chess *chess, enum Color color, bool *king_side, bool *queen_side) {
+    int row = back_row(chess, color);
+    const Piece *king = &chess->board[row][4].piece;
+    const Piece *h_rook = &chess->board[row][CHESS_BOARD_COLS - 1].piece;
+    const Piece *a_rook = &chess->board[row][0].piece;
+
+    bool king_ok = Chess_is_piece(king, King, color) && !king->has_moved;
+
+    *king_side = king_ok && Chess_is_piece(h_rook, Rook, color) && !h_rook->has_moved;
+    *queen_side = king_ok && Chess_is_piece(a_rook, Rook, color) && !a_rook->has_moved;
+}
+
+// POSITION_CASTLE_* << (color * 2), the hash doesn't include them
+uint8_t Chess_castling_rights(const Chess *chess) {
+    uint8_t rights = 0;
+
+    for (int color = ColorBlack; color <= ColorWhite; color++) {
+        bool king_side, queen_side;
+        get_castling_rights(chess, color, &king_side, &queen_side);
+
+        rights |= (king_side ? POSITION_CASTLE_KING_SIDE : 0) << (color * 2);
+        rights |= (queen_side ? POSITION_CASTLE_QUEEN_SIDE : 0) << (color * 2);
+    }
+
+    return rights;
+}
+
+static const char FenPieces[7] = {'?', 'k', 'q', 'r', 'b', 'n', 'p'};
+
+// What the move generator relies on: one king per side, not next to each other, the side that
+// just moved not left in check and no pawn on the first or last rank (there are no promotions)
+static bool is_valid_placement(const Chess *chess) {
+    const Piece *kings[2] = {NULL, NULL};
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &chess->board[row][col].piece;
+
+            if (piece->type == Pawn && (row == 0 || row == CHESS_BOARD_ROWS - 1)) {
+                return false;
+            }
+
+            if (piece->type == King) {
+                if (kings[piece->color] != NULL) {
+                    return false;
+                }
+
+                kings[piece->color] = piece;
+            }
+        }
+    }
+
+    if (kings[ColorWhite] == NULL || kings[ColorBlack] == NULL) {
+        return false;
+    }
+
+    if (abs(kings[ColorWhite]->pos.row - kings[ColorBlack]->pos.row) <= 1 && abs(kings[ColorWhite]->pos.col - kings[ColorBlack]->pos.col) <= 1) {
+        return false;
+    }
+
+    return !Chess_is_square_attacked(chess, kings[1 - chess->current_turn]->pos, chess->current_turn);
+}
+
+// Loads the piece placement, side to move and castling rights of a FEN string.
+// En passant isn't supported by the move generator and the move counters are game state,
+// both are ignored. The arena is reset, so move lists have to be recalculated afterwards.
+// Returns false on malformed input or a position the move generator can't handle (see
+// is_valid_placement), leaving the board in an unspecified state.
+bool Chess_load_fen(Chess *chess, const char *fen) {
+    clear_board(chess);
+
+    const char *p = fen;
+
+    for (int rank = CHESS_BOARD_ROWS - 1; rank >= 0; rank--) {
+        int row = chess->white_at_bottom ? CHESS_BOARD_ROWS - 1 - rank : rank;
+
+        for (int col = 0; col < CHESS_BOARD_COLS;) {
+            char c = *p++;
+
+            if (c >= '1' && c <= '8') {
+                col += c - '0';
+                continue;
+            }
+
+            enum PieceType type = UndefPieceType;
+
+            for (int t = King; t <= Pawn; t++) {
+                if (FenPieces[t] == (c | 0x20)) {
+                    type = t;
+                }
+            }
+
+            if (type == UndefPieceType) {
+                return false;
+            }
+
+            put_piece(chess, row, col, type, c >= 'a' ? ColorBlack : ColorWhite);
+            col++;
+        }
+
+        if (rank > 0 && *p++ != '/') {
+            return false;
+        }
+    }
+
+    if (*p++ != ' ' || (*p != 'w' && *p != 'b')) {
+        return false;
+    }
+
+    chess->current_turn = *p++ == 'w' ? ColorWhite : ColorBlack;
+
+    const char *castling = "-";
+
+    if (*p == ' ') {
+        castling = ++p;
+    }
+
+    for (int color = ColorBlack; color <= ColorWhite; color++) {
+        bool king_side = false, queen_side = false;
+
+        for (const char *c = castling; *c != '\0' && *c != ' '; c++) {
+            king_side |= *c == (color == ColorWhite ? 'K' : 'k');
+            queen_side |= *c == (color == ColorWhite ? 'Q' : 'q');
+        }
+
+        set_castling_rights(chess, color, king_side, queen_side);
+    }
+
+    if (!is_valid_placement(chess)) {
+        return false;
+    }
+
+    init_incremental_state(chess);
+
+    return true;
+}
+
+// Writes a FEN string of at least 92 bytes. En passant is never set, see Chess_load_fen
+void Chess_to_fen(const Chess *chess, int halfmove_clock, int fullmove_number, char *out) {
+    char *p = out;
+
+    for (int rank = CHESS_BOARD_ROWS - 1; rank >= 0; rank--) {
+        int row = chess->white_at_bottom ? CHESS_BOARD_ROWS - 1 - rank : rank;
+        int empty = 0;
+
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &chess->board[row][col].piece;
+
+            if (piece->type == UndefPieceType) {
+                empty++;
+                continue;
+            }
+
+            if (empty) {
+                *p++ = '0' + empty;
+                empty = 0;
+            }
+
+            *p++ = piece->color == ColorWhite ? FenPieces[piece->type] - 0x20 : FenPieces[piece->type];
+        }
+
+        if (empty) {
+            *p++ = '0' + empty;
+        }
+
+        if (rank > 0) {
+            *p++ = '/';
+        }
+    }
+
+    *p++ = ' ';
+    *p++ = chess->current_turn == ColorWhite ? 'w' : 'b';
+    *p++ = ' ';
+
+    char *castling = p;
+
+    for (int color = ColorWhite; color >= ColorBlack; color--) {
+        bool king_side, queen_side;
+        get_castling_rights(chess, color, &king_side, &queen_side);
+
+        if (king_side) {
+            *p++ = color == ColorWhite ? 'K' : 'k';
+        }
+
+        if (queen_side) {
+            *p++ = color == ColorWhite ? 'Q' : 'q';
+        }
+    }
+
+    if (p == castling) {
+        *p++ = '-';
+    }
+
+    sprintf(p, " - %d %d", halfmove_clock, fullmove_number);
+}
+
+// Deep copies src into dst. dst keeps its own arena, which is reset and refilled with
+// copies of src's move lists, so that the two games don't share any memory.
+// dst->arena has to be initialized and as big as src->arena.
+void Chess_copy(Chess *dst, const Chess *src) {
+    Arena arena = dst->arena;
+    arena_reset(&arena);
+
+    *dst = *src;
+    dst->arena = arena;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            Piece *piece = &dst->board[row][col].piece;
+
+            if (piece->moves == NULL) {
+                continue;
+            }
+
+            piece->moves = arena_alloc(&dst->arena, sizeof(Pos) * 64);
+            memcpy(piece->moves, src->board[row][col].piece.moves, sizeof(Pos) * piece->num_moves);
+        }
+    }
+
+    if (src->only_available_white_moves != NULL) {
+        dst->only_available_white_moves = arena_alloc(&dst->arena, 64);
+        memcpy(dst->only_available_white_moves, src->only_available_white_moves, sizeof(Pos) * src->num_available_white_moves);
+    }
+
+    if (src->only_available_black_moves != NULL) {
+        dst->only_available_black_moves = arena_alloc(&dst->arena, 64);
+        memcpy(dst->only_available_black_moves, src->only_available_black_moves, sizeof(Pos) * src->num_available_black_moves);
+    }
+
+    // pointers into the board have to point into dst's board
+    if (src->clicked_piece != NULL) {
+        dst->clicked_piece = &dst->board[src->clicked_piece->pos.row][src->clicked_piece->pos.col].piece;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (src->kingInCheck[i] != NULL) {
+            dst->kingInCheck[i] = &dst->board[src->kingInCheck[i]->pos.row][src->kingInCheck[i]->pos.col].piece;
+        }
+    }
+}
+
+_Static_assert(sizeof(Position) < 200, "Position has to stay cheap to copy");
+
+// Squares are stored from white's point of view (0 = a8 ... 63 = h1) whatever the board orientation
+void Position_from_chess(Position *position, const Chess *chess) {
+    *position = (Position){0};
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &chess->board[row][col].piece;
+
+            if (piece->type != UndefPieceType) {
+                position->squares[relative_square(chess, ColorWhite, (Pos){row, col})] = POSITION_SQUARE(piece->type, piece->color);
+            }
+        }
+    }
+
+    position->castling = Chess_castling_rights(chess);
+    position->side_to_move = chess->current_turn;
+    position->fullmove_number = 1;
+    position->hash = chess->hash;
+}
+
+// Replaces chess's position, keeping its orientation (white_at_bottom) and arena.
+// Move lists are recalculated. Returns false, before any move generation and leaving the board in
+// an unspecified state, on a position the move generator can't handle (see is_valid_placement)
+bool Chess_from_position(Chess *chess, const Position *position) {
+    clear_board(chess);
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            uint8_t square = position->squares[relative_square(chess, ColorWhite, (Pos){row, col})];
+
+            if (square != 0) {
+                put_piece(chess, row, col, POSITION_SQUARE_TYPE(square), POSITION_SQUARE_COLOR(square));
+            }
+        }
+    }
+
+    for (int color = ColorBlack; color <= ColorWhite; color++) {
+        uint8_t rights = position->castling >> (color * 2);
+        set_castling_rights(chess, color, rights & POSITION_CASTLE_KING_SIDE, rights & POSITION_CASTLE_QUEEN_SIDE);
+    }
+
+    chess->current_turn = position->side_to_move;
+
+    if (!is_valid_placement(chess)) {
+        return false;
+    }
+
+    init_incremental_state(chess);
+    Chess_calculate_moves(chess);
+
+    return true;
 }
@@ -1,7 +1,11 @@
 #include "../arena.h"
+#include "nnue.h"
+#include "stats.h"
+#include "tables.h"
 #include <SDL2/SDL_rect.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #ifndef CHESS__
 #define CHESS__
@@ -18,6 +22,9 @@
 #define CHESS_BOARD_ROWS 8
 #define CHESS_BOARD_COLS 8
 
+// enough to store moves for all pieces
+#define CHESS_ARENA_SIZE (CHESS_BOARD_COLS * CHESS_BOARD_ROWS * sizeof(Pos) * 35)
+
 enum PieceType { UndefPieceType, King, Queen, Rook, Bishop, Knight, Pawn };
 
 enum Color {
@@ -76,15 +83,55 @@ struct _Chess {
     // idx 0 != NULL -> black king in check
     // idx 1 != NULL -> white king in check
     Piece *kingInCheck[2];
+    // where Chess_calculate_moves last saw the kings, only a hint, see Chess_is_legal_move
+    Pos king_pos[2];
 
     // if in game_mode, only then the current_turn is taken into account
     bool game_mode;
     enum Color current_turn;
 
     bool white_at_bottom;
+
+    // Running tapered evaluation, updated by Chess_make_move. See eval.c
+    // idx 0 = black, idx 1 = white
+    int eval_mg[2];
+    int eval_eg[2];
+    int eval_phase;
+
+    // Only maintained while a network is loaded, see nnue.c
+    NNUEAccumulator nnue;
+
+    // Zobrist key of the piece placement and side to move, updated by Chess_make_move
+    uint64_t hash;
 };
 typedef struct _Chess Chess;
 
+// Compact, pointer free copy of the game state that matters for the rules. Fixed size and
+// trivially copyable, so it can be memcpy-ed, stored or handed to another thread as is.
+// Convert with Position_from_chess / Chess_from_position.
+struct _Position {
+    // from white's point of view, 0 = a8 ... 63 = h1. 0 = empty, see POSITION_SQUARE
+    uint8_t squares[CHESS_BOARD_ROWS * CHESS_BOARD_COLS];
+    uint8_t side_to_move;
+    // POSITION_CASTLE_* << (color * 2)
+    uint8_t castling;
+    // square a pawn can be captured en passant on, 0 (never one) for none. The move generator
+    // doesn't know en passant, it is only carried along for positions from elsewhere
+    uint8_t en_passant;
+    // game state rather than board state, Position_from_chess leaves them at 0 and 1
+    uint8_t halfmove_clock;
+    uint16_t fullmove_number;
+    uint64_t hash;
+};
+typedef struct _Position Position;
+
+#define POSITION_SQUARE(type, color) ((uint8_t)((type) | ((color) << 3)))
+#define POSITION_SQUARE_TYPE(square) ((enum PieceType)((square) & 7))
+#define POSITION_SQUARE_COLOR(square) ((enum Color)((square) >> 3))
+
+#define POSITION_CASTLE_KING_SIDE 1
+#define POSITION_CASTLE_QUEEN_SIDE 2
+
 #define PUT_PIECE(board, row_val, col_val, piece_type, color_val, sprite_number_val)                                                                 \
     board[row_val][col_val].piece = (Piece) {                                                                                                        \
         .pos = {.row = row_val, .col = col_val}, .type = piece_type, .color = color_val,                                                             \
@@ -97,20 +144,31 @@ typedef struct _Chess Chess;
     }
 
 
-extern int KnightRows[4];
-extern int KnightCols[4][2];
-extern int KnightRowsLen;
-extern int KnightColsLen;
-
 static inline bool pos_within_bounds(int row, int col) { return row >= 0 && row < CHESS_BOARD_ROWS && col >= 0 && col < CHESS_BOARD_COLS; }
 
+// Maps a board position to a square index from `color`'s point of view,
+// 0 = a8 ... 63 = h1 with `color`'s back rank last.
+// Files are not mirrored when the board is rotated (see Chess_init_board), so col is used as is.
+static inline int relative_square(const Chess *game, enum Color color, Pos pos) {
+    int own_back_rank = (color == ColorWhite) == game->white_at_bottom ? CHESS_BOARD_ROWS - 1 : 0;
+    int rank_from_back = abs(own_back_rank - pos.row);
+
+    return (CHESS_BOARD_ROWS - 1 - rank_from_back) * CHESS_BOARD_COLS + pos.col;
+}
+
 const char *piece_type_diplay(enum PieceType type);
 Piece *Chess_calculate_moves_for_piece(Chess *game, Piece *piece);
 Piece *Chess_find_piece(Chess *game, enum PieceType type, enum Color pieceColor);
-bool Chess_is_piece(Piece *piece, enum PieceType type, enum Color pieceColor);
+bool Chess_is_piece(const Piece *piece, enum PieceType type, enum Color pieceColor);
 void Chess_calculate_moves(Chess *game);
 bool Chess_make_move(Chess *game, Piece *piece, Pos pos);
 void Chess_init_board(Chess *chess);
+void Chess_copy(Chess *dst, const Chess *src);
+bool Chess_load_fen(Chess *chess, const char *fen);
+void Chess_to_fen(const Chess *chess, int halfmove_clock, int fullmove_number, char *out);
+uint8_t Chess_castling_rights(const Chess *chess);
+void Position_from_chess(Position *position, const Chess *chess);
+bool Chess_from_position(Chess *chess, const Position *position);
 
 void Chess_calculate_king_moves(Chess *game, Piece *piece, int num_moves);
 void Chess_calculate_knight_moves(Chess *game, Piece *piece, int num_moves);
@@ -118,15 +176,37 @@ void Chess_calculate_rook_moves(Chess *game, Piece *piece, int num_moves);
 void Chess_calculate_bishop_moves(Chess *game, Piece *piece, int num_moves);
 void Chess_calculate_pawn_moves(Chess *game, Piece *piece, int num_moves);
 
-void process_moves(Chess *game, Piece *piece, int row_adder, int col_adder);
+void process_moves(Chess *game, Piece *piece, enum RayDirection direction);
 void add_move_to_piece(Chess *game, Piece *piece, int row, int col);
 
 void Chess_check_for_checks_after_move(Chess *chess, Piece *king);
+bool Chess_is_square_attacked(const Chess *game, Pos pos, enum Color by);
+bool Chess_is_legal_move(const Chess *game, Pos from, Pos to);
+
+void Chess_eval_add_piece(Chess *game, enum PieceType type, enum Color color, Pos pos);
+void Chess_eval_remove_piece(Chess *game, enum PieceType type, enum Color color, Pos pos);
+void Chess_eval_compute(const Chess *game, int mg[2], int eg[2], int *phase);
+void Chess_eval_init(Chess *game);
+bool Chess_eval_check(const Chess *game);
+int Chess_evaluate(const Chess *game);
+
+void Chess_nnue_add_piece(Chess *game, enum PieceType type, enum Color color, Pos pos);
+void Chess_nnue_remove_piece(Chess *game, enum PieceType type, enum Color color, Pos pos);
+void Chess_nnue_refresh(Chess *game, enum Color perspective);
+bool Chess_nnue_check(Chess *game);
+int Chess_nnue_evaluate(Chess *game);
+
+uint64_t Chess_zobrist_piece_key(enum PieceType type, enum Color color, int square);
+uint64_t Chess_zobrist_side_key(void);
+uint64_t Chess_zobrist_castling_key(uint8_t rights);
+uint64_t Chess_hash_compute(const Chess *game);
 
 bool is_cell_empty(ChessBoard *board, int row, int col);
 const char *color_diplay(enum Color color);
 const char *piece_type_diplay(enum PieceType type) ;
 void print_piece(Piece *piece);
+bool Chess_parse_square(const Chess *game, const char *str, Pos *pos);
+void Chess_square_name(const Chess *game, Pos pos, char out[3]);
 bool can_piece_capture(ChessBoard *board, Piece *piece, int row, int col);
 
 #endif // !CHESS__
@@ -0,0 +1,67 @@
+#include "chess.h"
+#include "eval_params.h"
+
+void Chess_eval_add_piece(Chess *game, enum PieceType type, enum Color color, Pos pos) {
+    int sq = relative_square(game, color, pos);
+
+    game->eval_mg[color] += EvalMgValue[type] + EvalMgTable[type][sq];
+    game->eval_eg[color] += EvalEgValue[type] + EvalEgTable[type][sq];
+    game->eval_phase += EvalPhaseInc[type];
+}
+
+void Chess_eval_remove_piece(Chess *game, enum PieceType type, enum Color color, Pos pos) {
+    int sq = relative_square(game, color, pos);
+
+    game->eval_mg[color] -= EvalMgValue[type] + EvalMgTable[type][sq];
+    game->eval_eg[color] -= EvalEgValue[type] + EvalEgTable[type][sq];
+    game->eval_phase -= EvalPhaseInc[type];
+}
+
+// Full board recompute. Only used to seed the running scores and as a debug
+// check of the incremental updates (CHESS_EVAL_DEBUG)
+void Chess_eval_compute(const Chess *game, int mg[2], int eg[2], int *phase) {
+    mg[0] = mg[1] = 0;
+    eg[0] = eg[1] = 0;
+    *phase = 0;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &game->board[row][col].piece;
+
+            if (piece->type == UndefPieceType) {
+                continue;
+            }
+
+            int sq = relative_square(game, piece->color, (Pos){row, col});
+
+            mg[piece->color] += EvalMgValue[piece->type] + EvalMgTable[piece->type][sq];
+            eg[piece->color] += EvalEgValue[piece->type] + EvalEgTable[piece->type][sq];
+            *phase += EvalPhaseInc[piece->type];
+        }
+    }
+}
+
+void Chess_eval_init(Chess *game) { Chess_eval_compute(game, game->eval_mg, game->eval_eg, &game->eval_phase); }
+
+bool Chess_eval_check(const Chess *game) {
+    int mg[2], eg[2], phase;
+    Chess_eval_compute(game, mg, eg, &phase);
+
+    return mg[0] == game->eval_mg[0] && mg[1] == game->eval_mg[1] && eg[0] == game->eval_eg[0] && eg[1] == game->eval_eg[1] &&
+           phase == game->eval_phase;
+}
+
+// Tapered evaluation in centipawns from the point of view of the side to move
+int Chess_evaluate(const Chess *game) {
+    enum Color us = game->current_turn;
+    enum Color them = 1 - us;
+
+    int mg = game->eval_mg[us] - game->eval_mg[them];
+    int eg = game->eval_eg[us] - game->eval_eg[them];
+
+    // positions loaded from FEN can have more pieces than the starting position, the phase is
+    // clamped so those stay within the max
+    int phase = game->eval_phase > EVAL_MAX_PHASE ? EVAL_MAX_PHASE : game->eval_phase;
+
+    return (mg * phase + eg * (EVAL_MAX_PHASE - phase)) / EVAL_MAX_PHASE;
+}
@@ -55,3 +55,23 @@ void print_piece(Piece *piece) {
     printf("{ pos: (%d, %d), PieceType: %s, color: %s, has_moved: %d, is_protected: %d, piece_moves: %p }\n", piece->pos.row, piece->pos.col,
            piece_type_diplay(piece->type), color_diplay(piece->color), piece->has_moved, piece->is_protected, (void *)piece->moves);
 }
+
+// Square names ("e4") depend on the board orientation, row 0 is the 8th rank when white is at the bottom
+void Chess_square_name(const Chess *game, Pos pos, char out[3]) {
+    out[0] = 'a' + pos.col;
+    out[1] = '1' + (game->white_at_bottom ? CHESS_BOARD_ROWS - 1 - pos.row : pos.row);
+    out[2] = '\0';
+}
+
+bool Chess_parse_square(const Chess *game, const char *str, Pos *pos) {
+    if (str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8') {
+        return false;
+    }
+
+    int rank = str[1] - '1';
+
+    pos->col = str[0] - 'a';
+    pos->row = game->white_at_bottom ? CHESS_BOARD_ROWS - 1 - rank : rank;
+
+    return true;
+}
@@ -1,24 +1,6 @@
 #include "chess.h"
 #include <stdio.h>
 
-// clang-format off
-static int directions[8][2] = {
-    {-1, 0} ,
-    {0 , 1} ,
-    {1 , 0} ,
-    {0 , -1},
-    {-1, -1},
-    {-1, 1} ,
-    {1 , 1} ,
-    {-1, -1}
-};
-// clang-format on
-
-static int KingRows[3] = {1, -1, 0};
-static int KingCols[3][3] = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
-static int KingRowsLen = sizeof(KingRows) / sizeof(KingRows[0]);
-static int KingColsLen = sizeof(KingCols[0]) / sizeof(KingCols[0][0]);
-
 void Chess_calculate_king_moves(Chess *game, Piece *piece, int num_moves) {
     piece->num_moves = num_moves;
 
@@ -26,21 +8,17 @@ void Chess_calculate_king_moves(Chess *game, Piece *piece, int num_moves) {
         piece->moves = arena_alloc(&game->arena, sizeof(Pos) * 64);
     }
 
-    for (int row_idx = 0; row_idx < KingRowsLen; row_idx++) {
-        for (int col_idx = 0; col_idx < KingColsLen; col_idx++) {
-            int row_adder = KingRows[row_idx];
-            int col_adder = KingCols[row_idx][col_idx];
+    const SquareList *targets = &KingTargets[SQUARE(piece->pos.row, piece->pos.col)];
 
-            Pos potential_move = (Pos){.row = piece->pos.row + row_adder, .col = piece->pos.col + col_adder};
+    for (int i = 0; i < targets->count; i++) {
+        int row = SQUARE_ROW(targets->squares[i]);
+        int col = SQUARE_COL(targets->squares[i]);
 
-            if (pos_within_bounds(potential_move.row, potential_move.col)) {
-                Cell cell = game->board[potential_move.row][potential_move.col];
+        Cell cell = game->board[row][col];
 
-                if ((cell.piece.type == UndefPieceType && !cell.underAttack[1 - piece->color]) ||
-                    (cell.piece.type != UndefPieceType && cell.piece.color != piece->color && !cell.piece.is_protected)) {
-                    add_move_to_piece(game, piece, potential_move.row, potential_move.col);
-                }
-            }
+        if ((cell.piece.type == UndefPieceType && !cell.underAttack[1 - piece->color]) ||
+            (cell.piece.type != UndefPieceType && cell.piece.color != piece->color && !cell.piece.is_protected)) {
+            add_move_to_piece(game, piece, row, col);
         }
     }
 
@@ -99,10 +77,11 @@ void Chess_calculate_king_moves(Chess *game, Piece *piece, int num_moves) {
 }
 
 // Handle double checks
-void Chess_rook_bishop_queen_check_check(Chess *game, Piece *king, int row_adder, int col_adder) {
-    for (int row = king->pos.row + row_adder, col = king->pos.col + col_adder;
-         row >= 0 && row < CHESS_BOARD_ROWS && col >= 0 && col < CHESS_BOARD_COLS; row += row_adder, col += col_adder) {
-        Cell *cell = &game->board[row][col];
+void Chess_rook_bishop_queen_check_check(Chess *game, Piece *king, enum RayDirection direction) {
+    const SquareList *ray = &Rays[SQUARE(king->pos.row, king->pos.col)][direction];
+
+    for (int i = 0; i < ray->count; i++) {
+        Cell *cell = &game->board[SQUARE_ROW(ray->squares[i])][SQUARE_COL(ray->squares[i])];
 
         switch (cell->piece.type) {
             case UndefPieceType: {
@@ -112,7 +91,10 @@ void Chess_rook_bishop_queen_check_check(Chess *game, Piece *king, int row_adder
             case Rook:
             case Bishop:
             case Queen: {
-                if (cell->piece.color != king->color) {
+                // rooks only check along straight rays, bishops along diagonal ones
+                bool can_attack = cell->piece.type == Queen || (cell->piece.type == Rook) == RAY_IS_STRAIGHT(direction);
+
+                if (cell->piece.color != king->color && can_attack) {
                     game->kingInCheck[king->color] = &cell->piece;
                     return;
                 }
@@ -127,29 +109,74 @@ void Chess_rook_bishop_queen_check_check(Chess *game, Piece *king, int row_adder
 }
 
 void Chess_knight_check_check(Chess *game, Piece *king) {
-    for (int row_idx = 0; row_idx < KnightRowsLen; row_idx++) {
-        for (int col_idx = 0; col_idx < KnightColsLen; col_idx++) {
-            int row_adder = KnightRows[row_idx];
-            int col_adder = KnightCols[row_idx][col_idx];
+    const SquareList *targets = &KnightTargets[SQUARE(king->pos.row, king->pos.col)];
 
-            Pos potential_check = (Pos){.row = king->pos.row + row_adder, .col = king->pos.col + col_adder};
+    for (int i = 0; i < targets->count; i++) {
+        Cell *cell = &game->board[SQUARE_ROW(targets->squares[i])][SQUARE_COL(targets->squares[i])];
 
-            if (pos_within_bounds(potential_check.row, potential_check.col)) {
-                Cell *cell = &game->board[potential_check.row][potential_check.col];
-
-                if (cell->piece.type == Knight && cell->piece.color != king->color) {
-                    game->kingInCheck[king->color] = &cell->piece;
-                    return;
-                }
-            }
+        if (cell->piece.type == Knight && cell->piece.color != king->color) {
+            game->kingInCheck[king->color] = &cell->piece;
+            return;
         }
     }
 }
 
 void Chess_check_for_checks_after_move(Chess *chess, Piece *king) {
-    for (int i = 0; i < (int)(sizeof(directions) / sizeof(directions[0])); i++) {
-        Chess_rook_bishop_queen_check_check(chess, king, directions[i][0], directions[i][1]);
+    for (int direction = 0; direction < 8; direction++) {
+        Chess_rook_bishop_queen_check_check(chess, king, direction);
     }
 
     Chess_knight_check_check(chess, king);
 }
+
+// Unlike the kingInCheck bookkeeping in Chess_calculate_moves this only looks at the board,
+// so it can be used on any position without recalculating moves
+bool Chess_is_square_attacked(const Chess *game, Pos pos, enum Color by) {
+    int square = SQUARE(pos.row, pos.col);
+
+    // Pawns of `by` attack pos from the squares a pawn on pos moving the other way would capture on
+    bool by_moves_up = (by == ColorWhite) == game->white_at_bottom;
+    const SquareList *pawns = &PawnCaptureTargets[by_moves_up][square];
+
+    for (int i = 0; i < pawns->count; i++) {
+        if (Chess_is_piece(&game->board[SQUARE_ROW(pawns->squares[i])][SQUARE_COL(pawns->squares[i])].piece, Pawn, by)) {
+            return true;
+        }
+    }
+
+    const SquareList *knights = &KnightTargets[square];
+
+    for (int i = 0; i < knights->count; i++) {
+        if (Chess_is_piece(&game->board[SQUARE_ROW(knights->squares[i])][SQUARE_COL(knights->squares[i])].piece, Knight, by)) {
+            return true;
+        }
+    }
+
+    const SquareList *kings = &KingTargets[square];
+
+    for (int i = 0; i < kings->count; i++) {
+        if (Chess_is_piece(&game->board[SQUARE_ROW(kings->squares[i])][SQUARE_COL(kings->squares[i])].piece, King, by)) {
+            return true;
+        }
+    }
+
+    for (int direction = 0; direction < 8; direction++) {
+        const SquareList *ray = &Rays[square][direction];
+
+        for (int i = 0; i < ray->count; i++) {
+            const Piece *piece = &game->board[SQUARE_ROW(ray->squares[i])][SQUARE_COL(ray->squares[i])].piece;
+
+            if (piece->type == UndefPieceType) {
+                continue;
+            }
+
+            if (piece->color == by && (piece->type == Queen || piece->type == (RAY_IS_STRAIGHT(direction) ? Rook : Bishop))) {
+                return true;
+            }
+
+            break;
+        }
+    }
+
+    return false;
+}
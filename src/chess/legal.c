@@ -0,0 +1,228 @@
+#include "chess.h"
+
+// Legality of a single move without generating moves or copying the board. Agrees with the move
+// lists of Chess_calculate_moves followed by the king safety check of the engine: the same
+// geometry (a pawn's double push needs both squares in front empty, no en passant or promotion),
+// castling only with an unmoved king and rook, not out of, through or into check.
+
+// The board after the move, as far as attacks on the mover's king go. Squares the move leaves
+// are empty, squares it enters hold one of the mover's pieces, those block but never attack.
+struct _MoveOverlay {
+    int vacated[2];
+    int entered[2];
+};
+typedef struct _MoveOverlay MoveOverlay;
+
+static inline bool is_vacated(const MoveOverlay *overlay, int square) { return square == overlay->vacated[0] || square == overlay->vacated[1]; }
+
+static inline bool is_entered(const MoveOverlay *overlay, int square) { return square == overlay->entered[0] || square == overlay->entered[1]; }
+
+static inline bool is_attacker(const Chess *game, const MoveOverlay *overlay, int square, enum PieceType type, enum Color by) {
+    const Piece *piece = &game->board[SQUARE_ROW(square)][SQUARE_COL(square)].piece;
+
+    return piece->type == type && piece->color == by && !is_vacated(overlay, square) && !is_entered(overlay, square);
+}
+
+// Chess_is_square_attacked on the board after the move
+static bool is_attacked_after(const Chess *game, const MoveOverlay *overlay, int square, enum Color by) {
+    bool by_moves_up = (by == ColorWhite) == game->white_at_bottom;
+    const SquareList *pawns = &PawnCaptureTargets[by_moves_up][square];
+
+    for (int i = 0; i < pawns->count; i++) {
+        if (is_attacker(game, overlay, pawns->squares[i], Pawn, by)) {
+            return true;
+        }
+    }
+
+    const SquareList *knights = &KnightTargets[square];
+
+    for (int i = 0; i < knights->count; i++) {
+        if (is_attacker(game, overlay, knights->squares[i], Knight, by)) {
+            return true;
+        }
+    }
+
+    const SquareList *kings = &KingTargets[square];
+
+    for (int i = 0; i < kings->count; i++) {
+        if (is_attacker(game, overlay, kings->squares[i], King, by)) {
+            return true;
+        }
+    }
+
+    for (int direction = 0; direction < 8; direction++) {
+        const SquareList *ray = &Rays[square][direction];
+        enum PieceType slider = RAY_IS_STRAIGHT(direction) ? Rook : Bishop;
+
+        for (int i = 0; i < ray->count; i++) {
+            int target = ray->squares[i];
+
+            if (is_entered(overlay, target)) {
+                break;
+            }
+
+            const Piece *piece = &game->board[SQUARE_ROW(target)][SQUARE_COL(target)].piece;
+
+            if (piece->type == UndefPieceType || is_vacated(overlay, target)) {
+                continue;
+            }
+
+            if (piece->color == by && (piece->type == Queen || piece->type == slider)) {
+                return true;
+            }
+
+            break;
+        }
+    }
+
+    return false;
+}
+
+// Every square strictly between two squares on a common line is empty
+static inline bool is_path_clear(const Chess *game, Pos from, Pos to) {
+    int row_step = (to.row > from.row) - (to.row < from.row);
+    int col_step = (to.col > from.col) - (to.col < from.col);
+
+    for (int row = from.row + row_step, col = from.col + col_step; row != to.row || col != to.col; row += row_step, col += col_step) {
+        if (game->board[row][col].piece.type != UndefPieceType) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Same scan as Chess_calculate_king_moves: the first piece towards the edge has to be a rook
+// that hasn't moved, the king may not start on, pass or land on an attacked square
+static bool is_castling_allowed(const Chess *game, const Piece *king, int col_step) {
+    if (king->has_moved) {
+        return false;
+    }
+
+    int row = king->pos.row;
+    enum Color them = 1 - king->color;
+
+    for (int col = king->pos.col + col_step; col >= 0 && col < CHESS_BOARD_COLS; col += col_step) {
+        const Piece *piece = &game->board[row][col].piece;
+
+        if (piece->type == UndefPieceType) {
+            continue;
+        }
+
+        if (piece->type != Rook || piece->has_moved) {
+            return false;
+        }
+
+        for (int i = 0; i <= 2; i++) {
+            if (Chess_is_square_attacked(game, (Pos){row, king->pos.col + i * col_step}, them)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static Pos find_king(const Chess *game, enum Color color) {
+    Pos hint = game->king_pos[color];
+
+    if (pos_within_bounds(hint.row, hint.col) && Chess_is_piece(&game->board[hint.row][hint.col].piece, King, color)) {
+        return hint;
+    }
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            if (Chess_is_piece(&game->board[row][col].piece, King, color)) {
+                return (Pos){row, col};
+            }
+        }
+    }
+
+    return (Pos){-1, -1};
+}
+
+bool Chess_is_legal_move(const Chess *game, Pos from, Pos to) {
+    if (!pos_within_bounds(from.row, from.col) || !pos_within_bounds(to.row, to.col)) {
+        return false;
+    }
+
+    const Piece *piece = &game->board[from.row][from.col].piece;
+    const Piece *target = &game->board[to.row][to.col].piece;
+    enum Color us = game->current_turn;
+
+    // kings are never captured, the move before that was already illegal
+    if (piece->type == UndefPieceType || piece->color != us || (target->type != UndefPieceType && (target->color == us || target->type == King))) {
+        return false;
+    }
+
+    int from_square = SQUARE(from.row, from.col);
+    int to_square = SQUARE(to.row, to.col);
+    int rows = to.row - from.row;
+    int cols = to.col - from.col;
+
+    MoveOverlay overlay = {.vacated = {from_square, -1}, .entered = {to_square, -1}};
+
+    switch (piece->type) {
+        case UndefPieceType:
+            return false;
+
+        case King: {
+            if (rows == 0 && abs(cols) == 2) {
+                if (!is_castling_allowed(game, piece, cols / 2)) {
+                    return false;
+                }
+
+                // the rook jumps from the corner next to the king, see Chess_make_move
+                int rook_col = cols > 0 ? CHESS_BOARD_COLS - 1 : 0;
+                overlay.vacated[1] = SQUARE(from.row, rook_col);
+                overlay.entered[1] = SQUARE(from.row, to.col - cols / 2);
+            } else if (!(KingMask[from_square] >> to_square & 1)) {
+                return false;
+            }
+
+            return !is_attacked_after(game, &overlay, to_square, 1 - us);
+        }
+
+        case Knight: {
+            if (!(KnightMask[from_square] >> to_square & 1)) {
+                return false;
+            }
+
+            break;
+        }
+
+        case Pawn: {
+            int forward = (piece->color == ColorWhite) == game->white_at_bottom ? -1 : 1;
+
+            bool push = cols == 0 && target->type == UndefPieceType &&
+                        (rows == forward || (rows == 2 * forward && !piece->has_moved &&
+                                             game->board[from.row + forward][from.col].piece.type == UndefPieceType));
+            bool capture = abs(cols) == 1 && rows == forward && target->type != UndefPieceType;
+
+            if (!push && !capture) {
+                return false;
+            }
+
+            break;
+        }
+
+        case Queen:
+        case Rook:
+        case Bishop: {
+            bool straight = rows == 0 || cols == 0;
+            bool diagonal = abs(rows) == abs(cols);
+
+            if (!(piece->type == Queen ? straight || diagonal : piece->type == Rook ? straight : diagonal) || !is_path_clear(game, from, to)) {
+                return false;
+            }
+
+            break;
+        }
+    }
+
+    Pos king = find_king(game, us);
+
+    return king.row < 0 || !is_attacked_after(game, &overlay, SQUARE(king.row, king.col), 1 - us);
+}
@@ -7,6 +7,8 @@ static inline bool Chess_is_move_available(Chess *game, Piece *piece, int row, i
         return true;
     }
 
+    CHESS_STATS_INC(is_move_available_scans);
+
     Pos *moves = NULL;
     int num_moves = 0;
 
@@ -33,6 +35,8 @@ static inline bool Chess_is_move_available(Chess *game, Piece *piece, int row, i
 }
 
 void add_move_to_piece(Chess *game, Piece *piece, int row, int col) {
+    CHESS_STATS_INC(add_move_calls);
+
     if (!Chess_is_move_available(game, piece, row, col)) {
         return;
     }
@@ -61,6 +65,8 @@ void add_move_to_piece(Chess *game, Piece *piece, int row, int col) {
 // and returns a pointer to that piece
 // returns NULL if the clicked square does not have a piece
 Piece *Chess_calculate_moves_for_piece(Chess *game, Piece *piece) {
+    CHESS_STATS_TIMER_START(gen_start);
+
     switch (piece->type) {
         case UndefPieceType:
             break;
@@ -91,6 +97,8 @@ Piece *Chess_calculate_moves_for_piece(Chess *game, Piece *piece) {
             break;
     }
 
+    CHESS_STATS_TIMER_STOP(gen_start, piece->type);
+
     return piece->type == UndefPieceType ? NULL : piece;
 }
 
@@ -140,7 +148,7 @@ void Chess_get_available_moves_for_color(Chess *game, enum Color color, Piece *k
     }
 
     Pos *moves_array = NULL;
-    int *num_moves;
+    int *num_moves = NULL;
 
     switch (color) {
         case ColorBlack: {
@@ -191,9 +199,17 @@ void Chess_get_available_moves_for_color(Chess *game, enum Color color, Piece *k
     }
 }
 
-void process_moves(Chess *game, Piece *piece, int row_adder, int col_adder) {
-    for (int row = piece->pos.row + row_adder, col = piece->pos.col + col_adder;
-         row >= 0 && row < CHESS_BOARD_ROWS && col >= 0 && col < CHESS_BOARD_COLS; row += row_adder, col += col_adder) {
+void process_moves(Chess *game, Piece *piece, enum RayDirection direction) {
+    CHESS_STATS_INC(rays_walked);
+
+    const SquareList *ray = &Rays[SQUARE(piece->pos.row, piece->pos.col)][direction];
+
+    for (int i = 0; i < ray->count; i++) {
+        CHESS_STATS_INC(ray_squares);
+
+        int row = SQUARE_ROW(ray->squares[i]);
+        int col = SQUARE_COL(ray->squares[i]);
+
         Cell cell = game->board[row][col];
 
         if (cell.piece.type == UndefPieceType) {
@@ -212,6 +228,8 @@ void process_moves(Chess *game, Piece *piece, int row_adder, int col_adder) {
 }
 
 void Chess_calculate_moves(Chess *chess) {
+    CHESS_STATS_INC(calculate_moves_calls);
+
     Piece *whiteKing = NULL;
     Piece *blackKing = NULL;
 
@@ -235,6 +253,14 @@ void Chess_calculate_moves(Chess *chess) {
     chess->kingInCheck[0] = NULL;
     chess->kingInCheck[1] = NULL;
 
+    if (whiteKing != NULL) {
+        chess->king_pos[ColorWhite] = whiteKing->pos;
+    }
+
+    if (blackKing != NULL) {
+        chess->king_pos[ColorBlack] = blackKing->pos;
+    }
+
     Chess_check_for_checks_after_move(chess, whiteKing);
     Chess_check_for_checks_after_move(chess, blackKing);
 
@@ -258,9 +284,31 @@ void Chess_calculate_moves(Chess *chess) {
 
     Chess_calculate_moves_for_piece(chess, whiteKing);
     Chess_calculate_moves_for_piece(chess, blackKing);
+
+    CHESS_STATS_MAX(arena_bytes_used, chess->arena.allocated_bytes);
+}
+
+// Keeps the incrementally updated state (evaluation, NNUE accumulators, hash) in sync with the board
+static inline void board_remove_piece(Chess *game, enum PieceType type, enum Color color, Pos pos) {
+    Chess_eval_remove_piece(game, type, color, pos);
+    Chess_nnue_remove_piece(game, type, color, pos);
+    game->hash ^= Chess_zobrist_piece_key(type, color, relative_square(game, ColorWhite, pos));
+}
+
+static inline void board_add_piece(Chess *game, enum PieceType type, enum Color color, Pos pos) {
+    Chess_eval_add_piece(game, type, color, pos);
+    Chess_nnue_add_piece(game, type, color, pos);
+    game->hash ^= Chess_zobrist_piece_key(type, color, relative_square(game, ColorWhite, pos));
 }
 
 void swap_pieces(Cell *move_from, Cell *move_to, Chess *game) {
+    if (move_to->piece.type != UndefPieceType) {
+        board_remove_piece(game, move_to->piece.type, move_to->piece.color, move_to->piece.pos);
+    }
+
+    board_remove_piece(game, move_from->piece.type, move_from->piece.color, move_from->piece.pos);
+    board_add_piece(game, move_from->piece.type, move_from->piece.color, move_to->piece.pos);
+
     move_to->piece = PUT_PIECE(game->board, move_to->piece.pos.row, move_to->piece.pos.col, move_from->piece.type, move_from->piece.color,
                                move_from->piece.sprite_number);
 
@@ -301,6 +349,13 @@ bool Chess_make_move(Chess *game, Piece *piece, Pos pos) {
 
         Chess_calculate_moves(game);
         game->current_turn = 1 - game->current_turn;
+        game->hash ^= Chess_zobrist_side_key();
+
+#ifdef CHESS_EVAL_DEBUG
+        assert(Chess_eval_check(game) && "Incremental evaluation out of sync with the board");
+        assert(Chess_nnue_check(game) && "NNUE accumulator out of sync with the board");
+        assert(Chess_hash_compute(game) == game->hash && "Hash out of sync with the board");
+#endif
     }
 
     return legal;
@@ -0,0 +1,360 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "chess.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static NNUE nnue_net = {0};
+static bool nnue_loaded = false;
+
+bool NNUE_is_loaded(void) { return nnue_loaded; }
+
+void NNUE_unload(void) {
+    if (!nnue_loaded) {
+        return;
+    }
+
+    munmap(nnue_net.mapping, nnue_net.mapping_size);
+    nnue_net = (NNUE){0};
+    nnue_loaded = false;
+}
+
+// Maps the network file and points the layer arrays straight into the mapping, nothing is copied
+bool NNUE_load(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        printf("Failed to open network %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        printf("Failed to stat network %s\n", path);
+        close(fd);
+        return false;
+    }
+
+    size_t expected = sizeof(NNUEHeader) + sizeof(int16_t) * NNUE_INPUTS * NNUE_HIDDEN + sizeof(int16_t) * NNUE_HIDDEN +
+                      sizeof(int8_t) * NNUE_L1 * 2 * NNUE_HIDDEN + sizeof(int32_t) * NNUE_L1 + sizeof(int8_t) * NNUE_L2 * NNUE_L1 +
+                      sizeof(int32_t) * NNUE_L2 + sizeof(int8_t) * NNUE_L2 + sizeof(int32_t);
+
+    if ((size_t)st.st_size != expected) {
+        printf("Network %s has size %ld, expected %ld\n", path, (long)st.st_size, (long)expected);
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        printf("Failed to mmap network %s\n", path);
+        return false;
+    }
+
+    const NNUEHeader *header = mapping;
+
+    if (memcmp(header->magic, NNUE_MAGIC, sizeof(header->magic)) != 0 || header->inputs != NNUE_INPUTS || header->hidden != NNUE_HIDDEN ||
+        header->l1 != NNUE_L1 || header->l2 != NNUE_L2) {
+        printf("Network %s has an unsupported header\n", path);
+        munmap(mapping, expected);
+        return false;
+    }
+
+    NNUE_unload();
+
+    const char *ptr = (const char *)mapping + sizeof(NNUEHeader);
+
+    nnue_net.mapping = mapping;
+    nnue_net.mapping_size = expected;
+
+    nnue_net.ft_weights = (const int16_t *)ptr;
+    ptr += sizeof(int16_t) * NNUE_INPUTS * NNUE_HIDDEN;
+    nnue_net.ft_biases = (const int16_t *)ptr;
+    ptr += sizeof(int16_t) * NNUE_HIDDEN;
+    nnue_net.l1_weights = (const int8_t *)ptr;
+    ptr += sizeof(int8_t) * NNUE_L1 * 2 * NNUE_HIDDEN;
+    nnue_net.l1_biases = (const int32_t *)ptr;
+    ptr += sizeof(int32_t) * NNUE_L1;
+    nnue_net.l2_weights = (const int8_t *)ptr;
+    ptr += sizeof(int8_t) * NNUE_L2 * NNUE_L1;
+    nnue_net.l2_biases = (const int32_t *)ptr;
+    ptr += sizeof(int32_t) * NNUE_L2;
+    nnue_net.out_weights = (const int8_t *)ptr;
+    ptr += sizeof(int8_t) * NNUE_L2;
+    nnue_net.out_bias = (const int32_t *)ptr;
+
+    nnue_loaded = true;
+
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels. AVX2 when compiled with -mavx2 (or -march=native), SSE2 on any other x86_64, scalar otherwise.
+// All loads are unaligned so the layout of the network file doesn't matter.
+// ---------------------------------------------------------------------------
+
+static inline void nnue_vec_add(int16_t *acc, const int16_t *weights) {
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&acc[i]);
+        __m256i w = _mm256_loadu_si256((const __m256i *)&weights[i]);
+        _mm256_storeu_si256((__m256i *)&acc[i], _mm256_add_epi16(a, w));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)&acc[i]);
+        __m128i w = _mm_loadu_si128((const __m128i *)&weights[i]);
+        _mm_storeu_si128((__m128i *)&acc[i], _mm_add_epi16(a, w));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        acc[i] += weights[i];
+    }
+#endif
+}
+
+static inline void nnue_vec_sub(int16_t *acc, const int16_t *weights) {
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&acc[i]);
+        __m256i w = _mm256_loadu_si256((const __m256i *)&weights[i]);
+        _mm256_storeu_si256((__m256i *)&acc[i], _mm256_sub_epi16(a, w));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)&acc[i]);
+        __m128i w = _mm_loadu_si128((const __m128i *)&weights[i]);
+        _mm_storeu_si128((__m128i *)&acc[i], _mm_sub_epi16(a, w));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        acc[i] -= weights[i];
+    }
+#endif
+}
+
+// int16 accumulator -> uint8 clipped to [0, 127]
+static inline void nnue_clipped_relu_16(uint8_t *out, const int16_t *in, int n) {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (int i = 0; i < n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&in[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)&in[i + 16]);
+        // packs works per 128 bit lane, permute puts the 64 bit blocks back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)&out[i], _mm256_max_epi8(packed, zero));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(127);
+
+    for (int i = 0; i < n; i += 16) {
+        __m128i a = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)&in[i]), zero), max);
+        __m128i b = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)&in[i + 8]), zero), max);
+        _mm_storeu_si128((__m128i *)&out[i], _mm_packus_epi16(a, b));
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        out[i] = in[i] < 0 ? 0 : (in[i] > 127 ? 127 : in[i]);
+    }
+#endif
+}
+
+// int32 layer output -> uint8 clipped to [0, 127]
+static inline void nnue_clipped_relu_32(uint8_t *out, const int32_t *in, int n) {
+    for (int i = 0; i < n; i++) {
+        int32_t v = in[i] >> NNUE_WEIGHT_SHIFT;
+        out[i] = v < 0 ? 0 : (v > 127 ? 127 : v);
+    }
+}
+
+// dot product of n uint8 inputs (<= 127) and n int8 weights, n multiple of 32
+static inline int32_t nnue_dot(const uint8_t *in, const int8_t *weights, int n) {
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (int i = 0; i < n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&in[i]);
+        __m256i w = _mm256_loadu_si256((const __m256i *)&weights[i]);
+        // u8 * s8 -> pairwise s16 sums (127 * 127 * 2 can't saturate), then s16 pairs -> s32
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+    }
+
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+
+    for (int i = 0; i < n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&in[i]);
+        __m128i w = _mm_loadu_si128((const __m128i *)&weights[i]);
+        // no maddubs before SSSE3, widen to 16 bits (inputs are unsigned, weights get sign extended)
+        __m128i w_sign = _mm_cmpgt_epi8(zero, w);
+
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(w, w_sign)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(w, w_sign)));
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += in[i] * weights[i];
+    }
+
+    return sum;
+#endif
+}
+
+static inline void nnue_dense(int32_t *out, const uint8_t *in, const int8_t *weights, const int32_t *biases, int n_out, int n_in) {
+    for (int i = 0; i < n_out; i++) {
+        out[i] = biases[i] + nnue_dot(in, &weights[i * n_in], n_in);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Accumulator
+// ---------------------------------------------------------------------------
+
+// Pawn = 0, Knight = 1, Bishop = 2, Rook = 3, Queen = 4, times (ours, theirs)
+static inline int nnue_feature(const Chess *game, enum Color perspective, enum PieceType type, enum Color color, Pos pos) {
+    int kind = (Pawn - type) * 2 + (color != perspective);
+
+    return game->nnue.king_sq[perspective] * NNUE_PIECE_KINDS * 64 + kind * 64 + relative_square(game, perspective, pos);
+}
+
+void Chess_nnue_refresh(Chess *game, enum Color perspective) {
+    NNUEAccumulator *acc = &game->nnue;
+
+    Piece *king = Chess_find_piece(game, King, perspective);
+
+    if (!nnue_loaded || king == NULL) {
+        return;
+    }
+
+    acc->king_sq[perspective] = relative_square(game, perspective, king->pos);
+    memcpy(acc->values[perspective], nnue_net.ft_biases, sizeof(acc->values[perspective]));
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            Piece *piece = &game->board[row][col].piece;
+
+            if (piece->type == UndefPieceType || piece->type == King) {
+                continue;
+            }
+
+            int feature = nnue_feature(game, perspective, piece->type, piece->color, (Pos){row, col});
+            nnue_vec_add(acc->values[perspective], &nnue_net.ft_weights[(size_t)feature * NNUE_HIDDEN]);
+        }
+    }
+
+    acc->computed[perspective] = true;
+}
+
+static inline void nnue_update(Chess *game, enum PieceType type, enum Color color, Pos pos, bool add) {
+    NNUEAccumulator *acc = &game->nnue;
+
+    if (!nnue_loaded) {
+        return;
+    }
+
+    // Kings aren't features, but every feature of its own perspective depends on where it stands
+    if (type == King) {
+        acc->computed[color] = false;
+        return;
+    }
+
+    for (int perspective = ColorBlack; perspective <= ColorWhite; perspective++) {
+        if (!acc->computed[perspective]) {
+            continue;
+        }
+
+        const int16_t *weights = &nnue_net.ft_weights[(size_t)nnue_feature(game, perspective, type, color, pos) * NNUE_HIDDEN];
+
+        if (add) {
+            nnue_vec_add(acc->values[perspective], weights);
+        } else {
+            nnue_vec_sub(acc->values[perspective], weights);
+        }
+    }
+}
+
+void Chess_nnue_add_piece(Chess *game, enum PieceType type, enum Color color, Pos pos) { nnue_update(game, type, color, pos, true); }
+
+void Chess_nnue_remove_piece(Chess *game, enum PieceType type, enum Color color, Pos pos) { nnue_update(game, type, color, pos, false); }
+
+// Debug check, compares the incremental accumulators against a full refresh
+bool Chess_nnue_check(Chess *game) {
+    NNUEAccumulator saved = game->nnue;
+    bool ok = true;
+
+    for (int perspective = ColorBlack; perspective <= ColorWhite; perspective++) {
+        if (!saved.computed[perspective]) {
+            continue;
+        }
+
+        Chess_nnue_refresh(game, perspective);
+        ok = ok && memcmp(saved.values[perspective], game->nnue.values[perspective], sizeof(saved.values[perspective])) == 0;
+    }
+
+    game->nnue = saved;
+
+    return ok;
+}
+
+// Evaluation in centipawns from the point of view of the side to move.
+// Falls back to the hand written evaluation when no network is loaded.
+int Chess_nnue_evaluate(Chess *game) {
+    if (!nnue_loaded) {
+        return Chess_evaluate(game);
+    }
+
+    enum Color us = game->current_turn;
+    enum Color them = 1 - us;
+
+    for (int perspective = ColorBlack; perspective <= ColorWhite; perspective++) {
+        if (!game->nnue.computed[perspective]) {
+            Chess_nnue_refresh(game, perspective);
+        }
+    }
+
+    uint8_t transformed[2 * NNUE_HIDDEN];
+    int32_t l1_out[NNUE_L1];
+    uint8_t l1_act[NNUE_L1];
+    int32_t l2_out[NNUE_L2];
+    uint8_t l2_act[NNUE_L2];
+
+    nnue_clipped_relu_16(transformed, game->nnue.values[us], NNUE_HIDDEN);
+    nnue_clipped_relu_16(transformed + NNUE_HIDDEN, game->nnue.values[them], NNUE_HIDDEN);
+
+    nnue_dense(l1_out, transformed, nnue_net.l1_weights, nnue_net.l1_biases, NNUE_L1, 2 * NNUE_HIDDEN);
+    nnue_clipped_relu_32(l1_act, l1_out, NNUE_L1);
+
+    nnue_dense(l2_out, l1_act, nnue_net.l2_weights, nnue_net.l2_biases, NNUE_L2, NNUE_L1);
+    nnue_clipped_relu_32(l2_act, l2_out, NNUE_L2);
+
+    int32_t out = *nnue_net.out_bias + nnue_dot(l2_act, nnue_net.out_weights, NNUE_L2);
+
+    return out / NNUE_OUTPUT_SCALE;
+}
@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CHESS_NNUE__
+#define CHESS_NNUE__
+
+// HalfKP: (own king square, piece square, piece kind) for each perspective.
+// 10 piece kinds = 5 non king types * (ours, theirs)
+#define NNUE_PIECE_KINDS 10
+#define NNUE_INPUTS (64 * NNUE_PIECE_KINDS * 64)
+#define NNUE_HIDDEN 256
+#define NNUE_L1 32
+#define NNUE_L2 32
+
+// Fixed point scales. Accumulator / layer outputs are clipped to [0, 127] (127 = 1.0),
+// dense weights are scaled by 1 << NNUE_WEIGHT_SHIFT, output is divided by NNUE_OUTPUT_SCALE
+#define NNUE_WEIGHT_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+
+#define NNUE_MAGIC "CHNNUE01"
+
+// On disk layout, all little endian, read in place from the mmap-ed file:
+//
+//   NNUEHeader
+//   int16_t ft_weights[NNUE_INPUTS][NNUE_HIDDEN]
+//   int16_t ft_biases[NNUE_HIDDEN]
+//   int8_t  l1_weights[NNUE_L1][2 * NNUE_HIDDEN]
+//   int32_t l1_biases[NNUE_L1]
+//   int8_t  l2_weights[NNUE_L2][NNUE_L1]
+//   int32_t l2_biases[NNUE_L2]
+//   int8_t  out_weights[NNUE_L2]
+//   int32_t out_bias
+struct _NNUEHeader {
+    char magic[8];
+    uint32_t inputs;
+    uint32_t hidden;
+    uint32_t l1;
+    uint32_t l2;
+    // pad to 64 bytes so the weight arrays keep the mapping's alignment
+    uint8_t reserved[40];
+};
+typedef struct _NNUEHeader NNUEHeader;
+
+struct _NNUE {
+    void *mapping;
+    size_t mapping_size;
+
+    const int16_t *ft_weights;
+    const int16_t *ft_biases;
+    const int8_t *l1_weights;
+    const int32_t *l1_biases;
+    const int8_t *l2_weights;
+    const int32_t *l2_biases;
+    const int8_t *out_weights;
+    const int32_t *out_bias;
+};
+typedef struct _NNUE NNUE;
+
+// Lives inside Chess and is updated by Chess_make_move.
+// idx 0 = black's perspective, idx 1 = white's perspective
+struct _NNUEAccumulator {
+    int16_t values[2][NNUE_HIDDEN];
+    // relative square (see relative_square) of the perspective's own king
+    int king_sq[2];
+    // false -> needs a full refresh, e.g. after the king moved
+    bool computed[2];
+};
+typedef struct _NNUEAccumulator NNUEAccumulator;
+
+bool NNUE_load(const char *path);
+void NNUE_unload(void);
+bool NNUE_is_loaded(void);
+
+#endif // !CHESS_NNUE__
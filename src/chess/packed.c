@@ -0,0 +1,289 @@
+#include "packed.h"
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+// The squares are converted 16 at a time with pshufb (SSSE3, -march=native): ByteCompress gathers
+// the occupied squares of a row next to each other when packing, ByteExpand puts them back when
+// unpacking. Without SSSE3 the same is done one occupied square at a time.
+
+_Static_assert(sizeof(PackedPosition) == 32, "PackedPosition has to stay 32 bytes");
+
+#define PACKED_MAX_PIECES 32
+#define PACKED_FLAGS_MASK (PACKED_SIDE_TO_MOVE | 0xf << PACKED_CASTLING_SHIFT)
+
+static inline bool is_en_passant_square(uint8_t square) {
+    int row = square / CHESS_BOARD_COLS;
+    return square == 0 || row == 2 || row == 5;
+}
+
+static inline bool is_valid_code(uint8_t code) { return code < 16 && (code & 7) != 0 && (code & 7) <= Pawn; }
+
+#define BYTES(byte) (0x0101010101010101ull * (byte))
+
+// 8 in every byte of types (0 to 7 each) that is type
+static inline uint64_t type_bytes(uint64_t types, enum PieceType type) { return ~((types ^ BYTES(type)) + BYTES(7)) & BYTES(8); }
+
+// Valid piece codes and what the move generator relies on and can be told without it: one king
+// each, no pawn on the first or last rank. Both pack and unpack refuse anything else, so whatever
+// packs can be read back. Eight squares at a time, the color is bit 3 of a code
+static bool is_valid_placement(const Position *position) {
+    uint64_t invalid = 0;
+    // a count per byte, at most 8 each
+    uint64_t white_kings = 0, black_kings = 0;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        uint64_t squares;
+        memcpy(&squares, position->squares + row * CHESS_BOARD_COLS, sizeof(squares));
+
+        uint64_t types = squares & BYTES(7);
+        uint64_t kings = type_bytes(types, King);
+
+        // codes of 16 and up, type 7 and a color without a type
+        invalid |= (squares & BYTES(0xf0)) | type_bytes(types, 7) | (squares & type_bytes(types, UndefPieceType));
+        white_kings += (kings & squares) >> 3;
+        black_kings += (kings & ~squares) >> 3;
+    }
+
+    uint64_t first, last;
+    memcpy(&first, position->squares, sizeof(first));
+    memcpy(&last, position->squares + (CHESS_BOARD_ROWS - 1) * CHESS_BOARD_COLS, sizeof(last));
+
+    invalid |= type_bytes(first & BYTES(7), Pawn) | type_bytes(last & BYTES(7), Pawn);
+
+    // the byte counts summed up in the top byte
+    return invalid == 0 && (white_kings * BYTES(1)) >> 56 == 1 && (black_kings * BYTES(1)) >> 56 == 1;
+}
+
+static inline void pack_state(PackedPosition *packed, const Position *position) {
+    packed->flags = (position->side_to_move == ColorWhite ? PACKED_SIDE_TO_MOVE : 0) | position->castling << PACKED_CASTLING_SHIFT;
+    packed->en_passant = position->en_passant;
+    packed->fullmove_number = position->fullmove_number;
+    packed->halfmove_clock = position->halfmove_clock;
+    memset(packed->reserved, 0, sizeof(packed->reserved));
+}
+
+static inline bool unpack_state(Position *position, const PackedPosition *packed) {
+    if ((packed->flags & ~PACKED_FLAGS_MASK) != 0 || !is_en_passant_square(packed->en_passant) || packed->reserved[0] != 0 ||
+        packed->reserved[1] != 0 || packed->reserved[2] != 0) {
+        return false;
+    }
+
+    position->side_to_move = packed->flags & PACKED_SIDE_TO_MOVE ? ColorWhite : ColorBlack;
+    position->castling = packed->flags >> PACKED_CASTLING_SHIFT;
+    position->en_passant = packed->en_passant;
+    position->fullmove_number = packed->fullmove_number;
+    position->halfmove_clock = packed->halfmove_clock;
+
+    uint64_t hash = position->side_to_move == ColorBlack ? Chess_zobrist_side_key() : 0;
+
+    for (uint64_t bits = packed->occupied; bits != 0; bits &= bits - 1) {
+        int square = __builtin_ctzll(bits);
+        uint8_t code = position->squares[square];
+
+        hash ^= Chess_zobrist_piece_key(POSITION_SQUARE_TYPE(code), POSITION_SQUARE_COLOR(code), square);
+    }
+
+    position->hash = hash;
+
+    return is_valid_placement(position);
+}
+
+#if defined(__SSSE3__)
+
+// masks for the 16 squares of rows 2 * i and 2 * i + 1, the second row's shifted to the high half
+static inline __m128i row_pair_mask(const uint8_t table[256][8], uint64_t occupied, int i) {
+    __m128i low = _mm_loadl_epi64((const __m128i *)table[occupied >> (16 * i) & 0xff]);
+    __m128i high = _mm_loadl_epi64((const __m128i *)table[occupied >> (16 * i + 8) & 0xff]);
+
+    // 0x80 + 8 still selects zero
+    return _mm_unpacklo_epi64(low, _mm_add_epi8(high, _mm_set1_epi8(8)));
+}
+
+bool PackedPosition_pack(PackedPosition *packed, const Position *position) {
+    if (!is_valid_placement(position)) {
+        return false;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i squares[4];
+    uint64_t occupied = 0;
+
+    for (int i = 0; i < 4; i++) {
+        squares[i] = _mm_loadu_si128((const __m128i *)position->squares + i);
+        occupied |= (uint64_t)(~_mm_movemask_epi8(_mm_cmpeq_epi8(squares[i], zero)) & 0xffff) << (16 * i);
+    }
+
+    if (__builtin_popcountll(occupied) > PACKED_MAX_PIECES) {
+        return false;
+    }
+
+    // the pieces one byte each, a row is written 8 bytes at a time whatever its piece count
+    uint8_t codes[PACKED_MAX_PIECES + 16] = {0};
+    int count = 0;
+
+    for (int i = 0; i < 4; i++) {
+        __m128i rows = _mm_shuffle_epi8(squares[i], row_pair_mask(ByteCompress, occupied, i));
+
+        _mm_storel_epi64((__m128i *)(codes + count), rows);
+        count += __builtin_popcount(occupied >> (16 * i) & 0xff);
+        _mm_storel_epi64((__m128i *)(codes + count), _mm_unpackhi_epi64(rows, rows));
+        count += __builtin_popcount(occupied >> (16 * i + 8) & 0xff);
+    }
+
+    // byte pairs to nibbles, the first of each pair in the low nibble
+    const __m128i low_byte = _mm_set1_epi16(0xff);
+    __m128i a = _mm_loadu_si128((const __m128i *)codes);
+    __m128i b = _mm_loadu_si128((const __m128i *)(codes + 16));
+
+    a = _mm_or_si128(_mm_and_si128(a, low_byte), _mm_slli_epi16(_mm_srli_epi16(a, 8), 4));
+    b = _mm_or_si128(_mm_and_si128(b, low_byte), _mm_slli_epi16(_mm_srli_epi16(b, 8), 4));
+
+    packed->occupied = occupied;
+    _mm_storeu_si128((__m128i *)packed->pieces, _mm_packus_epi16(a, b));
+    pack_state(packed, position);
+
+    return true;
+}
+
+bool PackedPosition_unpack(Position *position, const PackedPosition *packed) {
+    uint64_t occupied = packed->occupied;
+    int count = __builtin_popcountll(occupied);
+
+    if (count > PACKED_MAX_PIECES) {
+        return false;
+    }
+
+    // nibbles to one byte each, in order
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+    __m128i pieces = _mm_loadu_si128((const __m128i *)packed->pieces);
+    __m128i low = _mm_and_si128(pieces, low_nibble);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(pieces, 4), low_nibble);
+    __m128i first = _mm_unpacklo_epi8(low, high);
+    __m128i second = _mm_unpackhi_epi8(low, high);
+
+    // the pieces need a valid type, the nibbles past them have to be 0 for the encoding to be canonical
+    const __m128i seven = _mm_set1_epi8(7);
+    __m128i types[2] = {_mm_and_si128(first, seven), _mm_and_si128(second, seven)};
+    uint32_t empty = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(first, _mm_setzero_si128())) |
+                     (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(second, _mm_setzero_si128())) << 16;
+    uint32_t bad_type = 0;
+
+    for (int i = 0; i < 2; i++) {
+        __m128i bad = _mm_or_si128(_mm_cmpeq_epi8(types[i], _mm_setzero_si128()), _mm_cmpeq_epi8(types[i], seven));
+        bad_type |= (uint32_t)_mm_movemask_epi8(bad) << (16 * i);
+    }
+
+    uint32_t used = count == PACKED_MAX_PIECES ? 0xffffffffu : (1u << count) - 1;
+
+    if ((bad_type & used) != 0 || (~empty & ~used) != 0) {
+        return false;
+    }
+
+    uint8_t codes[PACKED_MAX_PIECES + 16];
+    _mm_storeu_si128((__m128i *)codes, first);
+    _mm_storeu_si128((__m128i *)(codes + 16), second);
+
+    int offset = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int low_count = __builtin_popcount(occupied >> (16 * i) & 0xff);
+        __m128i source = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(codes + offset)),
+                                            _mm_loadl_epi64((const __m128i *)(codes + offset + low_count)));
+
+        _mm_storeu_si128((__m128i *)position->squares + i, _mm_shuffle_epi8(source, row_pair_mask(ByteExpand, occupied, i)));
+        offset += low_count + __builtin_popcount(occupied >> (16 * i + 8) & 0xff);
+    }
+
+    return unpack_state(position, packed);
+}
+
+#else
+
+bool PackedPosition_pack(PackedPosition *packed, const Position *position) {
+    if (!is_valid_placement(position)) {
+        return false;
+    }
+
+    uint64_t occupied = 0;
+
+    // 8 squares at a time: a bit per nonzero byte (codes are below 16), gathered into one byte
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        uint64_t squares;
+        memcpy(&squares, position->squares + row * CHESS_BOARD_COLS, sizeof(squares));
+
+        uint64_t nonzero = (squares | squares >> 1 | squares >> 2 | squares >> 3) & 0x0101010101010101ull;
+        occupied |= (nonzero * 0x0102040810204080ull >> 56) << (row * CHESS_BOARD_COLS);
+    }
+
+    if (__builtin_popcountll(occupied) > PACKED_MAX_PIECES) {
+        return false;
+    }
+
+    memset(packed->pieces, 0, sizeof(packed->pieces));
+
+    int count = 0;
+
+    for (uint64_t bits = occupied; bits != 0; bits &= bits - 1, count++) {
+        packed->pieces[count / 2] |= position->squares[__builtin_ctzll(bits)] << (count % 2 * 4);
+    }
+
+    packed->occupied = occupied;
+    pack_state(packed, position);
+
+    return true;
+}
+
+bool PackedPosition_unpack(Position *position, const PackedPosition *packed) {
+    if (__builtin_popcountll(packed->occupied) > PACKED_MAX_PIECES) {
+        return false;
+    }
+
+    memset(position->squares, 0, sizeof(position->squares));
+
+    int count = 0;
+
+    for (uint64_t bits = packed->occupied; bits != 0; bits &= bits - 1, count++) {
+        uint8_t code = packed->pieces[count / 2] >> (count % 2 * 4) & 0xf;
+
+        if (!is_valid_code(code)) {
+            return false;
+        }
+
+        position->squares[__builtin_ctzll(bits)] = code;
+    }
+
+    for (; count < PACKED_MAX_PIECES; count++) {
+        if ((packed->pieces[count / 2] >> (count % 2 * 4) & 0xf) != 0) {
+            return false;
+        }
+    }
+
+    return unpack_state(position, packed);
+}
+
+#endif
+
+// Both return the number of positions converted, stopping at the first one that can't be: more
+// than 32 pieces when packing, an invalid or non canonical encoding when unpacking
+size_t PackedPosition_pack_batch(PackedPosition *packed, const Position *positions, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!PackedPosition_pack(&packed[i], &positions[i])) {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+size_t PackedPosition_unpack_batch(Position *positions, const PackedPosition *packed, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!PackedPosition_unpack(&positions[i], &packed[i])) {
+            return i;
+        }
+    }
+
+    return count;
+}
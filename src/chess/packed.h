@@ -0,0 +1,38 @@
+#include "chess.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CHESS_PACKED__
+#define CHESS_PACKED__
+
+#define PACKED_SIDE_TO_MOVE 1
+// Position castling rights << PACKED_CASTLING_SHIFT
+#define PACKED_CASTLING_SHIFT 1
+
+// Canonical 32 byte encoding of a Position, for storing positions in bulk. Equal positions encode
+// to the same bytes (the zobrist hash is left out and recomputed when unpacking), so encodings can
+// be compared, hashed and deduplicated with memcmp. Fields are stored in host byte order.
+// Packing and unpacking both fail on placements the move generator can't handle (not exactly one
+// king per side, or a pawn on the first or last rank), unpacking also on non-canonical encodings.
+struct _PackedPosition {
+    // Position squares holding a piece, bit 0 = a8 ... bit 63 = h1
+    uint64_t occupied;
+    // POSITION_SQUARE of the occupied squares in square order, two per byte, the first one in the
+    // low nibble. Nibbles past the last piece are 0
+    uint8_t pieces[16];
+    // PACKED_SIDE_TO_MOVE when white is to move | castling << PACKED_CASTLING_SHIFT
+    uint8_t flags;
+    uint8_t en_passant;
+    uint16_t fullmove_number;
+    uint8_t halfmove_clock;
+    // always 0
+    uint8_t reserved[3];
+};
+typedef struct _PackedPosition PackedPosition;
+
+bool PackedPosition_pack(PackedPosition *packed, const Position *position);
+bool PackedPosition_unpack(Position *position, const PackedPosition *packed);
+size_t PackedPosition_pack_batch(PackedPosition *packed, const Position *positions, size_t count);
+size_t PackedPosition_unpack_batch(Position *positions, const PackedPosition *packed, size_t count);
+
+#endif // !CHESS_PACKED__
@@ -19,35 +19,35 @@ void Chess_calculate_pawn_moves(Chess *game, Piece *piece, int num_moves) {
 
     int row = piece->pos.row + row_adder;
     int col = piece->pos.col;
+    bool single_push = is_cell_empty(&game->board, row, col);
 
-    if (is_cell_empty(&game->board, row, col)) {
+    if (single_push) {
         add_move_to_piece(game, piece, row, col);
     }
 
+    // the double push can't jump over the square in front
     row = piece->pos.row + row_adder * 2;
-    if (!piece->has_moved && is_cell_empty(&game->board, row, col)) {
+    if (single_push && !piece->has_moved && is_cell_empty(&game->board, row, col)) {
         add_move_to_piece(game, piece, row, col);
     }
 
     // Capture
-    int col_adder[2] = {-1, 1};
-    row = piece->pos.row + row_adder;
+    const SquareList *targets = &PawnCaptureTargets[row_adder == 1][SQUARE(piece->pos.row, piece->pos.col)];
 
-    for (int i = 0; i < 2; i++) {
-        col = piece->pos.col + col_adder[i];
+    for (int i = 0; i < targets->count; i++) {
+        row = SQUARE_ROW(targets->squares[i]);
+        col = SQUARE_COL(targets->squares[i]);
 
         if (can_piece_capture(&game->board, piece, row, col)) {
             add_move_to_piece(game, piece, row, col);
         }
 
-        if (pos_within_bounds(row, col)) {
-            Cell *cell = &game->board[row][col];
+        Cell *cell = &game->board[row][col];
 
-            if (cell->piece.type == UndefPieceType) {
-                cell->underAttack[piece->color] = true;
-            } else if (cell->piece.color == piece->color) {
-                cell->piece.is_protected = true;
-            }
+        if (cell->piece.type == UndefPieceType) {
+            cell->underAttack[piece->color] = true;
+        } else if (cell->piece.color == piece->color) {
+            cell->piece.is_protected = true;
         }
     }
 }
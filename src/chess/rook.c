@@ -8,12 +8,12 @@ void Chess_calculate_rook_moves(Chess *game, Piece *piece, int num_moves) {
     }
 
     // Top
-    process_moves(game, piece, -1, 0);
+    process_moves(game, piece, RayUp);
     // Left
-    process_moves(game, piece, 0, -1);
+    process_moves(game, piece, RayLeft);
     // Bottom
-    process_moves(game, piece, 1, 0);
+    process_moves(game, piece, RayDown);
     // Right
-    process_moves(game, piece, 0, 1);
+    process_moves(game, piece, RayRight);
 }
 
@@ -0,0 +1,52 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "chess.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef CHESS_STATS
+
+_Thread_local ChessStats chess_stats = {0};
+
+uint64_t Chess_stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+ChessStats Chess_stats_get(void) { return chess_stats; }
+
+void Chess_stats_reset(void) { memset(&chess_stats, 0, sizeof(chess_stats)); }
+
+#else
+
+ChessStats Chess_stats_get(void) { return (ChessStats){0}; }
+
+void Chess_stats_reset(void) {}
+
+#endif // CHESS_STATS
+
+void Chess_stats_report(FILE *out) {
+#ifndef CHESS_STATS
+    fprintf(out, "Chess stats: compiled out (build with -DCHESS_STATS)\n");
+#else
+    ChessStats s = Chess_stats_get();
+
+    fprintf(out, "Chess stats:\n");
+    fprintf(out, "  Chess_calculate_moves calls : %lu\n", (unsigned long)s.calculate_moves_calls);
+    fprintf(out, "  add_move_to_piece calls     : %lu\n", (unsigned long)s.add_move_calls);
+    fprintf(out, "  is_move_available scans     : %lu\n", (unsigned long)s.is_move_available_scans);
+    fprintf(out, "  rays walked                 : %lu (%lu squares)\n", (unsigned long)s.rays_walked, (unsigned long)s.ray_squares);
+    fprintf(out, "  arena bytes used            : %lu\n", (unsigned long)s.arena_bytes_used);
+
+    for (int type = 0; type < PIECE_TYPE_COUNT; type++) {
+        if (s.gen_calls[type] == 0) {
+            continue;
+        }
+
+        fprintf(out, "  %-8s gen: %10lu calls, %12lu ns, %8.1f ns/call\n", piece_type_diplay(type), (unsigned long)s.gen_calls[type],
+                (unsigned long)s.gen_ns[type], (double)s.gen_ns[type] / (double)s.gen_calls[type]);
+    }
+#endif
+}
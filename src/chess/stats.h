@@ -0,0 +1,64 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef CHESS_STATS__
+#define CHESS_STATS__
+
+// Number of values in enum PieceType (UndefPieceType included)
+#define PIECE_TYPE_COUNT 7
+
+// Hot path counters for the move generator. Only collected when compiled with
+// -DCHESS_STATS, otherwise every CHESS_STATS_* macro expands to nothing.
+struct _ChessStats {
+    uint64_t calculate_moves_calls;
+    uint64_t add_move_calls;
+    // number of times Chess_is_move_available had to scan the only_available_*_moves list
+    uint64_t is_move_available_scans;
+
+    // process_moves calls, and the squares walked along those rays
+    uint64_t rays_walked;
+    uint64_t ray_squares;
+
+    // indexed by enum PieceType
+    uint64_t gen_calls[PIECE_TYPE_COUNT];
+    uint64_t gen_ns[PIECE_TYPE_COUNT];
+
+    // high water mark of game->arena.allocated_bytes
+    size_t arena_bytes_used;
+};
+typedef struct _ChessStats ChessStats;
+
+#ifdef CHESS_STATS
+
+// Per thread so concurrent games don't race on the counters
+extern _Thread_local ChessStats chess_stats;
+
+uint64_t Chess_stats_now_ns(void);
+
+#define CHESS_STATS_INC(field) (chess_stats.field++)
+#define CHESS_STATS_ADD(field, n) (chess_stats.field += (n))
+#define CHESS_STATS_MAX(field, n) (chess_stats.field = (n) > chess_stats.field ? (n) : chess_stats.field)
+
+#define CHESS_STATS_TIMER_START(name) uint64_t name = Chess_stats_now_ns()
+#define CHESS_STATS_TIMER_STOP(name, piece_type)                                                                                                     \
+    do {                                                                                                                                             \
+        chess_stats.gen_ns[piece_type] += Chess_stats_now_ns() - name;                                                                               \
+        chess_stats.gen_calls[piece_type]++;                                                                                                         \
+    } while (0)
+
+#else
+
+#define CHESS_STATS_INC(field) ((void)0)
+#define CHESS_STATS_ADD(field, n) ((void)0)
+#define CHESS_STATS_MAX(field, n) ((void)0)
+#define CHESS_STATS_TIMER_START(name) ((void)0)
+#define CHESS_STATS_TIMER_STOP(name, piece_type) ((void)0)
+
+#endif // CHESS_STATS
+
+// These are always available, they return / print zeros when stats are compiled out
+ChessStats Chess_stats_get(void);
+void Chess_stats_reset(void);
+void Chess_stats_report(FILE *out);
+
+#endif // !CHESS_STATS__
@@ -0,0 +1,39 @@
+#include "chess.h"
+
+// Keys are derived from the (piece, color, square) index with splitmix64 instead of
+// being stored in a table, so there is nothing to initialize or share between threads
+
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// square is relative_square(game, ColorWhite, pos), so hashes don't depend on the board orientation
+uint64_t Chess_zobrist_piece_key(enum PieceType type, enum Color color, int square) {
+    return splitmix64((uint64_t)(type * 2 + color) * CHESS_BOARD_ROWS * CHESS_BOARD_COLS + square);
+}
+
+// xor-ed in while black is to move
+uint64_t Chess_zobrist_side_key(void) { return splitmix64(0xB1AC4ull); }
+
+// Chess.hash leaves castling rights out, this is xor-ed in where positions that only differ in
+// them have to be told apart. rights is Chess_castling_rights
+uint64_t Chess_zobrist_castling_key(uint8_t rights) { return rights == 0 ? 0 : splitmix64(0xCA571Eull + rights); }
+
+uint64_t Chess_hash_compute(const Chess *game) {
+    uint64_t hash = game->current_turn == ColorBlack ? Chess_zobrist_side_key() : 0;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &game->board[row][col].piece;
+
+            if (piece->type != UndefPieceType) {
+                hash ^= Chess_zobrist_piece_key(piece->type, piece->color, relative_square(game, ColorWhite, (Pos){row, col}));
+            }
+        }
+    }
+
+    return hash;
+}
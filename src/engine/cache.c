@@ -0,0 +1,467 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "engine.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Persistent transposition table for deep results. Entries are written with plain atomic stores
+// into a MAP_SHARED mapping of the file, so every process that has the file open sees the others'
+// results as they are stored and the kernel writes them back on its own. Like in the HashTable an
+// entry is stored as (key ^ data, data), a torn write fails the key check. The checksum in the data
+// also catches entries damaged on disk, which matters where the key isn't known (merge, compact).
+//
+// Entry data layout:
+//   bits  0-5   from square, 0 = a8 ... 63 = h1 from white's point of view
+//   bits  6-11  to square
+//   bit   12    has a move
+//   bits 16-31  score (int16)
+//   bits 32-39  depth
+//   bits 40-41  enum HashBound
+//   bits 48-63  checksum of the key and the bits above
+// Keys are PositionIndex_key, so castling rights are part of the position and the board's
+// orientation isn't.
+#define DATA_HAS_MOVE (1ull << 12)
+#define DATA_FIELDS ((1ull << 48) - 1)
+#define DATA_MOVE_BITS 0x1fffull
+#define DATA_DEPTH(data) ((int)(uint8_t)((data) >> 32))
+#define DATA_BOUND(data) ((enum HashBound)(((data) >> 40) & 3))
+
+#define BUCKET_BYTES (ANALYSIS_CACHE_BUCKET * sizeof(HashEntry))
+
+_Static_assert(sizeof(AnalysisCacheHeader) <= ANALYSIS_CACHE_HEADER_SIZE, "AnalysisCacheHeader has to fit its padding");
+
+static inline uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Where the key isn't known it is taken from the entry as key ^ data, which a plain xor of key and
+// data would cancel out of the checksum
+static inline uint64_t seal(uint64_t key, uint64_t data) {
+    data &= DATA_FIELDS;
+    return data | (mix(mix(key) + data) >> 48) << 48;
+}
+
+static inline bool is_sealed(uint64_t key, uint64_t data) { return data != 0 && seal(key, data) == data; }
+
+static uint64_t header_checksum(const AnalysisCacheHeader *header) {
+    const uint8_t *bytes = (const uint8_t *)header;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < offsetof(AnalysisCacheHeader, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static inline size_t file_size(uint64_t num_buckets) { return ANALYSIS_CACHE_HEADER_SIZE + num_buckets * BUCKET_BYTES; }
+
+static inline uint64_t encode_move(const Chess *chess, const Move *move) {
+    return move == NULL ? 0 : PositionIndex_encode_move(chess, *move) | DATA_HAS_MOVE;
+}
+
+// inverse of relative_square for white
+static inline Pos square_pos(const Chess *chess, int square) {
+    int row = square / CHESS_BOARD_COLS;
+
+    return (Pos){chess->white_at_bottom ? row : CHESS_BOARD_ROWS - 1 - row, square % CHESS_BOARD_COLS};
+}
+
+// Maps the file, creating it with size_mb first when writable, size_mb isn't 0 and it's missing or
+// empty. Creating and checking the header happen under a lock on the file, so processes opening it
+// at the same time don't read each other's half written header. False with a message on anything
+// else than a cache file of this version
+static bool map_file(AnalysisCache *cache, bool writable) {
+    bool create = writable && cache->size_mb > 0;
+    int fd = open(cache->path, writable ? O_RDWR | (create ? O_CREAT : 0) : O_RDONLY, 0644);
+
+    if (fd < 0) {
+        printf("Failed to open %s\n", cache->path);
+        return false;
+    }
+
+    struct flock lock = {.l_type = writable ? F_WRLCK : F_RDLCK, .l_whence = SEEK_SET};
+    struct stat st;
+
+    if (fcntl(fd, F_SETLKW, &lock) != 0 || fstat(fd, &st) != 0) {
+        printf("Failed to lock %s\n", cache->path);
+        close(fd);
+        return false;
+    }
+
+    AnalysisCacheHeader header = {0};
+
+    if (st.st_size == 0 && create) {
+        uint64_t num_buckets = 1;
+
+        while (num_buckets * 2 * BUCKET_BYTES <= cache->size_mb * 1024 * 1024) {
+            num_buckets *= 2;
+        }
+
+        memcpy(header.magic, ANALYSIS_CACHE_MAGIC, sizeof(header.magic));
+        header.version = ANALYSIS_CACHE_VERSION;
+        header.entry_size = sizeof(HashEntry);
+        header.num_buckets = num_buckets;
+        header.checksum = header_checksum(&header);
+
+        // the entries are the zeros of the truncated file
+        if (ftruncate(fd, file_size(num_buckets)) != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            printf("Failed to create %s\n", cache->path);
+            close(fd);
+            return false;
+        }
+
+        st.st_size = file_size(num_buckets);
+    } else if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        header = (AnalysisCacheHeader){0};
+    }
+
+    bool valid = memcmp(header.magic, ANALYSIS_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == ANALYSIS_CACHE_VERSION &&
+                 header.entry_size == sizeof(HashEntry) && header.checksum == header_checksum(&header) && header.num_buckets != 0 &&
+                 (header.num_buckets & (header.num_buckets - 1)) == 0 && file_size(header.num_buckets) == (size_t)st.st_size;
+
+    if (!valid) {
+        printf("%s is not an analysis cache (or was written by another version)\n", cache->path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+    // releases the lock as well
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        printf("Failed to map %s\n", cache->path);
+        return false;
+    }
+
+    // a search touches one bucket here and there
+    posix_madvise(map, st.st_size, POSIX_MADV_RANDOM);
+
+    cache->map = map;
+    cache->map_size = st.st_size;
+    cache->entries = (HashEntry *)((char *)map + ANALYSIS_CACHE_HEADER_SIZE);
+    cache->bucket_mask = header.num_buckets - 1;
+
+    return true;
+}
+
+// Opens the file on first use. A file that can't be used disables the cache, the search goes on
+// without it
+static inline bool ensure_mapped(AnalysisCache *cache) {
+    int state = atomic_load_explicit(&cache->state, memory_order_acquire);
+
+    if (state != AnalysisCacheClosed) {
+        return state == AnalysisCacheMapped;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    if (atomic_load_explicit(&cache->state, memory_order_relaxed) == AnalysisCacheClosed) {
+        bool mapped = map_file(cache, true);
+
+        if (!mapped) {
+            printf("Analysis cache disabled\n");
+        }
+
+        atomic_store_explicit(&cache->state, mapped ? AnalysisCacheMapped : AnalysisCacheFailed, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return atomic_load_explicit(&cache->state, memory_order_acquire) == AnalysisCacheMapped;
+}
+
+// False with a message when path doesn't fit, a truncated one would name another file
+static bool set_path(AnalysisCache *cache, const char *path) {
+    if (snprintf(cache->path, sizeof(cache->path), "%s", path) >= (int)sizeof(cache->path)) {
+        printf("Cache path too long: %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+// Nothing is opened until the first lookup or store, so creating one costs nothing at startup. A
+// missing file is created then with size_mb, size_mb = 0 only uses an existing one. NULL with a
+// message when the path is too long
+AnalysisCache *AnalysisCache_new(const char *path, size_t size_mb) {
+    AnalysisCache *cache = calloc(1, sizeof(AnalysisCache));
+
+    if (cache == NULL) {
+        printf("Failed to allocate analysis cache\n");
+        exit(1);
+    }
+
+    if (!set_path(cache, path)) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->size_mb = size_mb;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+// The stored results are in the page cache already, the kernel writes them back after munmap
+void AnalysisCache_free(AnalysisCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    if (cache->map != NULL) {
+        munmap(cache->map, cache->map_size);
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static inline HashEntry *bucket_of(const AnalysisCache *cache, uint64_t key) {
+    return &cache->entries[(key & cache->bucket_mask) * ANALYSIS_CACHE_BUCKET];
+}
+
+// The same position is replaced only with a deeper or exact result, like in the HashTable. Another
+// position goes to an empty entry or else the shallowest one, which with keep_deeper it only
+// replaces when it is at least as deep
+static void store_data(AnalysisCache *cache, uint64_t key, uint64_t data, bool keep_deeper) {
+    HashEntry *bucket = bucket_of(cache, key);
+    HashEntry *target = NULL;
+    int target_depth = ENGINE_MAX_PLY + 1;
+    bool same = false;
+
+    for (int i = 0; i < ANALYSIS_CACHE_BUCKET; i++) {
+        uint64_t stored = atomic_load_explicit(&bucket[i].key, memory_order_relaxed);
+        uint64_t old = atomic_load_explicit(&bucket[i].data, memory_order_relaxed);
+
+        if ((stored ^ old) == key && is_sealed(key, old)) {
+            if (DATA_DEPTH(data) < DATA_DEPTH(old) && DATA_BOUND(data) != HashBoundExact) {
+                return;
+            }
+
+            // keep the old move when there is no new one
+            if ((data & DATA_HAS_MOVE) == 0) {
+                data |= old & DATA_MOVE_BITS;
+            }
+
+            target = &bucket[i];
+            same = true;
+            break;
+        }
+
+        // empty and damaged entries count as shallowest
+        int depth = is_sealed(stored ^ old, old) ? DATA_DEPTH(old) : -1;
+
+        if (depth < target_depth) {
+            target = &bucket[i];
+            target_depth = depth;
+        }
+    }
+
+    if (!same && keep_deeper && DATA_DEPTH(data) < target_depth) {
+        return;
+    }
+
+    data = seal(key, data);
+
+    atomic_store_explicit(&target->key, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&target->data, data, memory_order_relaxed);
+}
+
+bool AnalysisCache_probe(AnalysisCache *cache, const Chess *chess, HashHit *out) {
+    if (!ensure_mapped(cache)) {
+        return false;
+    }
+
+    uint64_t key = PositionIndex_key(chess);
+    HashEntry *bucket = bucket_of(cache, key);
+
+    for (int i = 0; i < ANALYSIS_CACHE_BUCKET; i++) {
+        uint64_t stored = atomic_load_explicit(&bucket[i].key, memory_order_relaxed);
+        uint64_t data = atomic_load_explicit(&bucket[i].data, memory_order_relaxed);
+
+        if ((stored ^ data) != key || !is_sealed(key, data)) {
+            continue;
+        }
+
+        out->has_move = (data & DATA_HAS_MOVE) != 0;
+        out->move = (Move){.from = square_pos(chess, data & 63), .to = square_pos(chess, (data >> 6) & 63)};
+        out->score = (int16_t)(uint16_t)(data >> 16);
+        out->depth = DATA_DEPTH(data);
+        out->bound = DATA_BOUND(data);
+
+        return true;
+    }
+
+    return false;
+}
+
+void AnalysisCache_store(AnalysisCache *cache, const Chess *chess, const Move *move, int score, int depth, enum HashBound bound) {
+    if (!ensure_mapped(cache)) {
+        return;
+    }
+
+    uint64_t data = encode_move(chess, move) | (uint64_t)(uint16_t)(int16_t)score << 16 | (uint64_t)(uint8_t)depth << 32 | (uint64_t)bound << 40;
+
+    store_data(cache, PositionIndex_key(chess), data, false);
+}
+
+bool AnalysisCache_info(AnalysisCache *cache, AnalysisCacheInfo *info) {
+    *info = (AnalysisCacheInfo){0};
+
+    if (!ensure_mapped(cache)) {
+        return false;
+    }
+
+    info->capacity = (cache->bucket_mask + 1) * ANALYSIS_CACHE_BUCKET;
+
+    for (uint64_t i = 0; i < info->capacity; i++) {
+        uint64_t stored = atomic_load_explicit(&cache->entries[i].key, memory_order_relaxed);
+        uint64_t data = atomic_load_explicit(&cache->entries[i].data, memory_order_relaxed);
+
+        if (data == 0) {
+            continue;
+        }
+
+        if (!is_sealed(stored ^ data, data)) {
+            info->corrupt++;
+            continue;
+        }
+
+        int depth = DATA_DEPTH(data);
+
+        info->used++;
+        info->depths[depth < ENGINE_MAX_PLY ? depth : ENGINE_MAX_PLY - 1]++;
+    }
+
+    return true;
+}
+
+// Adds the entries of another cache file, of any size, keeping the deeper result where both have
+// one. Returns the number of entries read, -1 when either file can't be used
+int64_t AnalysisCache_merge(AnalysisCache *cache, const char *path) {
+    AnalysisCache source = {.state = AnalysisCacheClosed};
+
+    if (!set_path(&source, path) || !ensure_mapped(cache) || !map_file(&source, false)) {
+        return -1;
+    }
+
+    int64_t merged = 0;
+    uint64_t capacity = (source.bucket_mask + 1) * ANALYSIS_CACHE_BUCKET;
+
+    for (uint64_t i = 0; i < capacity; i++) {
+        uint64_t stored = atomic_load_explicit(&source.entries[i].key, memory_order_relaxed);
+        uint64_t data = atomic_load_explicit(&source.entries[i].data, memory_order_relaxed);
+
+        if (is_sealed(stored ^ data, data)) {
+            store_data(cache, stored ^ data, data, true);
+            merged++;
+        }
+    }
+
+    munmap(source.map, source.map_size);
+
+    return merged;
+}
+
+struct _CompactEntry {
+    uint64_t key;
+    uint64_t data;
+};
+typedef struct _CompactEntry CompactEntry;
+
+static int compare_deepest_first(const void *a, const void *b) {
+    return DATA_DEPTH(((const CompactEntry *)b)->data) - DATA_DEPTH(((const CompactEntry *)a)->data);
+}
+
+// Rewrites the file with size_mb (0 = its current size), dropping damaged entries and those with
+// less than min_depth. Entries are put in deepest first, so the deepest ones are kept when it
+// shrinks. The new file replaces the old one with a rename: processes that still have the old one
+// mapped keep writing to it, so this is for when nothing else uses the file
+bool AnalysisCache_compact(const char *path, size_t size_mb, int min_depth) {
+    AnalysisCache source = {.state = AnalysisCacheClosed};
+
+    if (!set_path(&source, path) || !map_file(&source, false)) {
+        return false;
+    }
+
+    CompactEntry *entries = NULL;
+    uint64_t capacity = (source.bucket_mask + 1) * ANALYSIS_CACHE_BUCKET;
+    size_t count = 0;
+
+    // counted first, the file is mostly empty when it was sized generously
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            entries = malloc((count + 1) * sizeof(CompactEntry));
+
+            if (entries == NULL) {
+                printf("Failed to allocate %zu entries\n", count);
+                exit(1);
+            }
+
+            count = 0;
+        }
+
+        for (uint64_t i = 0; i < capacity; i++) {
+            uint64_t stored = atomic_load_explicit(&source.entries[i].key, memory_order_relaxed);
+            uint64_t data = atomic_load_explicit(&source.entries[i].data, memory_order_relaxed);
+
+            if (is_sealed(stored ^ data, data) && DATA_DEPTH(data) >= min_depth) {
+                if (pass == 1) {
+                    entries[count] = (CompactEntry){stored ^ data, data};
+                }
+
+                count++;
+            }
+        }
+    }
+
+    if (size_mb == 0) {
+        size_mb = source.map_size < 1024 * 1024 ? 1 : source.map_size / (1024 * 1024);
+    }
+
+    munmap(source.map, source.map_size);
+
+    qsort(entries, count, sizeof(CompactEntry), compare_deepest_first);
+
+    // the .tmp file has to fit in a cache path as well, AnalysisCache_new says so when it doesn't
+    char tmp_path[sizeof(source.path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    AnalysisCache *target = AnalysisCache_new(tmp_path, size_mb);
+
+    if (target == NULL) {
+        free(entries);
+        return false;
+    }
+
+    unlink(tmp_path);
+
+    bool ok = ensure_mapped(target);
+
+    for (size_t i = 0; ok && i < count; i++) {
+        store_data(target, entries[i].key, entries[i].data, true);
+    }
+
+    ok = ok && msync(target->map, target->map_size, MS_SYNC) == 0;
+    AnalysisCache_free(target);
+    free(entries);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        printf("Failed to write %s\n", tmp_path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,505 @@
+#include "../chess/chess.h"
+#include "../chess/packed.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef ENGINE__
+#define ENGINE__
+
+#define ENGINE_MAX_PLY 64
+#define ENGINE_MAX_MOVES 256
+
+#define ENGINE_INF 32000
+#define ENGINE_MATE_SCORE 30000
+// anything above this is a forced mate
+#define ENGINE_MATE_BOUND (ENGINE_MATE_SCORE - ENGINE_MAX_PLY)
+
+#define GAME_MAX_PLIES 1024
+
+// most lines a multi-PV search reports
+#define ENGINE_MAX_LINES 32
+
+struct _Move {
+    Pos from;
+    Pos to;
+};
+typedef struct _Move Move;
+
+struct _EngineConfig {
+    char name[32];
+    // iterative deepening stops at `depth`, or as soon as `nodes` were searched (0 = no limit)
+    int depth;
+    uint64_t nodes;
+    bool use_nnue;
+    // size of the engine's own hash table, 0 = none (engine->hash can still point to a shared one)
+    int hash_mb;
+    // append a JSON line of search statistics per search to this file, "" = none
+    char stats_path[128];
+    // persistent analysis cache file, "" = none (engine->cache can still point to a shared one)
+    char cache_path[128];
+};
+typedef struct _EngineConfig EngineConfig;
+
+enum HashBound { HashBoundNone, HashBoundExact, HashBoundLower, HashBoundUpper };
+
+// Key and data are stored xor'ed together, an entry torn by two threads writing it at the same
+// time fails the key check instead of returning another position's data
+struct _HashEntry {
+    _Atomic uint64_t key;
+    _Atomic uint64_t data;
+};
+typedef struct _HashEntry HashEntry;
+
+// Transposition table keyed on PositionIndex_key, can be shared by any number of engines and threads
+struct _HashTable {
+    HashEntry *entries;
+    uint64_t mask;
+};
+typedef struct _HashTable HashTable;
+
+struct _HashHit {
+    Move move;
+    bool has_move;
+    int score;
+    int depth;
+    enum HashBound bound;
+};
+typedef struct _HashHit HashHit;
+
+struct _SearchResult {
+    // index of the line in a multi-PV search, 0 = best
+    int line;
+    Move best_move;
+    int score;
+    int depth;
+    uint64_t nodes;
+    int pv_length;
+    Move pv[ENGINE_MAX_PLY];
+};
+typedef struct _SearchResult SearchResult;
+
+typedef void (*SearchCallback)(const SearchResult *result, void *ctx);
+
+// Counters of one iteration of the iterative deepening. The node and hash counters are always
+// collected, the timers only when compiled with -DENGINE_STATS (two clock reads per call)
+struct _SearchDepthStats {
+    // search nodes (root included) and quiescence nodes
+    uint64_t nodes;
+    uint64_t qnodes;
+
+    // beta cutoffs in the main search, and those on the first legal move
+    uint64_t cutoffs;
+    uint64_t first_move_cutoffs;
+
+    uint64_t hash_probes;
+    uint64_t hash_hits;
+    // probes that found the slot taken by another position
+    uint64_t hash_collisions;
+    uint64_t hash_cutoffs;
+    // positions the hash table didn't have deep enough but the analysis cache did
+    uint64_t cache_hits;
+
+    // move generation (Engine_generate_moves and the copy-make with its move lists) and evaluation
+    uint64_t gen_ns;
+    uint64_t eval_ns;
+    uint64_t evals;
+
+    // wall time of the iteration
+    uint64_t ns;
+};
+typedef struct _SearchDepthStats SearchDepthStats;
+
+// Per engine, so per thread: nothing is shared while searching, SearchStats_merge adds up the
+// engines' numbers when they are reported
+struct _SearchStats {
+    uint64_t searches;
+    // deepest iteration started, depths[1..max_depth] are used
+    int max_depth;
+    SearchDepthStats depths[ENGINE_MAX_PLY];
+};
+typedef struct _SearchStats SearchStats;
+
+// Persistent analysis cache, see engine/cache.c. A header followed by buckets of
+// ANALYSIS_CACHE_BUCKET entries, used through a shared mapping so any number of threads and
+// processes can look up and add results at the same time
+#define ANALYSIS_CACHE_MAGIC "CHESSACH"
+#define ANALYSIS_CACHE_VERSION 1
+#define ANALYSIS_CACHE_BUCKET 4
+// bytes before the first bucket, the header is padded to a cache line
+#define ANALYSIS_CACHE_HEADER_SIZE 64
+// size of a file created by an engine with cache=<path>
+#define ANALYSIS_CACHE_DEFAULT_MB 64
+// shallower results are cheap to search again, they would only push the deep ones out
+#define ANALYSIS_CACHE_MIN_DEPTH 4
+
+struct _AnalysisCacheHeader {
+    char magic[8];
+    uint32_t version;
+    // sizeof(HashEntry)
+    uint32_t entry_size;
+    uint64_t num_buckets;
+    // of the fields above
+    uint64_t checksum;
+};
+typedef struct _AnalysisCacheHeader AnalysisCacheHeader;
+
+enum AnalysisCacheState { AnalysisCacheClosed, AnalysisCacheMapped, AnalysisCacheFailed };
+
+// The file is only opened (and created when missing) by the first lookup or store
+struct _AnalysisCache {
+    char path[256];
+    // of a new file
+    size_t size_mb;
+
+    pthread_mutex_t lock;
+    _Atomic int state;
+
+    void *map;
+    size_t map_size;
+    // entries have the HashEntry layout, see cache.c for the data
+    HashEntry *entries;
+    uint64_t bucket_mask;
+};
+typedef struct _AnalysisCache AnalysisCache;
+
+struct _AnalysisCacheInfo {
+    uint64_t capacity;
+    uint64_t used;
+    // entries failing their checksum
+    uint64_t corrupt;
+    // used entries per depth, deeper ones counted in the last
+    uint64_t depths[ENGINE_MAX_PLY];
+};
+typedef struct _AnalysisCacheInfo AnalysisCacheInfo;
+
+// One per thread. Owns one Chess (and its arena) per ply, so a search never allocates
+struct _Engine {
+    EngineConfig config;
+
+    Chess stack[ENGINE_MAX_PLY + 1];
+
+    // PositionIndex_key of the positions played before the root, for repetition detection
+    const uint64_t *history;
+    int history_len;
+
+    uint64_t nodes;
+    bool stop;
+
+    // Optional, set by the caller before Engine_search. The search stops once *cancel is set
+    // (from any thread) or CLOCK_MONOTONIC passes deadline_ns (0 = no deadline)
+    atomic_bool *cancel;
+    uint64_t deadline_ns;
+    uint64_t next_check;
+
+    // Optional, searched positions are looked up and stored here. Points to own_hash by default
+    HashTable *hash;
+    HashTable *own_hash;
+
+    // Optional, nodes with at least ANALYSIS_CACHE_MIN_DEPTH left are also looked up and stored
+    // here. Points to own_cache when config.cache_path is set
+    AnalysisCache *cache;
+    AnalysisCache *own_cache;
+
+    // Optional, called with the result of every completed iteration (once per line in multi-PV)
+    SearchCallback on_iteration;
+    void *callback_ctx;
+
+    Move pv[ENGINE_MAX_PLY][ENGINE_MAX_PLY];
+    int pv_length[ENGINE_MAX_PLY];
+
+    // principal variation of the previous iteration, searched first
+    Move prev_pv[ENGINE_MAX_PLY];
+    int prev_pv_length;
+
+    // best root moves of the iteration in progress, see Engine_search_multipv
+    SearchResult lines[ENGINE_MAX_LINES];
+
+    // statistics of the last search, cleared when the next one starts, and the iteration in progress
+    SearchStats stats;
+    SearchDepthStats *depth_stats;
+    // Optional, a JSON line of stats is written here after every search. Opened by Engine_new
+    // from config.stats_path
+    FILE *stats_out;
+};
+typedef struct _Engine Engine;
+
+// longest mate MateSolver looks for, in moves of the attacker
+#define MATE_MAX_MOVES 16
+#define MATE_MAX_PLY (MATE_MAX_MOVES * 2)
+
+enum MateStatus { MateFound, MateNone, MateUnknown };
+
+struct _MateResult {
+    // MateNone is a proof that there is no mate within the bound, MateUnknown hit the node limit
+    enum MateStatus status;
+    // mate in `moves` moves of the attacker
+    int moves;
+    // the attacker's shortest mate against the longest defence
+    int pv_length;
+    Move pv[MATE_MAX_PLY];
+    uint64_t nodes;
+};
+typedef struct _MateResult MateResult;
+
+struct _MateEntry {
+    uint64_t key;
+    uint32_t phi;
+    uint32_t delta;
+    // nodes spent below the entry, the cheapest one is replaced first
+    uint32_t work;
+};
+typedef struct _MateEntry MateEntry;
+
+// Proof-number mate solver, one per thread. Its table is the only memory it uses and has a fixed size
+struct _MateSolver {
+    Chess stack[MATE_MAX_PLY + 1];
+
+    MateEntry *table;
+    uint64_t mask;
+
+    uint64_t nodes;
+    uint64_t max_nodes;
+    bool aborted;
+};
+typedef struct _MateSolver MateSolver;
+
+// Position index over PGN archives, built by src/tools/pgnindex.c. One file, used through mmap as
+// is: header, entries sorted by (key, game, ply), directory, games, file names
+#define INDEX_MAGIC "CHESSIDX"
+#define INDEX_VERSION 1
+#define INDEX_FILE_NAME 256
+// directory[i] = first entry with key >> INDEX_DIRECTORY_SHIFT >= i
+#define INDEX_DIRECTORY_BITS 16
+#define INDEX_DIRECTORY_SHIFT (64 - INDEX_DIRECTORY_BITS)
+// next_move of the last position of a game
+#define INDEX_NO_MOVE 0xffff
+
+struct _IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_files;
+    uint64_t num_entries;
+    uint64_t num_games;
+    // byte offsets from the start of the file
+    uint64_t entries_offset;
+    uint64_t directory_offset;
+    uint64_t games_offset;
+    uint64_t files_offset;
+};
+typedef struct _IndexHeader IndexHeader;
+
+struct _IndexEntry {
+    // PositionIndex_key
+    uint64_t key;
+    uint32_t game;
+    uint16_t ply;
+    // from | to << 6, squares from white's point of view (0 = a8 ... 63 = h1)
+    uint16_t next_move;
+};
+typedef struct _IndexEntry IndexEntry;
+
+struct _IndexGame {
+    // where the game starts in its PGN file
+    uint64_t offset;
+    uint32_t file;
+    uint32_t plies;
+};
+typedef struct _IndexGame IndexGame;
+
+struct _PositionIndex {
+    void *map;
+    size_t size;
+
+    const IndexHeader *header;
+    const IndexEntry *entries;
+    const uint64_t *directory;
+    const IndexGame *games;
+    const char (*files)[INDEX_FILE_NAME];
+};
+typedef struct _PositionIndex PositionIndex;
+
+enum GameResult { GameOngoing, GameWhiteWins, GameBlackWins, GameDraw };
+
+// GameEndPromotion: stopped or adjudicated, the game needs a promotion and the core doesn't play
+// them. GameEndIllegalMove: lost by the side that tried an illegal move
+enum GameEndReason {
+    GameEndNone,
+    GameEndCheckmate,
+    GameEndStalemate,
+    GameEndRepetition,
+    GameEndFiftyMoves,
+    GameEndMaxPlies,
+    GameEndPromotion,
+    GameEndIllegalMove
+};
+
+struct _Game {
+    Chess chess;
+    // used for legality checks and notation, never visible outside of game.c
+    Chess scratch[2];
+
+    // history[i] = PositionIndex_key of the position after i plies, castling rights included
+    uint64_t history[GAME_MAX_PLIES + 1];
+    Move moves[GAME_MAX_PLIES];
+    int ply;
+
+    // plies since the last capture or pawn move
+    int halfmove_clock;
+};
+typedef struct _Game Game;
+
+// games per slab of a GameHost shard
+#define HOST_SLAB_GAMES 1024
+
+enum HostStatus { HostOk, HostNoGame, HostBadPosition, HostIllegalMove, HostGameOver };
+
+// What a GameHost keeps of a game between moves, a slot of a slab. The board lives in a Game only
+// while a move is checked or played, one borrowed from the host's pool
+struct _HostedGame {
+    // 0 while the slot is free
+    uint64_t id;
+    uint64_t last_active_ns;
+    PackedPosition position;
+    // every move played, from << 6 | to as board squares (white at the bottom)
+    uint16_t *moves;
+    // PositionIndex_key since the last capture or pawn move, the current position's last
+    uint64_t *keys;
+    uint32_t ply;
+    // free list link, slot index + 1
+    uint32_t next_free;
+    uint16_t moves_capacity;
+    uint8_t keys_capacity;
+    uint8_t num_keys;
+    // enum GameResult / enum GameEndReason, worked out when the game was created or last moved
+    uint8_t result;
+    uint8_t reason;
+};
+typedef struct _HostedGame HostedGame;
+
+// Games are spread over the shards by id, each shard has its own lock, slabs and id table
+struct _HostShard {
+    _Alignas(64) pthread_mutex_t lock;
+
+    HostedGame **slabs;
+    int num_slabs;
+    uint32_t free_list;
+
+    // open addressing, slot index + 1, 0 = empty
+    uint32_t *table;
+    uint32_t table_mask;
+    uint32_t count;
+};
+typedef struct _HostShard HostShard;
+
+// Many concurrent games in one process
+struct _GameHost {
+    HostShard *shards;
+    int num_shards;
+    atomic_uint_fast64_t next_id;
+
+    // Games to play moves on, borrowed for the length of one call
+    pthread_mutex_t pool_lock;
+    Game **pool;
+    int pool_count;
+    int pool_capacity;
+};
+typedef struct _GameHost GameHost;
+
+struct _HostedGameInfo {
+    Position position;
+    int ply;
+    enum GameResult result;
+    enum GameEndReason reason;
+};
+typedef struct _HostedGameInfo HostedGameInfo;
+
+struct _HostStats {
+    size_t games;
+    // slabs, id tables and move histories, not the pooled Games
+    size_t bytes;
+    int pooled_games;
+};
+typedef struct _HostStats HostStats;
+
+// engine/search.c
+uint64_t Engine_now_ns(void);
+void Engine_init_chess(Chess *game);
+void Engine_free_chess(Chess *game);
+int Engine_generate_moves(const Chess *game, Move *moves);
+bool Engine_make_move(Chess *dst, const Chess *src, Move move);
+bool Engine_in_check(const Chess *game, enum Color color);
+Engine *Engine_new(EngineConfig config);
+void Engine_free(Engine *engine);
+SearchResult Engine_search(Engine *engine, const Chess *root, const uint64_t *history, int history_len);
+int Engine_search_multipv(Engine *engine, const Chess *root, const uint64_t *history, int history_len, SearchResult *lines, int num_lines);
+bool Engine_parse_config(const char *str, EngineConfig *config);
+
+// engine/stats.c
+void SearchStats_merge(SearchStats *into, const SearchStats *from);
+void SearchStats_write_json(const SearchStats *stats, const char *name, FILE *out);
+
+// engine/hash.c
+HashTable *HashTable_new(size_t size_mb);
+void HashTable_free(HashTable *table);
+void HashTable_clear(HashTable *table);
+bool HashTable_probe(const HashTable *table, uint64_t key, HashHit *out);
+void HashTable_store(HashTable *table, uint64_t key, const Move *move, int score, int depth, enum HashBound bound);
+
+// engine/cache.c
+AnalysisCache *AnalysisCache_new(const char *path, size_t size_mb);
+void AnalysisCache_free(AnalysisCache *cache);
+bool AnalysisCache_probe(AnalysisCache *cache, const Chess *chess, HashHit *out);
+void AnalysisCache_store(AnalysisCache *cache, const Chess *chess, const Move *move, int score, int depth, enum HashBound bound);
+bool AnalysisCache_info(AnalysisCache *cache, AnalysisCacheInfo *info);
+int64_t AnalysisCache_merge(AnalysisCache *cache, const char *path);
+bool AnalysisCache_compact(const char *path, size_t size_mb, int min_depth);
+
+// engine/mate.c
+MateSolver *MateSolver_new(size_t table_mb);
+void MateSolver_free(MateSolver *solver);
+MateResult MateSolver_solve(MateSolver *solver, const Chess *root, int max_moves, uint64_t max_nodes);
+const char *Mate_status_string(enum MateStatus status);
+
+// engine/index.c
+uint64_t PositionIndex_key(const Chess *chess);
+uint16_t PositionIndex_encode_move(const Chess *chess, Move move);
+void PositionIndex_move_name(uint16_t move, char out[6]);
+bool PositionIndex_open(PositionIndex *index, const char *path);
+void PositionIndex_close(PositionIndex *index);
+size_t PositionIndex_find(const PositionIndex *index, uint64_t key, const IndexEntry **first);
+
+// engine/game.c
+Game *Game_new(void);
+void Game_free(Game *game);
+void Game_reset(Game *game);
+bool Game_load_fen(Game *game, const char *fen);
+void Game_to_fen(const Game *game, char *out);
+void Game_to_position(const Game *game, Position *position);
+int Game_legal_moves(Game *game, Move *moves);
+bool Game_play_move(Game *game, Move move);
+bool Game_is_promotion(const Game *game, Move move);
+enum GameResult Game_result(Game *game, enum GameEndReason *reason);
+const char *Game_result_string(enum GameResult result);
+const char *Game_end_reason_string(enum GameEndReason reason);
+void Game_move_to_uci(const Game *game, Move move, char out[6]);
+bool Game_parse_uci(Game *game, const char *str, Move *move);
+bool Game_parse_san(Game *game, const char *str, Move *move);
+void Game_move_to_san(Game *game, Move move, char out[8]);
+
+// engine/host.c
+GameHost *GameHost_new(int num_shards);
+void GameHost_free(GameHost *host);
+enum HostStatus GameHost_create(GameHost *host, const char *fen, uint64_t *id);
+enum HostStatus GameHost_play(GameHost *host, uint64_t id, Move move, HostedGameInfo *info);
+enum HostStatus GameHost_query(GameHost *host, uint64_t id, HostedGameInfo *info);
+enum HostStatus GameHost_legal_moves(GameHost *host, uint64_t id, Move *moves, int *count);
+enum HostStatus GameHost_moves(GameHost *host, uint64_t id, Move *moves, int max_moves, int *count);
+bool GameHost_remove(GameHost *host, uint64_t id);
+int GameHost_expire(GameHost *host, uint64_t idle_ns);
+void GameHost_stats(GameHost *host, HostStats *stats);
+const char *Host_status_string(enum HostStatus status);
+
+#endif // !ENGINE__
@@ -0,0 +1,384 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Game *Game_new(void) {
+    Game *game = calloc(1, sizeof(Game));
+
+    if (game == NULL) {
+        printf("Failed to allocate game\n");
+        exit(1);
+    }
+
+    Engine_init_chess(&game->chess);
+    Engine_init_chess(&game->scratch[0]);
+    Engine_init_chess(&game->scratch[1]);
+
+    Game_reset(game);
+
+    return game;
+}
+
+void Game_free(Game *game) {
+    Engine_free_chess(&game->chess);
+    Engine_free_chess(&game->scratch[0]);
+    Engine_free_chess(&game->scratch[1]);
+    free(game);
+}
+
+// Back to the starting position, keeping the arenas
+void Game_reset(Game *game) {
+    Arena arena = game->chess.arena;
+    arena_reset(&arena);
+
+    game->chess = (Chess){.arena = arena, .white_at_bottom = true, .current_turn = ColorWhite};
+
+    Chess_init_board(&game->chess);
+    Chess_calculate_moves(&game->chess);
+
+    game->ply = 0;
+    game->halfmove_clock = 0;
+    game->history[0] = PositionIndex_key(&game->chess);
+}
+
+// The halfmove clock is taken from the FEN, the played moves start from scratch
+bool Game_load_fen(Game *game, const char *fen) {
+    if (!Chess_load_fen(&game->chess, fen)) {
+        return false;
+    }
+
+    Chess_calculate_moves(&game->chess);
+
+    int halfmove_clock = 0;
+
+    if (sscanf(fen, "%*s %*s %*s %*s %d", &halfmove_clock) != 1 || halfmove_clock < 0) {
+        halfmove_clock = 0;
+    }
+
+    game->ply = 0;
+    game->halfmove_clock = halfmove_clock;
+    game->history[0] = PositionIndex_key(&game->chess);
+
+    return true;
+}
+
+// The fullmove number counts from the loaded position, see Game_load_fen
+void Game_to_fen(const Game *game, char *out) { Chess_to_fen(&game->chess, game->halfmove_clock, game->ply / 2 + 1, out); }
+
+// Position_from_chess with the move counters of Game_to_fen
+void Game_to_position(const Game *game, Position *position) {
+    Position_from_chess(position, &game->chess);
+    position->halfmove_clock = game->halfmove_clock < 255 ? game->halfmove_clock : 255;
+    position->fullmove_number = game->ply / 2 + 1;
+}
+
+int Game_legal_moves(Game *game, Move *moves) {
+    Move pseudo[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(&game->chess, pseudo);
+    int legal = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (Chess_is_legal_move(&game->chess, pseudo[i].from, pseudo[i].to)) {
+            moves[legal++] = pseudo[i];
+        }
+    }
+
+    return legal;
+}
+
+bool Game_play_move(Game *game, Move move) {
+    if (game->ply >= GAME_MAX_PLIES) {
+        return false;
+    }
+
+    // rejects illegal moves before paying for the copy
+    if (!Chess_is_legal_move(&game->chess, move.from, move.to)) {
+        return false;
+    }
+
+    const Piece *piece = &game->chess.board[move.from.row][move.from.col].piece;
+    bool resets_clock = piece->type == Pawn || game->chess.board[move.to.row][move.to.col].piece.type != UndefPieceType;
+
+    if (!Engine_make_move(&game->scratch[0], &game->chess, move)) {
+        return false;
+    }
+
+    Chess_copy(&game->chess, &game->scratch[0]);
+
+    game->halfmove_clock = resets_clock ? 0 : game->halfmove_clock + 1;
+    game->moves[game->ply++] = move;
+    game->history[game->ply] = PositionIndex_key(&game->chess);
+
+    return true;
+}
+
+// A pawn move to the last rank. The move generator has no promotions, it would leave a pawn there
+bool Game_is_promotion(const Game *game, Move move) {
+    return game->chess.board[move.from.row][move.from.col].piece.type == Pawn && (move.to.row == 0 || move.to.row == CHESS_BOARD_ROWS - 1);
+}
+
+enum GameResult Game_result(Game *game, enum GameEndReason *reason) {
+    Move moves[ENGINE_MAX_MOVES];
+    *reason = GameEndNone;
+
+    if (Game_legal_moves(game, moves) == 0) {
+        if (Engine_in_check(&game->chess, game->chess.current_turn)) {
+            *reason = GameEndCheckmate;
+            return game->chess.current_turn == ColorWhite ? GameBlackWins : GameWhiteWins;
+        }
+
+        *reason = GameEndStalemate;
+        return GameDraw;
+    }
+
+    if (game->halfmove_clock >= 100) {
+        *reason = GameEndFiftyMoves;
+        return GameDraw;
+    }
+
+    int repetitions = 0;
+    uint64_t key = game->history[game->ply];
+
+    for (int i = game->ply; i >= game->ply - game->halfmove_clock && i >= 0; i -= 2) {
+        if (game->history[i] == key) {
+            repetitions++;
+        }
+    }
+
+    if (repetitions >= 3) {
+        *reason = GameEndRepetition;
+        return GameDraw;
+    }
+
+    if (game->ply >= GAME_MAX_PLIES) {
+        *reason = GameEndMaxPlies;
+        return GameDraw;
+    }
+
+    return GameOngoing;
+}
+
+const char *Game_result_string(enum GameResult result) {
+    switch (result) {
+        case GameOngoing:
+            return "*";
+        case GameWhiteWins:
+            return "1-0";
+        case GameBlackWins:
+            return "0-1";
+        case GameDraw:
+            return "1/2-1/2";
+    }
+
+    assert(false && "Unknown game result");
+}
+
+const char *Game_end_reason_string(enum GameEndReason reason) {
+    switch (reason) {
+        case GameEndNone:
+            return "none";
+        case GameEndCheckmate:
+            return "checkmate";
+        case GameEndStalemate:
+            return "stalemate";
+        case GameEndRepetition:
+            return "threefold repetition";
+        case GameEndFiftyMoves:
+            return "fifty move rule";
+        case GameEndMaxPlies:
+            return "max plies";
+        case GameEndPromotion:
+            return "promotion";
+        case GameEndIllegalMove:
+            return "illegal move";
+    }
+
+    assert(false && "Unknown game end reason");
+}
+
+void Game_move_to_uci(const Game *game, Move move, char out[6]) {
+    Chess_square_name(&game->chess, move.from, out);
+    Chess_square_name(&game->chess, move.to, out + 2);
+}
+
+// Exactly four characters, there are no promotions ("e7e8q")
+bool Game_parse_uci(Game *game, const char *str, Move *move) {
+    if (strlen(str) != 4 || !Chess_parse_square(&game->chess, str, &move->from) || !Chess_parse_square(&game->chess, str + 2, &move->to)) {
+        return false;
+    }
+
+    return true;
+}
+
+static const char SanPieceLetter[7] = {'?', 'K', 'Q', 'R', 'B', 'N', '\0'};
+
+// SAN as written in PGN ("Nbd7", "exd5", "O-O", "Qh4+!?"), check and annotation marks are ignored.
+// Promotions and en passant aren't supported by the move generator, those fail like illegal moves
+bool Game_parse_san(Game *game, const char *str, Move *move) {
+    const Chess *chess = &game->chess;
+
+    char san[16];
+    size_t len = strcspn(str, "+#!? \t\r\n");
+
+    if (len == 0 || len >= sizeof(san) || memchr(str, '=', len) != NULL) {
+        return false;
+    }
+
+    memcpy(san, str, len);
+    san[len] = '\0';
+
+    enum PieceType type = Pawn;
+    int castle_cols = 0;
+
+    if (strcmp(san, "O-O") == 0 || strcmp(san, "0-0") == 0) {
+        type = King;
+        castle_cols = 2;
+    } else if (strcmp(san, "O-O-O") == 0 || strcmp(san, "0-0-0") == 0) {
+        type = King;
+        castle_cols = -2;
+    } else {
+        for (int t = King; t < Pawn; t++) {
+            if (san[0] == SanPieceLetter[t]) {
+                type = t;
+            }
+        }
+    }
+
+    Pos to = {0};
+    int from_col = -1, from_row = -1;
+
+    if (castle_cols == 0) {
+        if (len < 2 || !Chess_parse_square(chess, san + len - 2, &to)) {
+            return false;
+        }
+
+        // whatever is left between the piece letter and the target square: file, rank, 'x'
+        for (const char *c = san + (type != Pawn); c < san + len - 2; c++) {
+            char square[3] = {'a', *c, '\0'};
+            Pos pos;
+
+            if (*c >= 'a' && *c <= 'h') {
+                from_col = *c - 'a';
+            } else if (*c >= '1' && *c <= '8' && Chess_parse_square(chess, square, &pos)) {
+                from_row = pos.row;
+            } else if (*c != 'x') {
+                return false;
+            }
+        }
+    }
+
+    Move pseudo[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(chess, pseudo);
+    int candidates = 0;
+
+    for (int i = 0; i < n; i++) {
+        const Piece *piece = &chess->board[pseudo[i].from.row][pseudo[i].from.col].piece;
+
+        if (piece->type != type || (from_col >= 0 && pseudo[i].from.col != from_col) || (from_row >= 0 && pseudo[i].from.row != from_row)) {
+            continue;
+        }
+
+        if (castle_cols != 0 ? pseudo[i].to.col - pseudo[i].from.col != castle_cols : (pseudo[i].to.row != to.row || pseudo[i].to.col != to.col)) {
+            continue;
+        }
+
+        pseudo[candidates++] = pseudo[i];
+    }
+
+    // a single candidate is left to Game_play_move to check
+    if (candidates == 1) {
+        *move = pseudo[0];
+        return true;
+    }
+
+    // SAN leaves out disambiguation against pinned pieces
+    int legal = 0;
+
+    for (int i = 0; i < candidates; i++) {
+        if (Chess_is_legal_move(chess, pseudo[i].from, pseudo[i].to)) {
+            *move = pseudo[i];
+            legal++;
+        }
+    }
+
+    return legal == 1;
+}
+
+// SAN for a legal move in the current position
+void Game_move_to_san(Game *game, Move move, char out[8]) {
+    const Chess *chess = &game->chess;
+    const Piece *piece = &chess->board[move.from.row][move.from.col].piece;
+    bool is_capture = chess->board[move.to.row][move.to.col].piece.type != UndefPieceType;
+
+    char *p = out;
+    char square[3];
+
+    if (piece->type == King && abs(move.to.col - move.from.col) == 2) {
+        p += sprintf(p, move.to.col > move.from.col ? "O-O" : "O-O-O");
+    } else if (piece->type == Pawn) {
+        Chess_square_name(chess, move.from, square);
+
+        if (is_capture) {
+            *p++ = square[0];
+            *p++ = 'x';
+        }
+
+        Chess_square_name(chess, move.to, square);
+        p += sprintf(p, "%s", square);
+    } else {
+        *p++ = SanPieceLetter[piece->type];
+
+        // disambiguate against other pieces of the same type that can go to the same square
+        Move moves[ENGINE_MAX_MOVES];
+        int n = Game_legal_moves(game, moves);
+        bool ambiguous = false, same_col = false, same_row = false;
+
+        for (int i = 0; i < n; i++) {
+            const Piece *other = &chess->board[moves[i].from.row][moves[i].from.col].piece;
+
+            if (other->type != piece->type || moves[i].to.row != move.to.row || moves[i].to.col != move.to.col ||
+                (moves[i].from.row == move.from.row && moves[i].from.col == move.from.col)) {
+                continue;
+            }
+
+            ambiguous = true;
+            same_col |= moves[i].from.col == move.from.col;
+            same_row |= moves[i].from.row == move.from.row;
+        }
+
+        Chess_square_name(chess, move.from, square);
+
+        if (ambiguous && (!same_col || same_row)) {
+            *p++ = square[0];
+        }
+
+        if (ambiguous && same_col) {
+            *p++ = square[1];
+        }
+
+        if (is_capture) {
+            *p++ = 'x';
+        }
+
+        Chess_square_name(chess, move.to, square);
+        p += sprintf(p, "%s", square);
+    }
+
+    *p = '\0';
+
+    if (!Engine_make_move(&game->scratch[1], chess, move) || !Engine_in_check(&game->scratch[1], game->scratch[1].current_turn)) {
+        return;
+    }
+
+    // checkmate if the opponent has no legal reply
+    Move replies[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(&game->scratch[1], replies);
+    bool has_reply = false;
+
+    for (int i = 0; i < n && !has_reply; i++) {
+        has_reply = Engine_make_move(&game->scratch[0], &game->scratch[1], replies[i]);
+    }
+
+    strcat(out, has_reply ? "+" : "#");
+}
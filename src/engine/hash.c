@@ -0,0 +1,110 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Entry data layout:
+//   bits  0-5   from square (row * 8 + col)
+//   bits  6-11  to square
+//   bit   12    has a move
+//   bits 16-31  score (int16)
+//   bits 32-39  depth
+//   bits 40-41  enum HashBound
+#define DATA_HAS_MOVE (1ull << 12)
+
+static inline uint64_t pack(Move move, bool has_move, int score, int depth, enum HashBound bound) {
+    uint64_t data = (uint64_t)SQUARE(move.from.row, move.from.col) | (uint64_t)SQUARE(move.to.row, move.to.col) << 6;
+
+    if (has_move) {
+        data |= DATA_HAS_MOVE;
+    }
+
+    return data | (uint64_t)(uint16_t)(int16_t)score << 16 | (uint64_t)(uint8_t)depth << 32 | (uint64_t)bound << 40;
+}
+
+static inline void unpack(uint64_t data, HashHit *out) {
+    int from = data & 63;
+    int to = (data >> 6) & 63;
+
+    out->has_move = (data & DATA_HAS_MOVE) != 0;
+    out->move = (Move){.from = {SQUARE_ROW(from), SQUARE_COL(from)}, .to = {SQUARE_ROW(to), SQUARE_COL(to)}};
+    out->score = (int16_t)(uint16_t)(data >> 16);
+    out->depth = (uint8_t)(data >> 32);
+    out->bound = (enum HashBound)((data >> 40) & 3);
+}
+
+HashTable *HashTable_new(size_t size_mb) {
+    HashTable *table = calloc(1, sizeof(HashTable));
+
+    // round down to a power of two so the index is a mask
+    size_t count = 1;
+
+    while (count * 2 * sizeof(HashEntry) <= size_mb * 1024 * 1024) {
+        count *= 2;
+    }
+
+    if (table != NULL) {
+        table->entries = calloc(count, sizeof(HashEntry));
+    }
+
+    if (table == NULL || table->entries == NULL) {
+        printf("Failed to allocate a %zu MB hash table\n", size_mb);
+        exit(1);
+    }
+
+    table->mask = count - 1;
+
+    return table;
+}
+
+void HashTable_free(HashTable *table) {
+    if (table == NULL) {
+        return;
+    }
+
+    free(table->entries);
+    free(table);
+}
+
+void HashTable_clear(HashTable *table) {
+    for (size_t i = 0; i <= table->mask; i++) {
+        atomic_store_explicit(&table->entries[i].key, 0, memory_order_relaxed);
+        atomic_store_explicit(&table->entries[i].data, 0, memory_order_relaxed);
+    }
+}
+
+bool HashTable_probe(const HashTable *table, uint64_t key, HashHit *out) {
+    HashEntry *entry = &table->entries[key & table->mask];
+
+    uint64_t stored = atomic_load_explicit(&entry->key, memory_order_relaxed);
+    uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+    // a write torn by another thread doesn't match either
+    if ((stored ^ data) != key || data == 0) {
+        return false;
+    }
+
+    unpack(data, out);
+
+    return true;
+}
+
+// Replaces other positions always, the same position only with a deeper or exact result
+void HashTable_store(HashTable *table, uint64_t key, const Move *move, int score, int depth, enum HashBound bound) {
+    HashEntry *entry = &table->entries[key & table->mask];
+    HashHit old = {0};
+
+    bool same = HashTable_probe(table, key, &old);
+
+    if (same && depth < old.depth && bound != HashBoundExact) {
+        return;
+    }
+
+    // keep the old move when there is no new one, it's still the best guess for ordering
+    Move stored_move = move != NULL ? *move : old.move;
+    bool has_move = move != NULL || (same && old.has_move);
+
+    uint64_t data = pack(stored_move, has_move, score, depth, bound);
+
+    atomic_store_explicit(&entry->key, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
@@ -0,0 +1,569 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A hosted game is a fixed size slot in a slab plus its move history: a PackedPosition and the
+// keys since the last irreversible move are enough to play on, check the move and detect the end
+// of the game. A move is played on a Game from the host's pool, loaded from the slot and packed
+// back afterwards, the pool only grows to the number of calls running at the same time.
+//
+// Every call locks the shard of its game for its whole length, calls on different shards run in
+// parallel. Slabs are kept when games go away, their slots are reused.
+
+#define HOST_MIN_TABLE 1024
+#define HOST_MIN_MOVES 16
+#define HOST_MIN_KEYS 4
+
+static inline HostedGame *slot(const HostShard *shard, uint32_t index) {
+    return &shard->slabs[index / HOST_SLAB_GAMES][index % HOST_SLAB_GAMES];
+}
+
+static inline uint32_t home_bucket(const HostShard *shard, uint64_t id) {
+    return (uint32_t)((id * 0x9E3779B97F4A7C15ull) >> 32) & shard->table_mask;
+}
+
+static inline HostShard *shard_of(GameHost *host, uint64_t id) { return &host->shards[id % host->num_shards]; }
+
+static void *checked_realloc(void *ptr, size_t size) {
+    void *result = realloc(ptr, size);
+
+    if (result == NULL) {
+        printf("Failed to allocate hosted games\n");
+        exit(1);
+    }
+
+    return result;
+}
+
+static inline uint16_t encode_move(Move move) {
+    return (uint16_t)(SQUARE(move.from.row, move.from.col) << 6 | SQUARE(move.to.row, move.to.col));
+}
+
+static inline Move decode_move(uint16_t move) {
+    int from = move >> 6, to = move & 63;
+    return (Move){.from = {SQUARE_ROW(from), SQUARE_COL(from)}, .to = {SQUARE_ROW(to), SQUARE_COL(to)}};
+}
+
+GameHost *GameHost_new(int num_shards) {
+    GameHost *host = calloc(1, sizeof(GameHost));
+    num_shards = num_shards < 1 ? 1 : num_shards;
+    HostShard *shards = aligned_alloc(_Alignof(HostShard), sizeof(HostShard) * num_shards);
+
+    if (host == NULL || shards == NULL) {
+        printf("Failed to allocate the game host\n");
+        exit(1);
+    }
+
+    host->shards = shards;
+    host->num_shards = num_shards;
+
+    for (int i = 0; i < host->num_shards; i++) {
+        HostShard *shard = &host->shards[i];
+
+        *shard = (HostShard){.table_mask = HOST_MIN_TABLE - 1};
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->table = calloc(HOST_MIN_TABLE, sizeof(uint32_t));
+
+        if (shard->table == NULL) {
+            printf("Failed to allocate the game host\n");
+            exit(1);
+        }
+    }
+
+    atomic_init(&host->next_id, 0);
+    pthread_mutex_init(&host->pool_lock, NULL);
+
+    return host;
+}
+
+void GameHost_free(GameHost *host) {
+    for (int i = 0; i < host->num_shards; i++) {
+        HostShard *shard = &host->shards[i];
+
+        for (int s = 0; s < shard->num_slabs; s++) {
+            for (int g = 0; g < HOST_SLAB_GAMES; g++) {
+                free(shard->slabs[s][g].moves);
+                free(shard->slabs[s][g].keys);
+            }
+
+            free(shard->slabs[s]);
+        }
+
+        free(shard->slabs);
+        free(shard->table);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    for (int i = 0; i < host->pool_count; i++) {
+        Game_free(host->pool[i]);
+    }
+
+    free(host->pool);
+    pthread_mutex_destroy(&host->pool_lock);
+    free(host->shards);
+    free(host);
+}
+
+static Game *borrow_game(GameHost *host) {
+    pthread_mutex_lock(&host->pool_lock);
+    Game *game = host->pool_count > 0 ? host->pool[--host->pool_count] : NULL;
+    pthread_mutex_unlock(&host->pool_lock);
+
+    return game != NULL ? game : Game_new();
+}
+
+static void return_game(GameHost *host, Game *game) {
+    pthread_mutex_lock(&host->pool_lock);
+
+    if (host->pool_count == host->pool_capacity) {
+        host->pool_capacity = host->pool_capacity ? host->pool_capacity * 2 : 16;
+        host->pool = checked_realloc(host->pool, host->pool_capacity * sizeof(Game *));
+    }
+
+    host->pool[host->pool_count++] = game;
+    pthread_mutex_unlock(&host->pool_lock);
+}
+
+// bucket holding id, or the empty one it would go to
+static uint32_t find_bucket(const HostShard *shard, uint64_t id) {
+    uint32_t bucket = home_bucket(shard, id);
+
+    while (shard->table[bucket] != 0 && slot(shard, shard->table[bucket] - 1)->id != id) {
+        bucket = (bucket + 1) & shard->table_mask;
+    }
+
+    return bucket;
+}
+
+static HostedGame *find_game(const HostShard *shard, uint64_t id) {
+    uint32_t entry = shard->table[find_bucket(shard, id)];
+    return entry != 0 ? slot(shard, entry - 1) : NULL;
+}
+
+static void grow_table(HostShard *shard) {
+    uint32_t *old = shard->table;
+    uint32_t old_size = shard->table_mask + 1;
+
+    shard->table_mask = old_size * 2 - 1;
+    shard->table = calloc(old_size * 2, sizeof(uint32_t));
+
+    if (shard->table == NULL) {
+        printf("Failed to allocate hosted games\n");
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old[i] != 0) {
+            shard->table[find_bucket(shard, slot(shard, old[i] - 1)->id)] = old[i];
+        }
+    }
+
+    free(old);
+}
+
+static uint32_t alloc_slot(HostShard *shard) {
+    if (shard->free_list == 0) {
+        shard->slabs = checked_realloc(shard->slabs, (shard->num_slabs + 1) * sizeof(HostedGame *));
+        shard->slabs[shard->num_slabs] = calloc(HOST_SLAB_GAMES, sizeof(HostedGame));
+
+        if (shard->slabs[shard->num_slabs] == NULL) {
+            printf("Failed to allocate hosted games\n");
+            exit(1);
+        }
+
+        uint32_t first = (uint32_t)shard->num_slabs * HOST_SLAB_GAMES;
+        shard->num_slabs++;
+
+        for (uint32_t i = HOST_SLAB_GAMES; i-- > 0;) {
+            slot(shard, first + i)->next_free = shard->free_list;
+            shard->free_list = first + i + 1;
+        }
+    }
+
+    uint32_t index = shard->free_list - 1;
+    shard->free_list = slot(shard, index)->next_free;
+
+    return index;
+}
+
+// Linear probing without tombstones: the entries after the removed one that could have been
+// placed in its bucket are moved back
+static void remove_game(HostShard *shard, uint64_t id) {
+    uint32_t bucket = find_bucket(shard, id);
+    uint32_t index = shard->table[bucket] - 1;
+
+    shard->table[bucket] = 0;
+
+    for (uint32_t next = (bucket + 1) & shard->table_mask; shard->table[next] != 0; next = (next + 1) & shard->table_mask) {
+        uint32_t home = home_bucket(shard, slot(shard, shard->table[next] - 1)->id);
+
+        // stays when its home is cyclically in (bucket, next]
+        bool stays = bucket <= next ? (home > bucket && home <= next) : (home > bucket || home <= next);
+
+        if (!stays) {
+            shard->table[bucket] = shard->table[next];
+            shard->table[next] = 0;
+            bucket = next;
+        }
+    }
+
+    HostedGame *game = slot(shard, index);
+    free(game->moves);
+    free(game->keys);
+
+    *game = (HostedGame){.next_free = shard->free_list};
+    shard->free_list = index + 1;
+    shard->count--;
+}
+
+static void push_key(HostedGame *game, uint64_t key) {
+    if (game->num_keys == game->keys_capacity) {
+        int capacity = game->keys_capacity ? game->keys_capacity * 2 : HOST_MIN_KEYS;
+        // the fifty move rule ends the game after 101 keys at the most
+        game->keys_capacity = capacity > 128 ? 128 : capacity;
+        game->keys = checked_realloc(game->keys, game->keys_capacity * sizeof(uint64_t));
+    }
+
+    game->keys[game->num_keys++] = key;
+}
+
+static void push_move(HostedGame *game, Move move) {
+    if (game->ply == game->moves_capacity) {
+        game->moves_capacity = game->moves_capacity ? game->moves_capacity * 2 : HOST_MIN_MOVES;
+        game->moves = checked_realloc(game->moves, game->moves_capacity * sizeof(uint16_t));
+    }
+
+    game->moves[game->ply++] = encode_move(move);
+}
+
+// The slot's position and keys into a pooled Game, with a ply count relative to the keys. False
+// when the packed position is damaged or one the move generator can't handle
+static bool load_game(Game *game, const HostedGame *hosted, Position *position) {
+    if (!PackedPosition_unpack(position, &hosted->position) || !Chess_from_position(&game->chess, position)) {
+        return false;
+    }
+
+    memcpy(game->history, hosted->keys, hosted->num_keys * sizeof(uint64_t));
+    game->ply = hosted->num_keys - 1;
+    game->halfmove_clock = position->halfmove_clock;
+
+    return true;
+}
+
+// The legal moves without promotions, the position after one couldn't be packed
+static int playable_moves(Game *game, Move *moves) {
+    int n = Game_legal_moves(game, moves);
+    int count = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (!Game_is_promotion(game, moves[i])) {
+            moves[count++] = moves[i];
+        }
+    }
+
+    return count;
+}
+
+// A pawn of the side to move one step from a back rank, without one some legal move isn't a
+// promotion
+static bool can_promote(const Chess *chess) {
+    bool up = chess->white_at_bottom == (chess->current_turn == ColorWhite);
+    int row = up ? 1 : CHESS_BOARD_ROWS - 2;
+
+    for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+        if (Chess_is_piece(&chess->board[row][col].piece, Pawn, chess->current_turn)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void set_result(HostedGame *hosted, Game *game) {
+    Move moves[ENGINE_MAX_MOVES];
+    enum GameEndReason reason;
+    enum GameResult result = Game_result(game, &reason);
+
+    if (result == GameOngoing && hosted->ply >= GAME_MAX_PLIES) {
+        result = GameDraw;
+        reason = GameEndMaxPlies;
+    }
+
+    // a game that can only go on with a promotion would be stuck, it's adjudicated a draw
+    if (result == GameOngoing && can_promote(&game->chess) && playable_moves(game, moves) == 0) {
+        result = GameDraw;
+        reason = GameEndPromotion;
+    }
+
+    hosted->result = result;
+    hosted->reason = reason;
+}
+
+static void fill_info(const HostedGame *hosted, const Position *position, HostedGameInfo *info) {
+    if (info != NULL) {
+        *info = (HostedGameInfo){.position = *position, .ply = hosted->ply, .result = hosted->result, .reason = hosted->reason};
+    }
+}
+
+// fen NULL for the starting position
+enum HostStatus GameHost_create(GameHost *host, const char *fen, uint64_t *id) {
+    Game *game = borrow_game(host);
+    Position position;
+    PackedPosition packed;
+
+    if (fen == NULL) {
+        Game_reset(game);
+    } else if (!Game_load_fen(game, fen)) {
+        return_game(host, game);
+        return HostBadPosition;
+    }
+
+    Game_to_position(game, &position);
+
+    if (!PackedPosition_pack(&packed, &position)) {
+        return_game(host, game);
+        return HostBadPosition;
+    }
+
+    *id = atomic_fetch_add(&host->next_id, 1) + 1;
+    HostShard *shard = shard_of(host, *id);
+
+    pthread_mutex_lock(&shard->lock);
+
+    if ((shard->count + 1) * 2 > shard->table_mask + 1) {
+        grow_table(shard);
+    }
+
+    uint32_t index = alloc_slot(shard);
+    HostedGame *hosted = slot(shard, index);
+
+    *hosted = (HostedGame){.id = *id, .last_active_ns = Engine_now_ns(), .position = packed};
+    push_key(hosted, PositionIndex_key(&game->chess));
+    set_result(hosted, game);
+
+    shard->table[find_bucket(shard, *id)] = index + 1;
+    shard->count++;
+
+    pthread_mutex_unlock(&shard->lock);
+    return_game(host, game);
+
+    return HostOk;
+}
+
+// info (may be NULL) gets the game after the move
+enum HostStatus GameHost_play(GameHost *host, uint64_t id, Move move, HostedGameInfo *info) {
+    HostShard *shard = shard_of(host, id);
+    enum HostStatus status = HostOk;
+
+    pthread_mutex_lock(&shard->lock);
+
+    HostedGame *hosted = find_game(shard, id);
+
+    if (hosted == NULL || hosted->result != GameOngoing) {
+        pthread_mutex_unlock(&shard->lock);
+        return hosted == NULL ? HostNoGame : HostGameOver;
+    }
+
+    Game *game = borrow_game(host);
+    Position position;
+
+    if (!load_game(game, hosted, &position)) {
+        pthread_mutex_unlock(&shard->lock);
+        return_game(host, game);
+        return HostBadPosition;
+    }
+
+    Position next;
+    PackedPosition packed;
+
+    // promotions are illegal here, the core would leave a pawn on the last rank that can't be packed
+    if (Game_is_promotion(game, move) || !Game_play_move(game, move)) {
+        status = HostIllegalMove;
+    } else {
+        Game_to_position(game, &next);
+        next.fullmove_number = position.fullmove_number + (position.side_to_move == ColorBlack);
+
+        // the slot is only changed once the new position is known to pack
+        if (!PackedPosition_pack(&packed, &next)) {
+            status = HostBadPosition;
+        } else {
+            push_move(hosted, move);
+
+            if (game->halfmove_clock == 0) {
+                hosted->num_keys = 0;
+            }
+
+            push_key(hosted, PositionIndex_key(&game->chess));
+
+            hosted->position = packed;
+            position = next;
+
+            set_result(hosted, game);
+            hosted->last_active_ns = Engine_now_ns();
+        }
+    }
+
+    fill_info(hosted, &position, info);
+
+    pthread_mutex_unlock(&shard->lock);
+    return_game(host, game);
+
+    return status;
+}
+
+enum HostStatus GameHost_query(GameHost *host, uint64_t id, HostedGameInfo *info) {
+    HostShard *shard = shard_of(host, id);
+
+    pthread_mutex_lock(&shard->lock);
+
+    HostedGame *hosted = find_game(shard, id);
+    enum HostStatus status = hosted != NULL ? HostOk : HostNoGame;
+
+    if (hosted != NULL) {
+        Position position;
+
+        if (PackedPosition_unpack(&position, &hosted->position)) {
+            fill_info(hosted, &position, info);
+        } else {
+            status = HostBadPosition;
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return status;
+}
+
+// moves has room for ENGINE_MAX_MOVES, none once the game is over. Promotions aren't listed, the
+// host can't play them
+enum HostStatus GameHost_legal_moves(GameHost *host, uint64_t id, Move *moves, int *count) {
+    HostShard *shard = shard_of(host, id);
+
+    pthread_mutex_lock(&shard->lock);
+
+    HostedGame *hosted = find_game(shard, id);
+    enum HostStatus status = hosted != NULL ? HostOk : HostNoGame;
+    *count = 0;
+
+    if (hosted != NULL && hosted->result == GameOngoing) {
+        Game *game = borrow_game(host);
+        Position position;
+
+        if (load_game(game, hosted, &position)) {
+            *count = playable_moves(game, moves);
+        } else {
+            status = HostBadPosition;
+        }
+
+        return_game(host, game);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return status;
+}
+
+// The first max_moves moves of the game, count is the number of moves played
+enum HostStatus GameHost_moves(GameHost *host, uint64_t id, Move *moves, int max_moves, int *count) {
+    HostShard *shard = shard_of(host, id);
+
+    pthread_mutex_lock(&shard->lock);
+
+    HostedGame *hosted = find_game(shard, id);
+    *count = 0;
+
+    if (hosted != NULL) {
+        *count = (int)hosted->ply;
+
+        for (int i = 0; i < *count && i < max_moves; i++) {
+            moves[i] = decode_move(hosted->moves[i]);
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return hosted != NULL ? HostOk : HostNoGame;
+}
+
+bool GameHost_remove(GameHost *host, uint64_t id) {
+    HostShard *shard = shard_of(host, id);
+
+    pthread_mutex_lock(&shard->lock);
+
+    bool found = find_game(shard, id) != NULL;
+
+    if (found) {
+        remove_game(shard, id);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return found;
+}
+
+// Removes the games created or last moved in more than idle_ns ago, returns how many
+int GameHost_expire(GameHost *host, uint64_t idle_ns) {
+    uint64_t now = Engine_now_ns();
+    int expired = 0;
+
+    for (int i = 0; i < host->num_shards; i++) {
+        HostShard *shard = &host->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        for (uint32_t index = 0; index < (uint32_t)shard->num_slabs * HOST_SLAB_GAMES; index++) {
+            HostedGame *game = slot(shard, index);
+
+            if (game->id != 0 && now - game->last_active_ns > idle_ns) {
+                remove_game(shard, game->id);
+                expired++;
+            }
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return expired;
+}
+
+void GameHost_stats(GameHost *host, HostStats *stats) {
+    *stats = (HostStats){0};
+
+    for (int i = 0; i < host->num_shards; i++) {
+        HostShard *shard = &host->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        stats->games += shard->count;
+        stats->bytes += (size_t)shard->num_slabs * HOST_SLAB_GAMES * sizeof(HostedGame) + (shard->table_mask + 1) * sizeof(uint32_t);
+
+        for (uint32_t index = 0; index < (uint32_t)shard->num_slabs * HOST_SLAB_GAMES; index++) {
+            const HostedGame *game = slot(shard, index);
+            stats->bytes += game->moves_capacity * sizeof(uint16_t) + game->keys_capacity * sizeof(uint64_t);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    pthread_mutex_lock(&host->pool_lock);
+    stats->pooled_games = host->pool_count;
+    pthread_mutex_unlock(&host->pool_lock);
+}
+
+const char *Host_status_string(enum HostStatus status) {
+    switch (status) {
+    case HostOk:
+        return "ok";
+    case HostNoGame:
+        return "no_game";
+    case HostBadPosition:
+        return "bad_position";
+    case HostIllegalMove:
+        return "illegal_move";
+    case HostGameOver:
+        return "game_over";
+    default:
+        return "unknown";
+    }
+}
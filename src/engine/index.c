@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "engine.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Same position, castling rights included, whichever way the board is turned
+uint64_t PositionIndex_key(const Chess *chess) { return chess->hash ^ Chess_zobrist_castling_key(Chess_castling_rights(chess)); }
+
+uint16_t PositionIndex_encode_move(const Chess *chess, Move move) {
+    return (uint16_t)(relative_square(chess, ColorWhite, move.from) | relative_square(chess, ColorWhite, move.to) << 6);
+}
+
+// "e2e4", "-" for INDEX_NO_MOVE
+void PositionIndex_move_name(uint16_t move, char out[6]) {
+    if (move == INDEX_NO_MOVE) {
+        snprintf(out, 6, "-");
+        return;
+    }
+
+    int from = move & 63;
+    int to = move >> 6;
+
+    snprintf(out, 6, "%c%c%c%c", 'a' + from % 8, '8' - from / 8, 'a' + to % 8, '8' - to / 8);
+}
+
+// count items of item_size at offset are inside of the file, without overflowing on made up values
+static inline bool fits(size_t size, uint64_t offset, uint64_t count, size_t item_size) {
+    return offset <= size && count <= (size - offset) / item_size;
+}
+
+// PositionIndex_find reads the directory without checks: it has to start at 0, never go down and
+// end at the number of entries
+static bool is_valid_directory(const uint64_t *directory, uint64_t num_entries) {
+    if (directory[0] != 0 || directory[1ull << INDEX_DIRECTORY_BITS] != num_entries) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < 1ull << INDEX_DIRECTORY_BITS; i++) {
+        if (directory[i] > directory[i + 1]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Maps the index read only, nothing is copied or decoded. False with a message on a missing,
+// truncated, foreign or damaged file
+bool PositionIndex_open(PositionIndex *index, const char *path) {
+    *index = (PositionIndex){0};
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexHeader)) {
+        printf("%s is not a position index\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        printf("Failed to map %s\n", path);
+        return false;
+    }
+
+    const IndexHeader *header = map;
+    size_t size = st.st_size;
+
+    bool valid = memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 && header->version == INDEX_VERSION &&
+                 fits(size, header->entries_offset, header->num_entries, sizeof(IndexEntry)) &&
+                 fits(size, header->directory_offset, (1ull << INDEX_DIRECTORY_BITS) + 1, sizeof(uint64_t)) &&
+                 fits(size, header->games_offset, header->num_games, sizeof(IndexGame)) &&
+                 fits(size, header->files_offset, header->num_files, INDEX_FILE_NAME) &&
+                 header->directory_offset % sizeof(uint64_t) == 0 &&
+                 is_valid_directory((const uint64_t *)((const char *)map + header->directory_offset), header->num_entries);
+
+    if (!valid) {
+        printf("%s is not a position index (or is damaged or was written by another version)\n", path);
+        munmap(map, size);
+        return false;
+    }
+
+    // lookups touch a few scattered pages
+    posix_madvise(map, size, POSIX_MADV_RANDOM);
+
+    index->map = map;
+    index->size = size;
+    index->header = header;
+    index->entries = (const IndexEntry *)((const char *)map + header->entries_offset);
+    index->directory = (const uint64_t *)((const char *)map + header->directory_offset);
+    index->games = (const IndexGame *)((const char *)map + header->games_offset);
+    index->files = (const char (*)[INDEX_FILE_NAME])((const char *)map + header->files_offset);
+
+    return true;
+}
+
+void PositionIndex_close(PositionIndex *index) {
+    if (index->map != NULL) {
+        munmap(index->map, index->size);
+    }
+
+    *index = (PositionIndex){0};
+}
+
+// Entries of every occurrence of the position, ordered by game and ply. Returns their count and
+// points *first at them, inside of the mapping
+size_t PositionIndex_find(const PositionIndex *index, uint64_t key, const IndexEntry **first) {
+    uint64_t bucket = key >> INDEX_DIRECTORY_SHIFT;
+    uint64_t lo = index->directory[bucket];
+    uint64_t hi = index->directory[bucket + 1];
+
+    // lower bound within the bucket
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (index->entries[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    uint64_t end = lo;
+
+    while (end < index->directory[bucket + 1] && index->entries[end].key == key) {
+        end++;
+    }
+
+    *first = &index->entries[lo];
+
+    return end - lo;
+}
@@ -0,0 +1,442 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Depth-first proof-number search (df-pn) for "mate in N".
+//
+// The attacker is the side to move at the root. A node is (position, plies left), plies left is
+// odd when the attacker is to move (OR node) and even for the defender (AND node). The bound makes
+// the search graph acyclic, so repetitions need no special care.
+//
+// Proof and disproof numbers are kept from the point of view of the side to move: phi is the
+// proof number at OR nodes and the disproof number at AND nodes, delta the other one. Then
+// phi(n) = min delta(child) and delta(n) = sum phi(child) at every node.
+
+#define PN_INF 100000000u
+
+// entries per bucket, the one with the least work is replaced
+#define MATE_BUCKET 4
+
+static const uint64_t RemainingKey = 0x9e3779b97f4a7c15ull;
+
+// castling rights included, they can decide whether a mate exists
+static inline uint64_t node_key(const Chess *game, int remaining) { return PositionIndex_key(game) ^ RemainingKey * (uint64_t)(remaining + 1); }
+
+static inline uint32_t add_numbers(uint32_t a, uint32_t b) { return a + b >= PN_INF ? PN_INF : a + b; }
+
+MateSolver *MateSolver_new(size_t table_mb) {
+    MateSolver *solver = calloc(1, sizeof(MateSolver));
+
+    size_t buckets = 1;
+
+    while (buckets * 2 * MATE_BUCKET * sizeof(MateEntry) <= table_mb * 1024 * 1024) {
+        buckets *= 2;
+    }
+
+    if (solver != NULL) {
+        solver->table = calloc(buckets * MATE_BUCKET, sizeof(MateEntry));
+    }
+
+    if (solver == NULL || solver->table == NULL) {
+        printf("Failed to allocate a %zu MB mate solver\n", table_mb);
+        exit(1);
+    }
+
+    solver->mask = buckets - 1;
+
+    for (int i = 0; i <= MATE_MAX_PLY; i++) {
+        Engine_init_chess(&solver->stack[i]);
+    }
+
+    return solver;
+}
+
+void MateSolver_free(MateSolver *solver) {
+    for (int i = 0; i <= MATE_MAX_PLY; i++) {
+        Engine_free_chess(&solver->stack[i]);
+    }
+
+    free(solver->table);
+    free(solver);
+}
+
+static void lookup(const MateSolver *solver, uint64_t key, uint32_t *phi, uint32_t *delta) {
+    const MateEntry *bucket = &solver->table[(key & solver->mask) * MATE_BUCKET];
+
+    for (int i = 0; i < MATE_BUCKET; i++) {
+        if (bucket[i].key == key) {
+            *phi = bucket[i].phi;
+            *delta = bucket[i].delta;
+            return;
+        }
+    }
+
+    *phi = 1;
+    *delta = 1;
+}
+
+static void store(MateSolver *solver, uint64_t key, uint32_t phi, uint32_t delta, uint64_t work) {
+    MateEntry *bucket = &solver->table[(key & solver->mask) * MATE_BUCKET];
+    MateEntry *replace = &bucket[0];
+
+    for (int i = 0; i < MATE_BUCKET; i++) {
+        if (bucket[i].key == key) {
+            replace = &bucket[i];
+            work += bucket[i].work;
+            break;
+        }
+
+        if (bucket[i].work < replace->work) {
+            replace = &bucket[i];
+        }
+    }
+
+    *replace = (MateEntry){.key = key, .phi = phi, .delta = delta, .work = work > UINT32_MAX ? UINT32_MAX : (uint32_t)work};
+}
+
+// Legal moves of the node at ply and the keys of their children
+static int generate_children(MateSolver *solver, int ply, int remaining, Move *moves, uint64_t *keys) {
+    Chess *game = &solver->stack[ply];
+    Chess *child = &solver->stack[ply + 1];
+
+    Move pseudo[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(game, pseudo);
+    int count = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (Engine_make_move(child, game, pseudo[i])) {
+            moves[count] = pseudo[i];
+            keys[count] = node_key(child, remaining - 1);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static bool is_mated(MateSolver *solver, int ply) {
+    Chess *game = &solver->stack[ply];
+
+    if (!Engine_in_check(game, game->current_turn)) {
+        return false;
+    }
+
+    Move pseudo[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(game, pseudo);
+
+    for (int i = 0; i < n; i++) {
+        if (Engine_make_move(&solver->stack[ply + 1], game, pseudo[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static inline bool slider_sees(enum PieceType type, int from, int to, uint64_t occupied) {
+    if (LineMask[from][to] == 0 || (BetweenMask[from][to] & occupied) != 0) {
+        return false;
+    }
+
+    bool straight = SQUARE_ROW(from) == SQUARE_ROW(to) || SQUARE_COL(from) == SQUARE_COL(to);
+
+    return type == Queen || (type == Rook && straight) || (type == Bishop && !straight);
+}
+
+// Whether the move checks the opponent, from the tables alone so quiet moves never have to be
+// made. Castling is always reported as a check, the caller makes the move to find out
+static bool gives_check(const Chess *game, Move move) {
+    const Piece *mover = &game->board[move.from.row][move.from.col].piece;
+    enum Color us = mover->color;
+
+    if (mover->type == King && abs(move.to.col - move.from.col) == 2) {
+        return true;
+    }
+
+    int from = SQUARE(move.from.row, move.from.col);
+    int to = SQUARE(move.to.row, move.to.col);
+    int king = -1;
+    uint64_t occupied = 0;
+
+    for (int square = 0; square < 64; square++) {
+        const Piece *piece = &game->board[SQUARE_ROW(square)][SQUARE_COL(square)].piece;
+
+        if (piece->type != UndefPieceType) {
+            occupied |= 1ull << square;
+        }
+
+        if (piece->type == King && piece->color != us) {
+            king = square;
+        }
+    }
+
+    if (king < 0) {
+        return false;
+    }
+
+    occupied = (occupied & ~(1ull << from)) | 1ull << to;
+
+    switch (mover->type) {
+    case Knight:
+        if (KnightMask[to] & 1ull << king) {
+            return true;
+        }
+        break;
+    case Pawn: {
+        bool moves_up = (us == ColorWhite) == game->white_at_bottom;
+        const SquareList *targets = &PawnCaptureTargets[!moves_up][to];
+
+        for (int i = 0; i < targets->count; i++) {
+            if (targets->squares[i] == king) {
+                return true;
+            }
+        }
+        break;
+    }
+    case King:
+        break;
+    default:
+        if (slider_sees(mover->type, to, king, occupied)) {
+            return true;
+        }
+        break;
+    }
+
+    // discovered checks, only a slider on a line with the king and the from square can give one
+    for (int square = 0; square < 64; square++) {
+        const Piece *piece = &game->board[SQUARE_ROW(square)][SQUARE_COL(square)].piece;
+
+        if (square != from && piece->color == us && (piece->type == Queen || piece->type == Rook || piece->type == Bishop) &&
+            (LineMask[square][king] & 1ull << from) && slider_sees(piece->type, square, king, occupied)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The last two plies don't go through the table, only checks can mate and the first one that
+// does ends the search
+static bool mate_in_one(MateSolver *solver, int ply) {
+    Chess *game = &solver->stack[ply];
+
+    Move pseudo[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(game, pseudo);
+
+    for (int i = 0; i < n; i++) {
+        if (!gives_check(game, pseudo[i])) {
+            continue;
+        }
+
+        if (Engine_make_move(&solver->stack[ply + 1], game, pseudo[i]) && is_mated(solver, ply + 1)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void mid(MateSolver *solver, int ply, int remaining, uint32_t th_phi, uint32_t th_delta) {
+    Chess *game = &solver->stack[ply];
+    uint64_t key = node_key(game, remaining);
+    uint64_t start_nodes = solver->nodes;
+
+    solver->nodes++;
+
+    if (solver->max_nodes != 0 && solver->nodes >= solver->max_nodes) {
+        solver->aborted = true;
+        return;
+    }
+
+    if (remaining == 0) {
+        bool mated = is_mated(solver, ply);
+
+        store(solver, key, mated ? PN_INF : 0, mated ? 0 : PN_INF, 1);
+        return;
+    }
+
+    if (remaining == 1) {
+        bool mate = mate_in_one(solver, ply);
+
+        store(solver, key, mate ? 0 : PN_INF, mate ? PN_INF : 0, 1);
+        return;
+    }
+
+    Move moves[ENGINE_MAX_MOVES];
+    uint64_t keys[ENGINE_MAX_MOVES];
+    int n = generate_children(solver, ply, remaining, moves, keys);
+
+    if (n == 0) {
+        // mated: lost for the side to move. Stalemated: a failed attack for the attacker, a
+        // successful defence for the defender
+        bool lost = remaining % 2 == 1 || Engine_in_check(game, game->current_turn);
+
+        store(solver, key, lost ? PN_INF : 0, lost ? 0 : PN_INF, 1);
+        return;
+    }
+
+    for (;;) {
+        uint32_t phi = PN_INF;
+        uint32_t delta = 0;
+        uint32_t delta_2 = PN_INF;
+        uint32_t child_phi = 0;
+        int best = 0;
+
+        for (int i = 0; i < n; i++) {
+            uint32_t c_phi, c_delta;
+            lookup(solver, keys[i], &c_phi, &c_delta);
+
+            delta = add_numbers(delta, c_phi);
+
+            if (c_delta < phi) {
+                delta_2 = phi;
+                phi = c_delta;
+                child_phi = c_phi;
+                best = i;
+            } else if (c_delta < delta_2) {
+                delta_2 = c_delta;
+            }
+        }
+
+        if (phi >= th_phi || delta >= th_delta || solver->aborted) {
+            store(solver, key, phi, delta, solver->nodes - start_nodes);
+            return;
+        }
+
+        // the child's phi may grow until this node's delta reaches its threshold, its delta
+        // until it stops being the most promising one
+        uint64_t child_th_phi = (uint64_t)th_delta + child_phi - delta;
+        uint32_t child_th_delta = th_phi < delta_2 + 1 ? th_phi : delta_2 + 1;
+
+        Engine_make_move(&solver->stack[ply + 1], game, moves[best]);
+        mid(solver, ply + 1, remaining - 1, child_th_phi >= PN_INF ? PN_INF : (uint32_t)child_th_phi, child_th_delta);
+    }
+}
+
+// Solves the node at ply with remaining plies left, true if the side to move there gets what it
+// wants (the attacker mates / the defender holds out)
+static bool solve(MateSolver *solver, int ply, int remaining) {
+    uint32_t phi, delta;
+
+    mid(solver, ply, remaining, PN_INF, PN_INF);
+    lookup(solver, node_key(&solver->stack[ply], remaining), &phi, &delta);
+
+    return phi == 0;
+}
+
+// Shortest mate for the attacker to move at ply in at most max_moves moves, 0 if there is none
+static int shortest_mate(MateSolver *solver, int ply, int max_moves) {
+    for (int moves = 1; moves <= max_moves && !solver->aborted; moves++) {
+        if (solve(solver, ply, moves * 2 - 1)) {
+            return moves;
+        }
+    }
+
+    return 0;
+}
+
+// Mating line from ply, mate in `moves`: the attacker plays a shortest mate, the defender the
+// reply that holds out longest
+static void build_line(MateSolver *solver, int ply, int moves, MateResult *result) {
+    for (; moves > 0 && !solver->aborted; moves--) {
+        Chess *game = &solver->stack[ply];
+
+        Move pseudo[ENGINE_MAX_MOVES];
+        int n = Engine_generate_moves(game, pseudo);
+        bool found = false;
+
+        for (int i = 0; i < n && !found; i++) {
+            if (!Engine_make_move(&solver->stack[ply + 1], game, pseudo[i])) {
+                continue;
+            }
+
+            // the defender can't hold out for `moves` - 1 more moves
+            if (!solve(solver, ply + 1, moves * 2 - 2)) {
+                result->pv[result->pv_length++] = pseudo[i];
+                found = true;
+            }
+        }
+
+        if (!found) {
+            return;
+        }
+
+        Engine_make_move(&solver->stack[ply + 1], game, result->pv[result->pv_length - 1]);
+        ply++;
+        game = &solver->stack[ply];
+
+        if (moves == 1) {
+            return;
+        }
+
+        n = Engine_generate_moves(game, pseudo);
+
+        Move reply = {0};
+        int longest = 0;
+
+        for (int i = 0; i < n; i++) {
+            if (!Engine_make_move(&solver->stack[ply + 1], game, pseudo[i])) {
+                continue;
+            }
+
+            int mate = shortest_mate(solver, ply + 1, moves - 1);
+
+            if (mate > longest) {
+                longest = mate;
+                reply = pseudo[i];
+            }
+        }
+
+        if (longest == 0) {
+            return;
+        }
+
+        result->pv[result->pv_length++] = reply;
+        Engine_make_move(&solver->stack[ply + 1], game, reply);
+        ply++;
+        moves = longest + 1;
+    }
+}
+
+// Looks for the shortest forced mate for the side to move in at most max_moves moves, giving up
+// with MateUnknown after max_nodes nodes (0 = no limit). MateNone is a proof that there is none.
+// The table is kept between calls, it's keyed by position so puzzles share what they can
+MateResult MateSolver_solve(MateSolver *solver, const Chess *root, int max_moves, uint64_t max_nodes) {
+    MateResult result = {.status = MateUnknown};
+
+    if (max_moves > MATE_MAX_MOVES) {
+        max_moves = MATE_MAX_MOVES;
+    }
+
+    Chess_copy(&solver->stack[0], root);
+    solver->nodes = 0;
+    solver->max_nodes = max_nodes;
+    solver->aborted = false;
+
+    int moves = shortest_mate(solver, 0, max_moves);
+
+    if (!solver->aborted) {
+        result.status = moves > 0 ? MateFound : MateNone;
+        result.moves = moves;
+    }
+
+    if (result.status == MateFound) {
+        build_line(solver, 0, moves, &result);
+    }
+
+    result.nodes = solver->nodes;
+
+    return result;
+}
+
+const char *Mate_status_string(enum MateStatus status) {
+    switch (status) {
+    case MateFound:
+        return "mate";
+    case MateNone:
+        return "none";
+    default:
+        return "unknown";
+    }
+}
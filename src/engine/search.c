@@ -0,0 +1,697 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// how often (in nodes) the deadline and the cancel flag are looked at
+#define ENGINE_CHECK_INTERVAL 1024
+
+// half width of the root window around the previous iteration's scores
+#define ENGINE_ASPIRATION_WINDOW 50
+
+// used for move ordering only, indexed by enum PieceType
+static const int OrderingValue[7] = {0, 20000, 900, 500, 330, 320, 100};
+
+#ifdef ENGINE_STATS
+#define ENGINE_STATS_TIMER_START(name) uint64_t name = Engine_now_ns()
+#define ENGINE_STATS_TIMER_STOP(engine, name, field) ((engine)->depth_stats->field += Engine_now_ns() - (name))
+#else
+#define ENGINE_STATS_TIMER_START(name) ((void)0)
+#define ENGINE_STATS_TIMER_STOP(engine, name, field) ((void)(engine))
+#endif
+
+uint64_t Engine_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void Engine_init_chess(Chess *game) {
+    *game = (Chess){0};
+    game->white_at_bottom = true;
+    game->current_turn = ColorWhite;
+    game->arena = arena_init(CHESS_ARENA_SIZE);
+}
+
+void Engine_free_chess(Chess *game) {
+    free(game->arena.ptr);
+    game->arena.ptr = NULL;
+}
+
+// Moves from the piece move lists of the side to move. Pins are not taken into account,
+// see Engine_make_move
+int Engine_generate_moves(const Chess *game, Move *moves) {
+    int n = 0;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &game->board[row][col].piece;
+
+            if (piece->type == UndefPieceType || piece->color != game->current_turn) {
+                continue;
+            }
+
+            for (int i = 0; i < piece->num_moves; i++) {
+                const Piece *target = &game->board[piece->moves[i].row][piece->moves[i].col].piece;
+
+                // kings are never captured, the move before that was already illegal
+                if (target->type == King) {
+                    continue;
+                }
+
+                moves[n++] = (Move){.from = piece->pos, .to = piece->moves[i]};
+            }
+        }
+    }
+
+    return n;
+}
+
+bool Engine_in_check(const Chess *game, enum Color color) {
+    Piece *king = Chess_find_piece((Chess *)game, King, color);
+
+    return king != NULL && Chess_is_square_attacked(game, king->pos, 1 - color);
+}
+
+// Copy-make. Returns false, leaving dst in an unspecified state, if the move is not
+// in the piece's move list or leaves the mover's king in check
+bool Engine_make_move(Chess *dst, const Chess *src, Move move) {
+    enum Color us = src->current_turn;
+    const Piece *piece = &src->board[move.from.row][move.from.col].piece;
+
+    if (piece->type == King && abs(move.to.col - move.from.col) == 2) {
+        // can't castle out of or through a check
+        Pos through = {.row = move.from.row, .col = (move.from.col + move.to.col) / 2};
+
+        if (Chess_is_square_attacked(src, move.from, 1 - us) || Chess_is_square_attacked(src, through, 1 - us)) {
+            return false;
+        }
+    }
+
+    Chess_copy(dst, src);
+
+    if (!Chess_make_move(dst, &dst->board[move.from.row][move.from.col].piece, move.to)) {
+        return false;
+    }
+
+    return !Engine_in_check(dst, us);
+}
+
+Engine *Engine_new(EngineConfig config) {
+    Engine *engine = calloc(1, sizeof(Engine));
+
+    if (engine == NULL) {
+        printf("Failed to allocate engine\n");
+        exit(1);
+    }
+
+    engine->config = config;
+
+    for (int i = 0; i <= ENGINE_MAX_PLY; i++) {
+        Engine_init_chess(&engine->stack[i]);
+    }
+
+    if (config.hash_mb > 0) {
+        engine->own_hash = HashTable_new(config.hash_mb);
+        engine->hash = engine->own_hash;
+    }
+
+    if (config.cache_path[0] != '\0') {
+        engine->own_cache = AnalysisCache_new(config.cache_path, ANALYSIS_CACHE_DEFAULT_MB);
+        engine->cache = engine->own_cache;
+    }
+
+    // counted somewhere until the first iteration starts
+    engine->depth_stats = &engine->stats.depths[0];
+
+    if (config.stats_path[0] != '\0') {
+        engine->stats_out = fopen(config.stats_path, "a");
+
+        if (engine->stats_out == NULL) {
+            printf("Failed to open %s\n", config.stats_path);
+            exit(1);
+        }
+
+        // a whole line per write, several engines can append to the same file
+        setvbuf(engine->stats_out, NULL, _IOFBF, 1 << 16);
+    }
+
+    return engine;
+}
+
+void Engine_free(Engine *engine) {
+    for (int i = 0; i <= ENGINE_MAX_PLY; i++) {
+        Engine_free_chess(&engine->stack[i]);
+    }
+
+    if (engine->stats_out != NULL) {
+        fclose(engine->stats_out);
+    }
+
+    HashTable_free(engine->own_hash);
+    AnalysisCache_free(engine->own_cache);
+    free(engine);
+}
+
+static inline int engine_evaluate(Engine *engine, Chess *game) {
+    ENGINE_STATS_TIMER_START(start);
+    int score = engine->config.use_nnue ? Chess_nnue_evaluate(game) : Chess_evaluate(game);
+    ENGINE_STATS_TIMER_STOP(engine, start, eval_ns);
+
+    engine->depth_stats->evals++;
+
+    return score;
+}
+
+// Engine_generate_moves and Engine_make_move, timed as move generation
+static inline int generate_moves(Engine *engine, const Chess *game, Move *moves) {
+    ENGINE_STATS_TIMER_START(start);
+    int n = Engine_generate_moves(game, moves);
+    ENGINE_STATS_TIMER_STOP(engine, start, gen_ns);
+
+    return n;
+}
+
+static inline bool make_move(Engine *engine, Chess *dst, const Chess *src, Move move) {
+    ENGINE_STATS_TIMER_START(start);
+    bool legal = Engine_make_move(dst, src, move);
+    ENGINE_STATS_TIMER_STOP(engine, start, gen_ns);
+
+    return legal;
+}
+
+static inline bool move_equals(Move a, Move b) {
+    return a.from.row == b.from.row && a.from.col == b.from.col && a.to.row == b.to.row && a.to.col == b.to.col;
+}
+
+// MVV-LVA for captures, with `first` (the previous iteration's best move) in front of everything
+static void order_moves(const Chess *game, Move *moves, int n, const Move *first) {
+    int scores[ENGINE_MAX_MOVES];
+
+    for (int i = 0; i < n; i++) {
+        const Piece *attacker = &game->board[moves[i].from.row][moves[i].from.col].piece;
+        const Piece *victim = &game->board[moves[i].to.row][moves[i].to.col].piece;
+
+        scores[i] = victim->type == UndefPieceType ? 0 : OrderingValue[victim->type] * 10 - OrderingValue[attacker->type] / 10;
+
+        if (first != NULL && move_equals(moves[i], *first)) {
+            scores[i] = ENGINE_INF * 10;
+        }
+    }
+
+    // move lists are short, insertion sort is fine
+    for (int i = 1; i < n; i++) {
+        Move move = moves[i];
+        int score = scores[i];
+        int j = i - 1;
+
+        for (; j >= 0 && scores[j] < score; j--) {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+        }
+
+        moves[j + 1] = move;
+        scores[j + 1] = score;
+    }
+}
+
+// Castling rights are part of the position, the rights are only compared once the hash matches
+static bool is_repetition(Engine *engine, int ply) {
+    const Chess *game = &engine->stack[ply];
+    uint64_t key = PositionIndex_key(game);
+
+    for (int i = ply - 2; i >= 0; i -= 2) {
+        if (engine->stack[i].hash == game->hash && PositionIndex_key(&engine->stack[i]) == key) {
+            return true;
+        }
+    }
+
+    // history is ordered oldest first and its last entry is the root itself
+    for (int i = engine->history_len - 1 - (ply % 2 == 0 ? 2 : 1); i >= 0; i -= 2) {
+        if (engine->history[i] == key) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline bool should_stop(Engine *engine) {
+    if (engine->config.nodes != 0 && engine->nodes >= engine->config.nodes) {
+        engine->stop = true;
+    }
+
+    if (engine->nodes >= engine->next_check) {
+        engine->next_check = engine->nodes + ENGINE_CHECK_INTERVAL;
+
+        if (engine->cancel != NULL && atomic_load_explicit(engine->cancel, memory_order_relaxed)) {
+            engine->stop = true;
+        }
+
+        if (engine->deadline_ns != 0 && Engine_now_ns() >= engine->deadline_ns) {
+            engine->stop = true;
+        }
+    }
+
+    return engine->stop;
+}
+
+static int quiesce(Engine *engine, int ply, int alpha, int beta) {
+    Chess *game = &engine->stack[ply];
+
+    engine->nodes++;
+    engine->depth_stats->qnodes++;
+
+    int stand_pat = engine_evaluate(engine, game);
+
+    if (ply >= ENGINE_MAX_PLY || stand_pat >= beta) {
+        return stand_pat;
+    }
+
+    if (stand_pat > alpha) {
+        alpha = stand_pat;
+    }
+
+    Move moves[ENGINE_MAX_MOVES];
+    int n = generate_moves(engine, game, moves);
+    int captures = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (game->board[moves[i].to.row][moves[i].to.col].piece.type != UndefPieceType) {
+            moves[captures++] = moves[i];
+        }
+    }
+
+    order_moves(game, moves, captures, NULL);
+
+    for (int i = 0; i < captures; i++) {
+        if (!make_move(engine, &engine->stack[ply + 1], game, moves[i])) {
+            continue;
+        }
+
+        int score = -quiesce(engine, ply + 1, -beta, -alpha);
+
+        if (score >= beta) {
+            return score;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+        }
+    }
+
+    return alpha;
+}
+
+// mate scores are stored relative to the node instead of the root, so they hold at any ply
+static inline int score_to_hash(int score, int ply) {
+    return score > ENGINE_MATE_BOUND ? score + ply : score < -ENGINE_MATE_BOUND ? score - ply : score;
+}
+
+static inline int score_from_hash(int score, int ply) {
+    return score > ENGINE_MATE_BOUND ? score - ply : score < -ENGINE_MATE_BOUND ? score + ply : score;
+}
+
+static int search(Engine *engine, int ply, int depth, int alpha, int beta) {
+    Chess *game = &engine->stack[ply];
+
+    engine->pv_length[ply] = 0;
+
+    if (ply > 0 && is_repetition(engine, ply)) {
+        return 0;
+    }
+
+    if (depth <= 0 || ply >= ENGINE_MAX_PLY - 1) {
+        return quiesce(engine, ply, alpha, beta);
+    }
+
+    SearchDepthStats *stats = engine->depth_stats;
+
+    engine->nodes++;
+    stats->nodes++;
+
+    // positions that only differ in castling rights need their own entries
+    uint64_t key = PositionIndex_key(game);
+    HashHit hit;
+    bool has_hit = false;
+
+    if (engine->hash != NULL) {
+        has_hit = HashTable_probe(engine->hash, key, &hit);
+
+        stats->hash_probes++;
+        stats->hash_hits += has_hit;
+        stats->hash_collisions +=
+            !has_hit && atomic_load_explicit(&engine->hash->entries[key & engine->hash->mask].data, memory_order_relaxed) != 0;
+    }
+
+    // the analysis cache where the hash table has nothing deep enough, it keeps results of earlier
+    // runs and other processes
+    if (engine->cache != NULL && depth >= ANALYSIS_CACHE_MIN_DEPTH && (!has_hit || hit.depth < depth)) {
+        HashHit cached;
+
+        if (AnalysisCache_probe(engine->cache, game, &cached) && (!has_hit || cached.depth > hit.depth)) {
+            hit = cached;
+            has_hit = true;
+            stats->cache_hits++;
+        }
+    }
+
+    // only results that fall outside of the window cut off, an exact one inside of it would leave
+    // the principal variation short
+    if (has_hit && hit.depth >= depth) {
+        int score = score_from_hash(hit.score, ply);
+
+        if ((hit.bound != HashBoundUpper && score >= beta) || (hit.bound != HashBoundLower && score <= alpha)) {
+            stats->hash_cutoffs++;
+            return score;
+        }
+    }
+
+    Move moves[ENGINE_MAX_MOVES];
+    int n = generate_moves(engine, game, moves);
+
+    // the hash move first, the previous iteration's principal variation without one
+    const Move *first = engine->prev_pv_length > ply ? &engine->prev_pv[ply] : NULL;
+
+    if (has_hit && hit.has_move) {
+        first = &hit.move;
+    }
+
+    order_moves(game, moves, n, first);
+
+    int legal = 0;
+    int best = -ENGINE_INF;
+    int best_index = -1;
+    int alpha_start = alpha;
+
+    for (int i = 0; i < n; i++) {
+        if (!make_move(engine, &engine->stack[ply + 1], game, moves[i])) {
+            continue;
+        }
+
+        legal++;
+
+        int score = -search(engine, ply + 1, depth - 1, -beta, -alpha);
+
+        if (should_stop(engine)) {
+            return 0;
+        }
+
+        if (score > best) {
+            best = score;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+            best_index = i;
+
+            engine->pv[ply][0] = moves[i];
+            memcpy(&engine->pv[ply][1], engine->pv[ply + 1], sizeof(Move) * engine->pv_length[ply + 1]);
+            engine->pv_length[ply] = engine->pv_length[ply + 1] + 1;
+        }
+
+        if (alpha >= beta) {
+            stats->cutoffs++;
+            stats->first_move_cutoffs += legal == 1;
+            break;
+        }
+    }
+
+    if (legal == 0) {
+        return Engine_in_check(game, game->current_turn) ? -ENGINE_MATE_SCORE + ply : 0;
+    }
+
+    enum HashBound bound = best >= beta ? HashBoundLower : best > alpha_start ? HashBoundExact : HashBoundUpper;
+    const Move *best_move = best_index >= 0 ? &moves[best_index] : NULL;
+
+    if (engine->hash != NULL) {
+        HashTable_store(engine->hash, key, best_move, score_to_hash(best, ply), depth, bound);
+    }
+
+    if (engine->cache != NULL && depth >= ANALYSIS_CACHE_MIN_DEPTH) {
+        AnalysisCache_store(engine->cache, game, best_move, score_to_hash(best, ply), depth, bound);
+    }
+
+    return best;
+}
+
+// Root of a multi-PV search. Every root move is searched once, against the score of the worst of
+// the best num_lines moves found so far instead of the best one: a move that beats it gets an exact
+// score and its principal variation and takes the worst line's place, the others only have to be
+// shown to be worse. Moves of the previous iteration's lines are searched first, in their order.
+// Lines are only looked for inside of (floor, beta). Fills engine->lines best first, returns how many
+// lines there are and sets *legal to the number of legal root moves
+static int search_root(Engine *engine, int depth, const SearchResult *prev, int num_prev, int num_lines, int floor, int beta, int *legal) {
+    Chess *game = &engine->stack[0];
+
+    engine->nodes++;
+    engine->depth_stats->nodes++;
+
+    Move moves[ENGINE_MAX_MOVES];
+    int n = generate_moves(engine, game, moves);
+
+    order_moves(game, moves, n, NULL);
+
+    for (int i = num_prev - 1; i >= 0; i--) {
+        for (int j = 0; j < n; j++) {
+            if (move_equals(moves[j], prev[i].best_move)) {
+                Move move = moves[j];
+                memmove(&moves[1], &moves[0], sizeof(Move) * j);
+                moves[0] = move;
+                break;
+            }
+        }
+    }
+
+    int found = 0;
+
+    *legal = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (!make_move(engine, &engine->stack[1], game, moves[i])) {
+            continue;
+        }
+
+        (*legal)++;
+
+        int alpha = found < num_lines || engine->lines[found - 1].score < floor ? floor : engine->lines[found - 1].score;
+        int score = -search(engine, 1, depth - 1, -beta, -alpha);
+
+        if (should_stop(engine)) {
+            return found;
+        }
+
+        if (score <= alpha) {
+            continue;
+        }
+
+        // insert in order, dropping the worst line when there are already num_lines
+        int at = found < num_lines ? found++ : num_lines - 1;
+
+        for (; at > 0 && engine->lines[at - 1].score < score; at--) {
+            engine->lines[at] = engine->lines[at - 1];
+        }
+
+        SearchResult *line = &engine->lines[at];
+
+        line->score = score;
+        line->depth = depth;
+        line->best_move = line->pv[0] = moves[i];
+        memcpy(&line->pv[1], engine->pv[1], sizeof(Move) * engine->pv_length[1]);
+        line->pv_length = engine->pv_length[1] + 1;
+    }
+
+    if (*legal == 0) {
+        // no legal moves, one line with the mate / stalemate score
+        engine->lines[0] = (SearchResult){.score = Engine_in_check(game, game->current_turn) ? -ENGINE_MATE_SCORE : 0, .depth = depth};
+        found = 1;
+    }
+
+    return found;
+}
+
+static bool is_mate_score(int score) { return score > ENGINE_MATE_BOUND || score < -ENGINE_MATE_BOUND; }
+
+// Iterative deepening up to config.depth, single line
+SearchResult Engine_search(Engine *engine, const Chess *root, const uint64_t *history, int history_len) {
+    SearchResult result;
+
+    Engine_search_multipv(engine, root, history, history_len, &result, 1);
+
+    return result;
+}
+
+// Iterative deepening up to config.depth for the best num_lines root moves, each with its own score
+// and principal variation, see search_root. lines gets the lines of the last completed iteration,
+// best first, an iteration cut short by the node limit is thrown away. Returns the number of lines,
+// fewer than num_lines when there are not as many legal moves
+int Engine_search_multipv(Engine *engine, const Chess *root, const uint64_t *history, int history_len, SearchResult *lines, int num_lines) {
+    Chess_copy(&engine->stack[0], root);
+    engine->history = history;
+    engine->history_len = history_len;
+    engine->nodes = 0;
+    engine->next_check = 0;
+    engine->stop = false;
+    engine->prev_pv_length = 0;
+    engine->stats = (SearchStats){.searches = 1};
+    engine->depth_stats = &engine->stats.depths[0];
+
+    if (num_lines > ENGINE_MAX_LINES) {
+        num_lines = ENGINE_MAX_LINES;
+    }
+
+    int found = 0;
+    int first_depth = 1;
+    HashHit cached;
+
+    // Warm start from the cache's result for the root, the iterations up to its depth would only
+    // find it again. It stands in for them and is reported like one, at no more than config.depth:
+    // the search goes on one ply deeper, with its move first and in a window around its score, and
+    // it is kept when the search is stopped before that iteration completes
+    if (engine->cache != NULL && num_lines == 1 && AnalysisCache_probe(engine->cache, &engine->stack[0], &cached) &&
+        cached.bound == HashBoundExact && cached.has_move && Engine_make_move(&engine->stack[1], &engine->stack[0], cached.move)) {
+        int depth = cached.depth < engine->config.depth ? cached.depth : engine->config.depth;
+
+        first_depth = cached.depth + 1;
+        lines[0] = (SearchResult){.best_move = cached.move, .score = cached.score, .depth = depth, .pv_length = 1, .pv = {cached.move}};
+        found = 1;
+
+        engine->prev_pv[0] = cached.move;
+        engine->prev_pv_length = 1;
+
+        if (engine->on_iteration != NULL) {
+            engine->on_iteration(&lines[0], engine->callback_ctx);
+        }
+    }
+
+    for (int depth = first_depth; depth <= engine->config.depth; depth++) {
+        int legal = 0;
+        int searched = 0;
+
+        uint64_t iteration_start = Engine_now_ns();
+        engine->stats.max_depth = depth;
+        engine->depth_stats = &engine->stats.depths[depth];
+
+        // Narrow window around the previous iteration's lines first, most root moves then fail low
+        // cheaply. Searched again with the full window when a line falls outside of it
+        if (found > 0 && !is_mate_score(lines[0].score) && !is_mate_score(lines[found - 1].score)) {
+            int floor = lines[found - 1].score - ENGINE_ASPIRATION_WINDOW;
+            int beta = lines[0].score + ENGINE_ASPIRATION_WINDOW;
+
+            searched = search_root(engine, depth, lines, found, num_lines, floor, beta, &legal);
+
+            if (!engine->stop && (searched < (legal < num_lines ? legal : num_lines) || engine->lines[0].score >= beta)) {
+                searched = 0;
+            }
+        }
+
+        if (searched == 0 && !engine->stop) {
+            searched = search_root(engine, depth, lines, found, num_lines, -ENGINE_INF, ENGINE_INF, &legal);
+        }
+
+        engine->depth_stats->ns = Engine_now_ns() - iteration_start;
+
+        if (engine->stop && (depth > 1 || searched == 0)) {
+            break;
+        }
+
+        bool all_mate = true;
+
+        for (int i = 0; i < searched; i++) {
+            lines[i] = engine->lines[i];
+            lines[i].line = i;
+            lines[i].nodes = engine->nodes;
+            all_mate = all_mate && is_mate_score(lines[i].score);
+
+            if (engine->on_iteration != NULL && !engine->stop) {
+                engine->on_iteration(&lines[i], engine->callback_ctx);
+            }
+        }
+
+        found = searched;
+
+        // the root's result too, it is a node of the searches of the positions before it
+        if (engine->cache != NULL && !engine->stop && depth >= ANALYSIS_CACHE_MIN_DEPTH) {
+            AnalysisCache_store(engine->cache, &engine->stack[0], lines[0].pv_length > 0 ? &lines[0].best_move : NULL, lines[0].score, depth,
+                                HashBoundExact);
+        }
+
+        memcpy(engine->prev_pv, lines[0].pv, sizeof(Move) * lines[0].pv_length);
+        engine->prev_pv_length = lines[0].pv_length;
+
+        if (engine->stop || all_mate) {
+            break;
+        }
+    }
+
+    if (found == 0) {
+        // stopped before the first iteration found anything, any legal move will do
+        lines[0] = (SearchResult){0};
+
+        Move moves[ENGINE_MAX_MOVES];
+        int n = Engine_generate_moves(&engine->stack[0], moves);
+
+        for (int i = 0; i < n; i++) {
+            if (Engine_make_move(&engine->stack[1], &engine->stack[0], moves[i])) {
+                lines[0].best_move = lines[0].pv[0] = moves[i];
+                lines[0].pv_length = 1;
+                break;
+            }
+        }
+
+        found = 1;
+    }
+
+    for (int i = 0; i < found; i++) {
+        lines[i].nodes = engine->nodes;
+    }
+
+    if (engine->stats_out != NULL) {
+        SearchStats_write_json(&engine->stats, engine->config.name, engine->stats_out);
+    }
+
+    return found;
+}
+
+// "name=foo,depth=4,nodes=100000,hash=16,nnue,stats=search.jsonl,cache=analysis.cache"
+bool Engine_parse_config(const char *str, EngineConfig *config) {
+    *config = (EngineConfig){.depth = 3};
+    snprintf(config->name, sizeof(config->name), "engine");
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", str);
+
+    for (char *token = strtok(buf, ","); token != NULL; token = strtok(NULL, ",")) {
+        if (strncmp(token, "name=", 5) == 0) {
+            snprintf(config->name, sizeof(config->name), "%s", token + 5);
+        } else if (strncmp(token, "depth=", 6) == 0) {
+            config->depth = atoi(token + 6);
+        } else if (strncmp(token, "nodes=", 6) == 0) {
+            config->nodes = strtoull(token + 6, NULL, 10);
+        } else if (strncmp(token, "hash=", 5) == 0) {
+            config->hash_mb = atoi(token + 5);
+        } else if (strcmp(token, "nnue") == 0) {
+            config->use_nnue = true;
+        } else if (strncmp(token, "stats=", 6) == 0) {
+            snprintf(config->stats_path, sizeof(config->stats_path), "%s", token + 6);
+        } else if (strncmp(token, "cache=", 6) == 0) {
+            if (snprintf(config->cache_path, sizeof(config->cache_path), "%s", token + 6) >= (int)sizeof(config->cache_path)) {
+                printf("Cache path too long: %s\n", token + 6);
+                return false;
+            }
+        } else {
+            printf("Unknown engine option: %s\n", token);
+            return false;
+        }
+    }
+
+    if (config->depth < 1 || config->depth >= ENGINE_MAX_PLY) {
+        printf("Engine depth has to be between 1 and %d\n", ENGINE_MAX_PLY - 1);
+        return false;
+    }
+
+    return true;
+}
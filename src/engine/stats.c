@@ -0,0 +1,74 @@
+#include "engine.h"
+#include <stdio.h>
+
+void SearchStats_merge(SearchStats *into, const SearchStats *from) {
+    into->searches += from->searches;
+    into->max_depth = from->max_depth > into->max_depth ? from->max_depth : into->max_depth;
+
+    for (int depth = 1; depth <= from->max_depth; depth++) {
+        SearchDepthStats *a = &into->depths[depth];
+        const SearchDepthStats *b = &from->depths[depth];
+
+        a->nodes += b->nodes;
+        a->qnodes += b->qnodes;
+        a->cutoffs += b->cutoffs;
+        a->first_move_cutoffs += b->first_move_cutoffs;
+        a->hash_probes += b->hash_probes;
+        a->hash_hits += b->hash_hits;
+        a->hash_collisions += b->hash_collisions;
+        a->hash_cutoffs += b->hash_cutoffs;
+        a->cache_hits += b->cache_hits;
+        a->gen_ns += b->gen_ns;
+        a->eval_ns += b->eval_ns;
+        a->evals += b->evals;
+        a->ns += b->ns;
+    }
+}
+
+static inline double ratio(uint64_t a, uint64_t b) { return b == 0 ? 0 : (double)a / (double)b; }
+
+// One line, no spaces:
+// {"engine":..,"searches":..,"timed":..,"nodes":..,"qnodes":..,"ns":..,"depths":[{"depth":1,..},..]}
+// Per depth: the raw counters plus the effective branching factor (all nodes of this iteration
+// over those of the previous one), the share of cutoffs on the first move, and the hash hit and
+// collision rates per probe
+void SearchStats_write_json(const SearchStats *stats, const char *name, FILE *out) {
+    uint64_t nodes = 0, qnodes = 0, ns = 0;
+
+    for (int depth = 1; depth <= stats->max_depth; depth++) {
+        nodes += stats->depths[depth].nodes;
+        qnodes += stats->depths[depth].qnodes;
+        ns += stats->depths[depth].ns;
+    }
+
+#ifdef ENGINE_STATS
+    const char *timed = "true";
+#else
+    const char *timed = "false";
+#endif
+
+    // built in one buffer so lines of engines sharing the file don't interleave
+    char line[256 + ENGINE_MAX_PLY * 512];
+    int len = snprintf(line, sizeof(line), "{\"engine\":\"%s\",\"searches\":%llu,\"timed\":%s,\"nodes\":%llu,\"qnodes\":%llu,\"ns\":%llu,\"depths\":[",
+                       name, (unsigned long long)stats->searches, timed, (unsigned long long)nodes, (unsigned long long)qnodes,
+                       (unsigned long long)ns);
+
+    for (int depth = 1; depth <= stats->max_depth; depth++) {
+        const SearchDepthStats *d = &stats->depths[depth];
+        const SearchDepthStats *prev = &stats->depths[depth - 1];
+
+        len += snprintf(line + len, sizeof(line) - len,
+                        "%s{\"depth\":%d,\"nodes\":%llu,\"qnodes\":%llu,\"ebf\":%.3f,\"cutoffs\":%llu,\"first_move_cutoff_rate\":%.4f,"
+                        "\"hash_probes\":%llu,\"hash_hit_rate\":%.4f,\"hash_collision_rate\":%.4f,\"hash_cutoffs\":%llu,"
+                        "\"cache_hits\":%llu,\"gen_ns\":%llu,\"eval_ns\":%llu,\"evals\":%llu,\"ns\":%llu}",
+                        depth > 1 ? "," : "", depth, (unsigned long long)d->nodes, (unsigned long long)d->qnodes,
+                        depth > 1 ? ratio(d->nodes + d->qnodes, prev->nodes + prev->qnodes) : 0, (unsigned long long)d->cutoffs,
+                        ratio(d->first_move_cutoffs, d->cutoffs), (unsigned long long)d->hash_probes, ratio(d->hash_hits, d->hash_probes),
+                        ratio(d->hash_collisions, d->hash_probes), (unsigned long long)d->hash_cutoffs, (unsigned long long)d->cache_hits,
+                        (unsigned long long)d->gen_ns, (unsigned long long)d->eval_ns, (unsigned long long)d->evals, (unsigned long long)d->ns);
+    }
+
+    snprintf(line + len, sizeof(line) - len, "]}\n");
+    fputs(line, out);
+    fflush(out);
+}
@@ -0,0 +1,297 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input_log.h"
+
+// Text, one record per line, in the order the render loop asked for them:
+//
+//   E <frame> <ticks> quit
+//   E <frame> <ticks> key <keycode> <mouse x> <mouse y>
+//   E <frame> <ticks> click <button> <mouse x> <mouse y>
+//   M <frame> <mouse x> <mouse y>      the mouse was read and has moved since the last line
+//   H <frame> <depth>                  an analysis result of this depth was shown
+//
+// Only the events the loop acts on are written, everything else has no effect on a frame.
+// <ticks> is SDL_GetTicks when recording, for reading the log, replays go by frame.
+
+#define INPUT_LOG_HEADER "# chess input log 1\n"
+
+bool InputLog_record(InputLog *log, const char *path) {
+    *log = (InputLog){.mode = InputLogRecord, .last_x = -1, .last_y = -1};
+    log->file = fopen(path, "w");
+
+    if (log->file == NULL) {
+        printf("Failed to open %s for recording\n", path);
+        return false;
+    }
+
+    fputs(INPUT_LOG_HEADER, log->file);
+
+    return true;
+}
+
+static bool parse_record(const char *line, InputRecord *record) {
+    char name[16];
+    *record = (InputRecord){.kind = line[0]};
+
+    switch (line[0]) {
+        case 'M':
+            return sscanf(line + 1, "%u %d %d", &record->frame, &record->x, &record->y) == 3;
+
+        case 'H':
+            return sscanf(line + 1, "%u %d", &record->frame, &record->code) == 2;
+
+        case 'E': {
+            int n = sscanf(line + 1, "%u %u %15s %d %d %d", &record->frame, &record->ticks, name, &record->code, &record->x, &record->y);
+
+            if (n == 3 && strcmp(name, "quit") == 0) {
+                record->type = SDL_QUIT;
+                return true;
+            }
+
+            if (n == 6 && strcmp(name, "key") == 0) {
+                record->type = SDL_KEYDOWN;
+                return true;
+            }
+
+            if (n == 6 && strcmp(name, "click") == 0) {
+                record->type = SDL_MOUSEBUTTONDOWN;
+                return true;
+            }
+
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool InputLog_replay(InputLog *log, const char *path) {
+    *log = (InputLog){.mode = InputLogReplay};
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        printf("Failed to open %s for replay\n", path);
+        return false;
+    }
+
+    char line[128];
+    int capacity = 0;
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_number++;
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        if (log->count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            log->records = realloc(log->records, capacity * sizeof(InputRecord));
+
+            if (log->records == NULL) {
+                printf("Failed to allocate the input log\n");
+                exit(1);
+            }
+        }
+
+        if (!parse_record(line, &log->records[log->count])) {
+            printf("%s:%d: bad input record\n", path, line_number);
+            fclose(f);
+            InputLog_close(log);
+            return false;
+        }
+
+        log->count++;
+    }
+
+    fclose(f);
+
+    return true;
+}
+
+void InputLog_close(InputLog *log) {
+    if (log->file != NULL) {
+        fclose(log->file);
+    }
+
+    free(log->records);
+    *log = (InputLog){0};
+}
+
+static inline const InputRecord *peek(const InputLog *log, uint32_t frame, char kind) {
+    const InputRecord *record = log->next < log->count ? &log->records[log->next] : NULL;
+
+    return record != NULL && record->frame == frame && record->kind == kind ? record : NULL;
+}
+
+// Mouse positions read since the last event
+static void replay_mouse(InputLog *log, uint32_t frame) {
+    for (const InputRecord *record; (record = peek(log, frame, 'M')) != NULL; log->next++) {
+        log->last_x = record->x;
+        log->last_y = record->y;
+    }
+}
+
+// SDL_PollEvent, or the next recorded event of this frame
+bool InputLog_poll_event(InputLog *log, uint32_t frame, SDL_Event *event) {
+    if (log->mode != InputLogReplay) {
+        if (!SDL_PollEvent(event)) {
+            return false;
+        }
+
+        if (log->mode == InputLogRecord) {
+            int x, y;
+            SDL_GetMouseState(&x, &y);
+
+            if (event->type == SDL_QUIT) {
+                fprintf(log->file, "E %u %u quit\n", frame, event->common.timestamp);
+            } else if (event->type == SDL_KEYDOWN) {
+                fprintf(log->file, "E %u %u key %d %d %d\n", frame, event->common.timestamp, event->key.keysym.sym, x, y);
+            } else if (event->type == SDL_MOUSEBUTTONDOWN) {
+                fprintf(log->file, "E %u %u click %d %d %d\n", frame, event->common.timestamp, event->button.button, x, y);
+            } else {
+                return true;
+            }
+
+            // the event line has the position, InputLog_mouse_state doesn't repeat it
+            log->last_x = x;
+            log->last_y = y;
+        }
+
+        return true;
+    }
+
+    // whatever the (dummy) video driver queues is dropped, only the log drives the frame
+    SDL_PumpEvents();
+    SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+
+    replay_mouse(log, frame);
+
+    const InputRecord *record = peek(log, frame, 'E');
+
+    if (record == NULL) {
+        return false;
+    }
+
+    *event = (SDL_Event){.type = record->type};
+    event->common.timestamp = record->ticks;
+
+    if (record->type == SDL_KEYDOWN) {
+        event->key.keysym.sym = record->code;
+    } else if (record->type == SDL_MOUSEBUTTONDOWN) {
+        event->button.button = (uint8_t)record->code;
+        event->button.x = record->x;
+        event->button.y = record->y;
+    }
+
+    log->last_x = record->x;
+    log->last_y = record->y;
+    log->next++;
+
+    return true;
+}
+
+// SDL_GetMouseState. While replaying: the position recorded for this point of the frame
+void InputLog_mouse_state(InputLog *log, uint32_t frame, int *x, int *y) {
+    if (log->mode != InputLogReplay) {
+        SDL_GetMouseState(x, y);
+
+        if (log->mode == InputLogRecord && (*x != log->last_x || *y != log->last_y)) {
+            fprintf(log->file, "M %u %d %d\n", frame, *x, *y);
+            log->last_x = *x;
+            log->last_y = *y;
+        }
+
+        return;
+    }
+
+    replay_mouse(log, frame);
+
+    *x = log->last_x;
+    *y = log->last_y;
+}
+
+void InputLog_hint(InputLog *log, uint32_t frame, int depth) {
+    if (log->mode == InputLogRecord) {
+        fprintf(log->file, "H %u %d\n", frame, depth);
+    }
+}
+
+// The depth of the next analysis result shown on this frame
+bool InputLog_next_hint(InputLog *log, uint32_t frame, int *depth) {
+    const InputRecord *record = peek(log, frame, 'H');
+
+    if (record == NULL) {
+        return false;
+    }
+
+    *depth = record->code;
+    log->next++;
+
+    return true;
+}
+
+bool InputLog_finished(const InputLog *log, uint32_t frame) {
+    return log->mode == InputLogReplay && (log->next >= log->count || log->records[log->next].frame < frame);
+}
+
+void FrameTimes_add(FrameTimes *times, uint64_t ns) {
+    if (times->count == times->capacity) {
+        times->capacity = times->capacity ? times->capacity * 2 : 4096;
+        times->ns = realloc(times->ns, times->capacity * sizeof(uint64_t));
+
+        if (times->ns == NULL) {
+            printf("Failed to allocate frame times\n");
+            exit(1);
+        }
+    }
+
+    times->ns[times->count++] = ns;
+}
+
+static int compare_ns(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline double percentile_ms(const FrameTimes *times, double p) { return times->ns[(int)(p * (times->count - 1))] / 1e6; }
+
+void FrameTimes_report(FrameTimes *times, FILE *out) {
+    if (times->count == 0) {
+        fprintf(out, "no frames\n");
+        return;
+    }
+
+    uint64_t total = 0;
+
+    for (int i = 0; i < times->count; i++) {
+        total += times->ns[i];
+    }
+
+    qsort(times->ns, times->count, sizeof(uint64_t), compare_ns);
+
+    fprintf(out, "%d frames, mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n", times->count, total / 1e6 / times->count,
+            percentile_ms(times, 0.5), percentile_ms(times, 0.9), percentile_ms(times, 0.99), percentile_ms(times, 1));
+
+    // 1 ms buckets up to 32 ms, everything above in the last one
+    int buckets[33] = {0};
+
+    for (int i = 0; i < times->count; i++) {
+        uint64_t ms = times->ns[i] / 1000000;
+        buckets[ms < 32 ? ms : 32]++;
+    }
+
+    for (int i = 0; i <= 32; i++) {
+        if (buckets[i] > 0) {
+            fprintf(out, "  %s%2d ms %7d\n", i == 32 ? ">=" : "  ", i, buckets[i]);
+        }
+    }
+}
+
+void FrameTimes_free(FrameTimes *times) {
+    free(times->ns);
+    *times = (FrameTimes){0};
+}
@@ -0,0 +1,65 @@
+#include <SDL2/SDL_events.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef INPUT_LOG
+#define INPUT_LOG
+
+enum InputLogMode {
+    InputLogOff,
+    InputLogRecord,
+    InputLogReplay,
+};
+
+// One line of the log, see input_log.c for the text format
+struct _InputRecord {
+    char kind;
+    uint32_t frame;
+    uint32_t ticks;
+    uint32_t type;
+    int code;
+    int x, y;
+};
+typedef struct _InputRecord InputRecord;
+
+// The GUI's input, frame by frame: the events the render loop acts on, the mouse position it
+// reads and the frames an analysis result was shown on. Replaying feeds the same input to the
+// same frames, whatever the time between them.
+struct _InputLog {
+    enum InputLogMode mode;
+
+    // recording
+    FILE *file;
+    int last_x, last_y;
+
+    // replaying, the whole log is read upfront
+    InputRecord *records;
+    int count;
+    int next;
+};
+typedef struct _InputLog InputLog;
+
+bool InputLog_record(InputLog *log, const char *path);
+bool InputLog_replay(InputLog *log, const char *path);
+void InputLog_close(InputLog *log);
+
+bool InputLog_poll_event(InputLog *log, uint32_t frame, SDL_Event *event);
+void InputLog_mouse_state(InputLog *log, uint32_t frame, int *x, int *y);
+void InputLog_hint(InputLog *log, uint32_t frame, int depth);
+bool InputLog_next_hint(InputLog *log, uint32_t frame, int *depth);
+bool InputLog_finished(const InputLog *log, uint32_t frame);
+
+// Frame times of a replay
+struct _FrameTimes {
+    uint64_t *ns;
+    int count;
+    int capacity;
+};
+typedef struct _FrameTimes FrameTimes;
+
+void FrameTimes_add(FrameTimes *times, uint64_t ns);
+void FrameTimes_report(FrameTimes *times, FILE *out);
+void FrameTimes_free(FrameTimes *times);
+
+#endif // !INPUT_LOG
@@ -1,31 +1,28 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_error.h>
 #include <SDL2/SDL_events.h>
-#include <SDL2/SDL_image.h>
 #include <SDL2/SDL_mouse.h>
 #include <SDL2/SDL_pixels.h>
 #include <SDL2/SDL_rect.h>
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_surface.h>
 #include <SDL2/SDL_timer.h>
-#include <SDL2/SDL_ttf.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
+#include "analysis.h"
+#include "board_view.h"
 #include "chess/chess.h"
+#include "input_log.h"
 
-#define COLOR_BLACK ((SDL_Color){0, 0, 0, 255})
 #define COLOR_WHITE ((SDL_Color){255, 255, 255, 255})
 
 #define CELL_SIZE 120
-#define CELL_CAPTURE_TRIANGLE_SIZE (CELL_SIZE / 5.)
-#define CELL_FONT_SIZE (CELL_SIZE / 5.)
-
-#define CELL_CAPTURE_TRIANGE_COLOR ((SDL_Color){255, 0, 0, 150})
 
 #define BOARD_POS_X_START 10
 #define BOARD_POS_Y_START 40
@@ -34,6 +31,14 @@
 
 #define FPS (1000. / 60.)
 
+// a replay gives up on an analysis result it waits for after this long
+#define REPLAY_HINT_TIMEOUT_NS (10 * 1000000000ull)
+
+#define EVAL_BAR_X (BOARD_POS_X_START + CELL_SIZE * CHESS_BOARD_COLS + 20)
+#define EVAL_BAR_WIDTH 40
+// scores beyond this fill the whole bar
+#define EVAL_BAR_MAX_SCORE 1000
+
 int mouse_x;
 int mouse_y;
 
@@ -56,203 +61,122 @@ static inline Vec2 get_cell_coordinate(int row, int col) {
     return pos;
 }
 
-SDL_Texture *init_sprites(SDL_Renderer *renderer) {
-    SDL_Surface *sprites_surface = IMG_Load("./src/assets/chesssprites.png");
-
-    if (sprites_surface == NULL) {
-        printf("Failed to load sprites. Error: %s\n", SDL_GetError());
-        exit(1);
-    }
+void show_piece_moves(SDL_Renderer *renderer, BoardView *view, Chess *game, Piece *piece) {
+    for (int i = 0; i < piece->num_moves; i++) {
+        Vec2 cell_coord = get_cell_coordinate(piece->moves[i].row, piece->moves[i].col);
 
-    SDL_Texture *sprites_texture = SDL_CreateTextureFromSurface(renderer, sprites_surface);
+        SDL_Rect move = (SDL_Rect){
+            .x = cell_coord.x + CELL_SIZE / 2 - (CELL_SIZE / 8),
+            .y = cell_coord.y + CELL_SIZE / 2 - (CELL_SIZE / 8),
+            .w = CELL_SIZE / 4,
+            .h = CELL_SIZE / 4,
+        };
 
-    if (sprites_texture == NULL) {
-        printf("Failed to load sprites texture. Error: %s\n", SDL_GetError());
-        exit(1);
+        if (game->board[piece->moves[i].row][piece->moves[i].col].piece.type == UndefPieceType) {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 255, 150);
+            SDL_RenderFillRect(renderer, &move);
+        } else if (game->board[piece->moves[i].row][piece->moves[i].col].piece.type != King) {
+            BoardView_capture_marker(view, cell_coord.x, cell_coord.y);
+        }
     }
-
-    return sprites_texture;
 }
 
-SDL_Vertex vertices[12] = {0};
-
-static inline void get_vertices_for_capturable_piece(int cell_coord_x, int cell_coord_y) {
-    // top left
-    vertices[0] = (SDL_Vertex){{(float)cell_coord_x, (float)cell_coord_y}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[1] = (SDL_Vertex){{(float)(cell_coord_x + CELL_CAPTURE_TRIANGLE_SIZE), (float)cell_coord_y}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[2] = (SDL_Vertex){{(float)cell_coord_x, (float)(cell_coord_y + CELL_CAPTURE_TRIANGLE_SIZE)}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-
-    // top right
-    vertices[3] = (SDL_Vertex){{(float)cell_coord_x + CELL_SIZE, (float)cell_coord_y}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[4] =
-        (SDL_Vertex){{(float)cell_coord_x + CELL_SIZE - CELL_CAPTURE_TRIANGLE_SIZE, (float)cell_coord_y}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[5] =
-        (SDL_Vertex){{(float)cell_coord_x + CELL_SIZE, (float)cell_coord_y + CELL_CAPTURE_TRIANGLE_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-
-    // bottom right
-    vertices[6] = (SDL_Vertex){{(float)cell_coord_x + CELL_SIZE, (float)cell_coord_y + CELL_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[7] = (SDL_Vertex){
-        {(float)cell_coord_x + CELL_SIZE - CELL_CAPTURE_TRIANGLE_SIZE, (float)cell_coord_y + CELL_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[8] = (SDL_Vertex){
-        {(float)cell_coord_x + CELL_SIZE, (float)cell_coord_y + CELL_SIZE - CELL_CAPTURE_TRIANGLE_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-
-    // bottom left
-    vertices[9] = (SDL_Vertex){{(float)cell_coord_x, (float)cell_coord_y + CELL_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[10] =
-        (SDL_Vertex){{(float)cell_coord_x, (float)cell_coord_y + CELL_SIZE - CELL_CAPTURE_TRIANGLE_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-    vertices[11] =
-        (SDL_Vertex){{(float)cell_coord_x + CELL_CAPTURE_TRIANGLE_SIZE, (float)cell_coord_y + CELL_SIZE}, CELL_CAPTURE_TRIANGE_COLOR, {1, 1}};
-}
-
-void draw_chess_board(Chess *game, SDL_Renderer *renderer, TTF_Font *font, SDL_Texture *sprites_texture, Pos pos) {
-    // Draw a border around a square if it's under the mouse cursor
-    if (pos.col != -1 && pos.row != -1) {
-        // find the cell
-        SDL_Rect cell_dst =
-            (SDL_Rect){.x = BOARD_POS_X_START + pos.col * CELL_SIZE, .y = BOARD_POS_Y_START + pos.row * CELL_SIZE, .w = CELL_SIZE, .h = CELL_SIZE};
-
-        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-        SDL_RenderFillRect(renderer, &cell_dst);
-    }
+// Best move hint and evaluation bar from the background analysis
+void draw_analysis(SDL_Renderer *renderer, Chess *game, AnalysisResult *result, SDL_Texture *line, SDL_Rect line_rect) {
+    if (result->pv_length > 0) {
+        Pos squares[2] = {result->pv[0].from, result->pv[0].to};
 
-    int x = BOARD_POS_X_START;
-    int y = BOARD_POS_Y_START;
+        SDL_SetRenderDrawColor(renderer, 0, 200, 0, 100);
 
-    char buf[2];
-
-    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
-        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
-            Cell cell = (game->board)[row][col];
-
-            if (cell.color == ColorWhite) {
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            } else {
-                SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-            }
-
-            SDL_Rect cell_dst = (SDL_Rect){.x = x, .y = y, .w = CELL_SIZE, .h = CELL_SIZE};
-
-            if (row == pos.row && col == pos.col) {
-                cell_dst.x += 5;
-                cell_dst.y += 5;
-                cell_dst.w -= 10;
-                cell_dst.h -= 10;
-            }
+        for (int i = 0; i < 2; i++) {
+            Vec2 cell_coord = get_cell_coordinate(squares[i].row, squares[i].col);
+            SDL_Rect cell_dst = (SDL_Rect){.x = cell_coord.x, .y = cell_coord.y, .w = CELL_SIZE, .h = CELL_SIZE};
 
             SDL_RenderFillRect(renderer, &cell_dst);
+        }
+    }
 
-            if (cell.piece.type != UndefPieceType) {
-                SDL_RenderCopy(renderer, sprites_texture, &cell.piece.sprite_loc, &cell_dst);
-            }
-
-            if (game->kingInCheck[0] && Chess_is_piece(&cell.piece, King, ColorBlack)) {
-                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 150);
-
-                // Draw 4 triangles inside the cell
-                get_vertices_for_capturable_piece(x, y);
-                if (SDL_RenderGeometry(renderer, NULL, vertices, 12, NULL, 0) != 0) {
-                    printf("SDL_RenderGeometry error: %s\n", SDL_GetError());
-                }
-            }
-
-            if (game->kingInCheck[1] && Chess_is_piece(&cell.piece, King, ColorWhite)) {
-                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 150);
+    int white_score = result->side_to_move == ColorWhite ? result->score : -result->score;
 
-                // Draw 4 triangles inside the cell
-                get_vertices_for_capturable_piece(x, y);
-                if (SDL_RenderGeometry(renderer, NULL, vertices, 12, NULL, 0) != 0) {
-                    printf("SDL_RenderGeometry error: %s\n", SDL_GetError());
-                }
-            }
-
-            if (row == CHESS_BOARD_ROWS - 1) {
-                snprintf(buf, 2, "%c", 'a' + col);
-                SDL_Surface *surfaceMessage = TTF_RenderText_Blended(font, buf, cell.color == ColorWhite ? COLOR_BLACK : COLOR_WHITE);
-                SDL_Texture *message = SDL_CreateTextureFromSurface(renderer, surfaceMessage);
+    if (white_score > EVAL_BAR_MAX_SCORE) {
+        white_score = EVAL_BAR_MAX_SCORE;
+    } else if (white_score < -EVAL_BAR_MAX_SCORE) {
+        white_score = -EVAL_BAR_MAX_SCORE;
+    }
 
-                cell_dst.x = x + CELL_SIZE - CELL_FONT_SIZE;
-                cell_dst.y = y + CELL_SIZE - CELL_FONT_SIZE * 2;
-                cell_dst.w = CELL_FONT_SIZE;
-                cell_dst.h = CELL_FONT_SIZE * 2;
+    int bar_height = CELL_SIZE * CHESS_BOARD_ROWS;
+    int white_height = bar_height / 2 + white_score * (bar_height / 2) / EVAL_BAR_MAX_SCORE;
 
-                SDL_RenderCopy(renderer, message, NULL, &cell_dst);
+    SDL_Rect bar = (SDL_Rect){.x = EVAL_BAR_X, .y = BOARD_POS_Y_START, .w = EVAL_BAR_WIDTH, .h = bar_height};
+    SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+    SDL_RenderFillRect(renderer, &bar);
 
-                SDL_FreeSurface(surfaceMessage);
-                SDL_DestroyTexture(message);
-            }
+    // white's share of the bar is on white's side of the board
+    bar.h = white_height;
+    bar.y = game->white_at_bottom ? BOARD_POS_Y_START + bar_height - white_height : BOARD_POS_Y_START;
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderFillRect(renderer, &bar);
 
-            if (col == 0) {
-                snprintf(buf, 2, "%d", CHESS_BOARD_ROWS - row);
-                SDL_Surface *surfaceMessage = TTF_RenderText_Blended(font, buf, cell.color == ColorWhite ? COLOR_BLACK : COLOR_WHITE);
-                SDL_Texture *message = SDL_CreateTextureFromSurface(renderer, surfaceMessage);
+    if (line != NULL) {
+        SDL_RenderCopy(renderer, line, NULL, &line_rect);
+    }
+}
 
-                cell_dst.x = x;
-                cell_dst.y = y + CELL_SIZE - CELL_FONT_SIZE * 2;
-                cell_dst.w = CELL_FONT_SIZE;
-                cell_dst.h = CELL_FONT_SIZE * 2;
+// "depth 6  +0.35  e2e4 e7e5 g1f3", only re-rendered when a new result comes in
+SDL_Texture *render_analysis_line(SDL_Renderer *renderer, Chess *game, AnalysisResult *result, SDL_Rect *line_rect) {
+    char buf[128];
+    int white_score = result->side_to_move == ColorWhite ? result->score : -result->score;
+    int len = snprintf(buf, sizeof(buf), "depth %d  %+.2f ", result->depth, white_score / 100.);
 
-                SDL_RenderCopy(renderer, message, NULL, &cell_dst);
+    for (int i = 0; i < result->pv_length; i++) {
+        char from[3], to[3];
 
-                SDL_FreeSurface(surfaceMessage);
-                SDL_DestroyTexture(message);
-            }
+        Chess_square_name(game, result->pv[i].from, from);
+        Chess_square_name(game, result->pv[i].to, to);
+        len += snprintf(buf + len, sizeof(buf) - len, " %s%s", from, to);
+    }
 
-            x += CELL_SIZE;
-        }
+    SDL_Surface *surfaceMessage = BoardAssets_text(buf, COLOR_WHITE);
 
-        x = BOARD_POS_X_START;
-        y += CELL_SIZE;
+    if (surfaceMessage == NULL) {
+        return NULL;
     }
-}
 
-void show_piece_moves(SDL_Renderer *renderer, Chess *game, Piece *piece) {
-    for (int i = 0; i < piece->num_moves; i++) {
-        Vec2 cell_coord = get_cell_coordinate(piece->moves[i].row, piece->moves[i].col);
+    SDL_Texture *message = SDL_CreateTextureFromSurface(renderer, surfaceMessage);
 
-        SDL_Rect move = (SDL_Rect){
-            .x = cell_coord.x + CELL_SIZE / 2 - (CELL_SIZE / 8),
-            .y = cell_coord.y + CELL_SIZE / 2 - (CELL_SIZE / 8),
-            .w = CELL_SIZE / 4,
-            .h = CELL_SIZE / 4,
-        };
+    *line_rect = (SDL_Rect){.x = BOARD_POS_X_START,
+                            .y = BOARD_POS_Y_START + CELL_SIZE * CHESS_BOARD_ROWS + 5,
+                            .w = surfaceMessage->w * 3,
+                            .h = surfaceMessage->h * 3};
 
-        if (game->board[piece->moves[i].row][piece->moves[i].col].piece.type == UndefPieceType) {
-            SDL_SetRenderDrawColor(renderer, 0, 0, 255, 150);
-            SDL_RenderFillRect(renderer, &move);
-        } else if (game->board[piece->moves[i].row][piece->moves[i].col].piece.type != King) {
-            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 150);
+    SDL_FreeSurface(surfaceMessage);
 
-            // Draw 4 triangles inside the cell
-            get_vertices_for_capturable_piece(cell_coord.x, cell_coord.y);
-            if (SDL_RenderGeometry(renderer, NULL, vertices, 12, NULL, 0) != 0) {
-                printf("SDL_RenderGeometry error: %s\n", SDL_GetError());
-            }
-        }
-    }
+    return message;
 }
 
-void handle_mouse_click(Chess *game, Pos *pos) {
+// returns whether a move was made
+bool handle_mouse_click(Chess *game, Pos *pos) {
     if (!pos_within_bounds(pos->row, pos->col)) {
-        return;
+        return false;
     }
 
     Cell *cell = &game->board[pos->row][pos->col];
 
     if (game->game_mode) {
         if (game->clicked_piece == NULL && cell->piece.color != game->current_turn) {
-            return;
+            return false;
         }
     }
 
     if (game->clicked_piece == NULL && cell->piece.type != UndefPieceType) {
         game->clicked_piece = &cell->piece;
-        return;
+        return false;
     }
 
     if (game->clicked_piece == &cell->piece) {
         // clicked on the same piece
         game->clicked_piece = NULL;
-        return;
+        return false;
     }
 
     if (game->clicked_piece != NULL) {
@@ -260,14 +184,34 @@ void handle_mouse_click(Chess *game, Pos *pos) {
         if (Chess_make_move(game, game->clicked_piece, *pos)) {
             // move was leagal
             game->clicked_piece = NULL;
+            return true;
         } else if (cell->piece.type != UndefPieceType) {
             // move was illegal. Reset the clicked_piece if click was on another piece
             game->clicked_piece = &cell->piece;
         }
     }
+
+    return false;
 }
 
-int main() {
+// --record <file> logs the input of the session, --replay <file> plays it back as fast as frames
+// can be drawn and prints the frame times, e.g. SDL_VIDEODRIVER=dummy ./bin/main --replay session.log
+int main(int argc, char **argv) {
+    InputLog input = {0};
+
+    if (argc == 3 && strcmp(argv[1], "--record") == 0) {
+        if (!InputLog_record(&input, argv[2])) {
+            return 1;
+        }
+    } else if (argc == 3 && strcmp(argv[1], "--replay") == 0) {
+        if (!InputLog_replay(&input, argv[2])) {
+            return 1;
+        }
+    } else if (argc != 1) {
+        printf("Usage: %s [--record <file> | --replay <file>]\n", argv[0]);
+        return 1;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("SDL initialization failed! %s\n", SDL_GetError());
         return 1;
@@ -284,6 +228,11 @@ int main() {
 
     SDL_Renderer *renderer = SDL_CreateRenderer(window, 0, SDL_RENDERER_ACCELERATED);
 
+    // no GPU, e.g. the dummy video driver of a headless replay
+    if (renderer == NULL) {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
+
     if (renderer == NULL) {
         printf("Failed to create renderer with error: %s\n", SDL_GetError());
         SDL_Quit();
@@ -292,46 +241,65 @@ int main() {
 
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-    TTF_Init();
-    // this opens a font style and sets a size
-    TTF_Font *font = TTF_OpenFont("./src/assets/Arial.ttf", 10);
-
-    if (font == NULL) {
-        printf("Failed to load font with error: %s\n", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
-
     int quit = 0;
     SDL_Event event;
 
     Chess game = {0};
     game.game_mode = false;
     game.white_at_bottom = true;
+    game.current_turn = ColorWhite;
 
-    // enough to store moves for all pieces
-    game.arena = arena_init(CHESS_BOARD_COLS * CHESS_BOARD_ROWS * sizeof(Pos) * 35);
+    game.arena = arena_init(CHESS_ARENA_SIZE);
 
     Chess_init_board(&game);
     Chess_calculate_moves(&game);
 
-    SDL_Texture *sprites_texture = init_sprites(renderer);
+    // sprites and the board labels come from the binary and become textures once, not on every frame
+    BoardAssets assets;
+    BoardView view;
+
+    if (!BoardAssets_init(&assets) || !BoardView_init(&view, renderer, &assets, CELL_SIZE)) {
+        SDL_Quit();
+        return 1;
+    }
 
-    uint32_t a = SDL_GetTicks();
-    uint32_t b = SDL_GetTicks();
+    // Analysis runs on its own thread, the render loop only hands it snapshots and polls for results
+    Analysis analysis;
+    Analysis_start(&analysis);
 
-    float delta = 0;
+    bool analysis_pending = !Analysis_request(&analysis, &game);
+
+    AnalysisResult hint = {0};
+    bool have_hint = false;
+    SDL_Texture *hint_line = NULL;
+    SDL_Rect hint_line_rect = {0};
+
+    uint32_t last_frame = SDL_GetTicks();
+    uint32_t frame = 0;
+    FrameTimes frame_times = {0};
 
     while (!quit) {
-        a = SDL_GetTicks();
-        delta += a - b;
+        uint32_t now = SDL_GetTicks();
+        bool replay = input.mode == InputLogReplay;
 
-        if (delta < FPS) {
+        // replays run unthrottled, one frame per recorded frame
+        if (!replay && now - last_frame < FPS) {
+            SDL_Delay(1);
             continue;
         }
 
-        while (SDL_PollEvent(&event)) {
-            SDL_GetMouseState(&mouse_x, &mouse_y);
+        if (InputLog_finished(&input, frame)) {
+            break;
+        }
+
+        last_frame = now;
+        frame++;
+
+        uint64_t frame_start = Engine_now_ns();
+        uint64_t waited = 0;
+
+        while (InputLog_poll_event(&input, frame, &event)) {
+            InputLog_mouse_state(&input, frame, &mouse_x, &mouse_y);
 
             Pos pos = mouse_pos_to_cell();
 
@@ -353,22 +321,95 @@ int main() {
                 }
 
                 case SDL_MOUSEBUTTONDOWN: {
-                    handle_mouse_click(&game, &pos);
+                    if (handle_mouse_click(&game, &pos)) {
+                        // the old hints are for a position that's gone
+                        have_hint = false;
+                        analysis_pending = !Analysis_request(&analysis, &game);
+                    }
                 }
             }
+        }
+
+        if (analysis_pending) {
+            analysis_pending = !Analysis_request(&analysis, &game);
+        }
+
+        bool new_hint = false;
 
-            draw_chess_board(&game, renderer, font, sprites_texture, pos);
+        if (replay) {
+            // the results the recording showed on this frame, waiting for them isn't frame time
+            int depth;
 
-            if (game.clicked_piece != NULL) {
-                show_piece_moves(renderer, &game, game.clicked_piece);
+            while (InputLog_next_hint(&input, frame, &depth)) {
+                uint64_t wait_start = Engine_now_ns();
+
+                while (!(Analysis_poll(&analysis, &hint) && hint.depth >= depth) && Engine_now_ns() - wait_start < REPLAY_HINT_TIMEOUT_NS) {
+                    SDL_Delay(1);
+                }
+
+                waited += Engine_now_ns() - wait_start;
+                new_hint = true;
             }
+        } else {
+            new_hint = Analysis_poll(&analysis, &hint);
 
-            SDL_RenderPresent(renderer);
+            if (new_hint) {
+                InputLog_hint(&input, frame, hint.depth);
+            }
         }
 
-        b = SDL_GetTicks();
+        if (new_hint) {
+            have_hint = true;
+
+            if (hint_line != NULL) {
+                SDL_DestroyTexture(hint_line);
+            }
+
+            hint_line = render_analysis_line(renderer, &game, &hint, &hint_line_rect);
+        }
+
+        InputLog_mouse_state(&input, frame, &mouse_x, &mouse_y);
+        Pos pos = mouse_pos_to_cell();
+
+        // clear the area below and next to the board, the analysis line and bar change size
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+
+        BoardView_draw(&view, &game, BOARD_POS_X_START, BOARD_POS_Y_START, pos);
+
+        if (have_hint) {
+            draw_analysis(renderer, &game, &hint, hint_line, hint_line_rect);
+        }
+
+        if (game.clicked_piece != NULL) {
+            show_piece_moves(renderer, &view, &game, game.clicked_piece);
+        }
+
+        SDL_RenderPresent(renderer);
+
+        if (replay) {
+            FrameTimes_add(&frame_times, Engine_now_ns() - frame_start - waited);
+        }
     }
 
-    TTF_CloseFont(font);
+    if (input.mode == InputLogReplay) {
+        FrameTimes_report(&frame_times, stdout);
+    }
+
+    FrameTimes_free(&frame_times);
+    InputLog_close(&input);
+
+    Analysis_stop(&analysis);
+
+    if (hint_line != NULL) {
+        SDL_DestroyTexture(hint_line);
+    }
+
+#ifdef CHESS_STATS
+    Chess_stats_report(stdout);
+#endif
+
+    BoardView_free(&view);
+    BoardAssets_free(&assets);
     SDL_Quit();
 }
@@ -0,0 +1,709 @@
+// Long running analysis / move validation daemon on a Unix domain socket.
+//
+// One request per line, fields separated by ';':
+//
+//   analyze id=1;fen=<fen>;moves=e2e4 e7e5;depth=6;nodes=100000;deadline_ms=200;multipv=3
+//   validate id=2;fen=<fen>;move=g1f3
+//   cancel id=1
+//
+// fen defaults to the starting position. Every request gets exactly one response line, except
+// analyze with multipv=N which gets one per line, best first:
+//
+//   id=1 status=ok bestmove=g1f3 score=31 depth=6 nodes=48211 time_ms=120 pv=g1f3 b8c6
+//   id=1 status=ok multipv=2 bestmove=e2e4 score=24 depth=6 nodes=48211 time_ms=120 pv=e2e4 e7e5
+//   id=2 status=ok legal=1
+//   id=3 status=busy|cancelled|timeout|error [reason=...]
+//
+// A single epoll thread owns the sockets and feeds a bounded queue, a fixed pool of workers
+// (each with its own preallocated Engine and Game) drains it. A full queue is answered with
+// status=busy right away instead of queueing up latency. All workers share one hash table, and
+// with --cache <file> one persistent analysis cache, so a restarted daemon finds its deep results.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS 1024
+#define MAX_EVENTS 64
+#define MAX_LINE 1024
+#define MAX_DEPTH 32
+
+#define STARTPOS_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+enum JobType { JobAnalyze, JobValidate };
+
+struct _Job {
+    enum JobType type;
+
+    // the connection that asked, the generation tells a reused fd apart
+    int fd;
+    uint64_t client_gen;
+
+    char id[32];
+    char fen[128];
+    char moves[MAX_LINE];
+    char move[8];
+
+    int depth;
+    int multipv;
+    uint64_t nodes;
+    uint64_t received_ns;
+    uint64_t deadline_ns;
+
+    atomic_bool cancel;
+};
+typedef struct _Job Job;
+
+struct _Client {
+    int fd;
+    uint64_t gen;
+    char buf[MAX_LINE];
+    size_t len;
+};
+typedef struct _Client Client;
+
+// Bounded queue of jobs, jobs themselves come from a fixed pool so the steady state never allocates.
+// Also tracks the job each worker is running so they can be cancelled.
+struct _WorkQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+
+    Job **ring;
+    int capacity;
+    int head;
+    int count;
+
+    Job *pool;
+    Job **free_jobs;
+    int num_free;
+
+    Job **running;
+    int num_workers;
+
+    bool shutdown;
+};
+typedef struct _WorkQueue WorkQueue;
+
+static WorkQueue queue;
+
+static HashTable *hash_table;
+
+// --cache, shared by the workers and opened by the first search. Other daemons can use the same file
+static AnalysisCache *analysis_cache;
+
+// --stats, every worker appends a line per search
+static const char *stats_path;
+
+// clients are indexed by fd, clients_lock guards them against workers writing responses
+static Client clients[MAX_CLIENTS];
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t next_client_gen = 1;
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static void queue_init(int capacity, int num_workers) {
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.not_empty, NULL);
+
+    int pool_size = capacity + num_workers;
+
+    queue.ring = calloc(capacity, sizeof(Job *));
+    queue.capacity = capacity;
+    queue.pool = calloc(pool_size, sizeof(Job));
+    queue.free_jobs = calloc(pool_size, sizeof(Job *));
+    queue.running = calloc(num_workers, sizeof(Job *));
+    queue.num_workers = num_workers;
+
+    if (queue.ring == NULL || queue.pool == NULL || queue.free_jobs == NULL || queue.running == NULL) {
+        printf("Failed to allocate the work queue\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < pool_size; i++) {
+        queue.free_jobs[queue.num_free++] = &queue.pool[i];
+    }
+}
+
+// NULL when the server is at capacity
+static Job *queue_job_alloc(void) {
+    pthread_mutex_lock(&queue.lock);
+    Job *job = queue.count < queue.capacity && queue.num_free > 0 ? queue.free_jobs[--queue.num_free] : NULL;
+    pthread_mutex_unlock(&queue.lock);
+
+    return job;
+}
+
+static void queue_job_free(Job *job) {
+    pthread_mutex_lock(&queue.lock);
+    queue.free_jobs[queue.num_free++] = job;
+    pthread_mutex_unlock(&queue.lock);
+}
+
+static void queue_push(Job *job) {
+    pthread_mutex_lock(&queue.lock);
+
+    queue.ring[(queue.head + queue.count) % queue.capacity] = job;
+    queue.count++;
+
+    pthread_cond_signal(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+// Blocks until there is a job, NULL on shutdown
+static Job *queue_pop(int worker) {
+    pthread_mutex_lock(&queue.lock);
+
+    while (queue.count == 0 && !queue.shutdown) {
+        pthread_cond_wait(&queue.not_empty, &queue.lock);
+    }
+
+    Job *job = NULL;
+
+    if (queue.count > 0) {
+        job = queue.ring[queue.head];
+        queue.head = (queue.head + 1) % queue.capacity;
+        queue.count--;
+    }
+
+    queue.running[worker] = job;
+
+    pthread_mutex_unlock(&queue.lock);
+
+    return job;
+}
+
+static void queue_done(int worker) {
+    pthread_mutex_lock(&queue.lock);
+    queue.running[worker] = NULL;
+    pthread_mutex_unlock(&queue.lock);
+}
+
+// Cancels queued and running jobs of a client, all of them when id is NULL
+static void queue_cancel(uint64_t client_gen, const char *id) {
+    pthread_mutex_lock(&queue.lock);
+
+    for (int i = 0; i < queue.count; i++) {
+        Job *job = queue.ring[(queue.head + i) % queue.capacity];
+
+        if (job->client_gen == client_gen && (id == NULL || strcmp(job->id, id) == 0)) {
+            atomic_store(&job->cancel, true);
+        }
+    }
+
+    for (int i = 0; i < queue.num_workers; i++) {
+        Job *job = queue.running[i];
+
+        if (job != NULL && job->client_gen == client_gen && (id == NULL || strcmp(job->id, id) == 0)) {
+            atomic_store(&job->cancel, true);
+        }
+    }
+
+    pthread_mutex_unlock(&queue.lock);
+}
+
+// Responses are small, a client that doesn't read them is disconnected instead of stalling a worker
+static void send_line(int fd, uint64_t client_gen, const char *line) {
+    pthread_mutex_lock(&clients_lock);
+
+    Client *client = &clients[fd];
+
+    if (client->fd == fd && client->gen == client_gen) {
+        size_t len = strlen(line);
+
+        if (send(fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)len) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+    pthread_mutex_unlock(&clients_lock);
+}
+
+static void respond_status(int fd, uint64_t client_gen, const char *id, const char *status, const char *reason) {
+    char line[256];
+
+    if (reason != NULL) {
+        snprintf(line, sizeof(line), "id=%s status=%s reason=%s\n", id, status, reason);
+    } else {
+        snprintf(line, sizeof(line), "id=%s status=%s\n", id, status);
+    }
+
+    send_line(fd, client_gen, line);
+}
+
+// Sets up the job's position in game, false if the fen or a move is bad
+static bool load_position(Game *game, const Job *job) {
+    if (!Game_load_fen(game, job->fen[0] ? job->fen : STARTPOS_FEN)) {
+        return false;
+    }
+
+    char moves[MAX_LINE];
+    snprintf(moves, sizeof(moves), "%s", job->moves);
+
+    char *save = NULL;
+    for (char *token = strtok_r(moves, " ", &save); token != NULL; token = strtok_r(NULL, " ", &save)) {
+        Move move;
+
+        if (!Game_parse_uci(game, token, &move) || !Game_play_move(game, move)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void run_analyze(Engine *engine, Game *game, Job *job) {
+    char line[MAX_LINE + 256];
+
+    enum GameEndReason reason;
+    enum GameResult result = Game_result(game, &reason);
+
+    if (result != GameOngoing) {
+        snprintf(line, sizeof(line), "id=%s status=ok bestmove=none result=%s reason=%s\n", job->id, Game_result_string(result),
+                 Game_end_reason_string(reason));
+        send_line(job->fd, job->client_gen, line);
+        return;
+    }
+
+    engine->config.depth = job->depth;
+    engine->config.nodes = job->nodes;
+    engine->cancel = &job->cancel;
+    engine->deadline_ns = job->deadline_ns;
+
+    SearchResult lines[ENGINE_MAX_LINES];
+    int num_lines = Engine_search_multipv(engine, &game->chess, game->history, game->ply + 1, lines, job->multipv);
+
+    if (atomic_load(&job->cancel)) {
+        respond_status(job->fd, job->client_gen, job->id, "cancelled", NULL);
+        return;
+    }
+
+    uint64_t time_ms = (Engine_now_ns() - job->received_ns) / 1000000;
+
+    for (int l = 0; l < num_lines; l++) {
+        const SearchResult *search = &lines[l];
+        char uci[6];
+        Game_move_to_uci(game, search->best_move, uci);
+
+        int len = snprintf(line, sizeof(line), "id=%s status=ok ", job->id);
+
+        if (job->multipv > 1) {
+            len += snprintf(line + len, sizeof(line) - len, "multipv=%d ", l + 1);
+        }
+
+        len += snprintf(line + len, sizeof(line) - len, "bestmove=%s score=%d depth=%d nodes=%lu time_ms=%lu pv=", uci, search->score, search->depth,
+                        (unsigned long)search->nodes, (unsigned long)time_ms);
+
+        for (int i = 0; i < search->pv_length && len < (int)sizeof(line) - 8; i++) {
+            Game_move_to_uci(game, search->pv[i], uci);
+            len += snprintf(line + len, sizeof(line) - len, "%s%s", i ? " " : "", uci);
+        }
+
+        snprintf(line + len, sizeof(line) - len, "\n");
+        send_line(job->fd, job->client_gen, line);
+    }
+}
+
+static void run_validate(Game *game, Job *job) {
+    Move move;
+    bool legal = Game_parse_uci(game, job->move, &move) && Chess_is_legal_move(&game->chess, move.from, move.to);
+
+    char line[128];
+    snprintf(line, sizeof(line), "id=%s status=ok legal=%d\n", job->id, legal);
+    send_line(job->fd, job->client_gen, line);
+}
+
+static void *worker(void *arg) {
+    int idx = (int)(intptr_t)arg;
+
+    // preallocated once, reused for every job
+    EngineConfig config = {.name = "analysis", .depth = MAX_DEPTH};
+
+    if (stats_path != NULL) {
+        snprintf(config.stats_path, sizeof(config.stats_path), "%s", stats_path);
+    }
+
+    Engine *engine = Engine_new(config);
+    Game *game = Game_new();
+
+    engine->hash = hash_table;
+    engine->cache = analysis_cache;
+
+    Job *job;
+
+    while ((job = queue_pop(idx)) != NULL) {
+        if (atomic_load(&job->cancel)) {
+            respond_status(job->fd, job->client_gen, job->id, "cancelled", NULL);
+        } else if (job->deadline_ns != 0 && Engine_now_ns() >= job->deadline_ns) {
+            respond_status(job->fd, job->client_gen, job->id, "timeout", NULL);
+        } else if (!load_position(game, job)) {
+            respond_status(job->fd, job->client_gen, job->id, "error", "bad_position");
+        } else if (job->type == JobAnalyze) {
+            run_analyze(engine, game, job);
+        } else {
+            run_validate(game, job);
+        }
+
+        queue_done(idx);
+        queue_job_free(job);
+    }
+
+    Engine_free(engine);
+    Game_free(game);
+
+    return NULL;
+}
+
+// "analyze id=1;fen=...;depth=4" -> job. Returns false with the reason set on malformed requests
+static bool parse_job(char *fields, Job *job, const char **reason) {
+    job->depth = 6;
+    job->multipv = 1;
+    job->nodes = 0;
+    job->deadline_ns = 0;
+    job->fen[0] = job->moves[0] = job->move[0] = '\0';
+
+    char *save = NULL;
+    for (char *field = strtok_r(fields, ";", &save); field != NULL; field = strtok_r(NULL, ";", &save)) {
+        char *value = strchr(field, '=');
+
+        if (value == NULL) {
+            *reason = "bad_field";
+            return false;
+        }
+
+        *value++ = '\0';
+
+        if (strcmp(field, "id") == 0) {
+            // already parsed
+        } else if (strcmp(field, "fen") == 0) {
+            snprintf(job->fen, sizeof(job->fen), "%s", value);
+        } else if (strcmp(field, "moves") == 0) {
+            snprintf(job->moves, sizeof(job->moves), "%s", value);
+        } else if (strcmp(field, "move") == 0) {
+            snprintf(job->move, sizeof(job->move), "%s", value);
+        } else if (strcmp(field, "depth") == 0) {
+            job->depth = atoi(value);
+        } else if (strcmp(field, "multipv") == 0) {
+            job->multipv = atoi(value);
+        } else if (strcmp(field, "nodes") == 0) {
+            job->nodes = strtoull(value, NULL, 10);
+        } else if (strcmp(field, "deadline_ms") == 0) {
+            job->deadline_ns = job->received_ns + strtoull(value, NULL, 10) * 1000000ull;
+        } else {
+            *reason = "unknown_field";
+            return false;
+        }
+    }
+
+    if (job->depth < 1 || job->depth > MAX_DEPTH) {
+        *reason = "bad_depth";
+        return false;
+    }
+
+    if (job->multipv < 1 || job->multipv > ENGINE_MAX_LINES) {
+        *reason = "bad_multipv";
+        return false;
+    }
+
+    if (job->type == JobValidate && job->move[0] == '\0') {
+        *reason = "missing_move";
+        return false;
+    }
+
+    return true;
+}
+
+static void handle_line(Client *client, char *line) {
+    char *fields = strchr(line, ' ');
+
+    if (fields != NULL) {
+        *fields++ = '\0';
+    } else {
+        fields = "";
+    }
+
+    // the id is needed before anything else to answer errors
+    char id[32] = "none";
+    char *id_field = strstr(fields, "id=");
+
+    if (id_field != NULL && (id_field == fields || id_field[-1] == ';')) {
+        size_t len = strcspn(id_field + 3, ";");
+        snprintf(id, sizeof(id), "%.*s", (int)(len < sizeof(id) ? len : sizeof(id) - 1), id_field + 3);
+    }
+
+    if (strcmp(line, "cancel") == 0) {
+        queue_cancel(client->gen, id);
+        return;
+    }
+
+    enum JobType type;
+
+    if (strcmp(line, "analyze") == 0) {
+        type = JobAnalyze;
+    } else if (strcmp(line, "validate") == 0) {
+        type = JobValidate;
+    } else {
+        respond_status(client->fd, client->gen, id, "error", "unknown_command");
+        return;
+    }
+
+    Job *job = queue_job_alloc();
+
+    if (job == NULL) {
+        respond_status(client->fd, client->gen, id, "busy", NULL);
+        return;
+    }
+
+    job->type = type;
+    job->fd = client->fd;
+    job->client_gen = client->gen;
+    job->received_ns = Engine_now_ns();
+    atomic_store(&job->cancel, false);
+    snprintf(job->id, sizeof(job->id), "%s", id);
+
+    const char *reason = NULL;
+
+    if (!parse_job(fields, job, &reason)) {
+        respond_status(client->fd, client->gen, id, "error", reason);
+        queue_job_free(job);
+        return;
+    }
+
+    queue_push(job);
+}
+
+static void close_client(int epoll_fd, Client *client) {
+    queue_cancel(client->gen, NULL);
+
+    pthread_mutex_lock(&clients_lock);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    client->len = 0;
+    pthread_mutex_unlock(&clients_lock);
+}
+
+static void read_client(int epoll_fd, Client *client) {
+    for (;;) {
+        ssize_t n = read(client->fd, client->buf + client->len, sizeof(client->buf) - client->len);
+
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            close_client(epoll_fd, client);
+            return;
+        }
+
+        if (n < 0) {
+            return;
+        }
+
+        client->len += n;
+
+        char *start = client->buf;
+        char *newline;
+
+        while ((newline = memchr(start, '\n', client->len - (start - client->buf))) != NULL) {
+            *newline = '\0';
+
+            if (newline > start && newline[-1] == '\r') {
+                newline[-1] = '\0';
+            }
+
+            handle_line(client, start);
+            start = newline + 1;
+        }
+
+        client->len -= start - client->buf;
+        memmove(client->buf, start, client->len);
+
+        if (client->len == sizeof(client->buf)) {
+            // no newline in a full buffer
+            respond_status(client->fd, client->gen, "none", "error", "line_too_long");
+            close_client(epoll_fd, client);
+            return;
+        }
+    }
+}
+
+static int listen_on(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0) {
+        perror("bind");
+        exit(1);
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    return fd;
+}
+
+static void accept_clients(int epoll_fd, int listen_fd) {
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        if (fd >= MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        pthread_mutex_lock(&clients_lock);
+        clients[fd] = (Client){.fd = fd, .gen = next_client_gen++};
+        pthread_mutex_unlock(&clients_lock);
+
+        struct epoll_event event = {.events = EPOLLIN | EPOLLRDHUP, .data.fd = fd};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = "/tmp/chess-analysis.sock";
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int queue_capacity = 256;
+    int hash_mb = 64;
+    const char *cache_path = NULL;
+    int cache_mb = 256;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--socket") == 0) {
+            socket_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--workers") == 0) {
+            num_workers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--queue") == 0) {
+            queue_capacity = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--hash") == 0) {
+            hash_mb = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--nnue") == 0) {
+            if (!NNUE_load(argv[i + 1])) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            cache_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--cache-mb") == 0) {
+            cache_mb = atoi(argv[i + 1]);
+        } else {
+            printf("Usage: %s [--socket <path>] [--workers <n>] [--queue <n>] [--hash <mb>] [--nnue <file>] [--stats <file>] [--cache <file>] "
+                   "[--cache-mb <mb>]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    if (num_workers < 1 || queue_capacity < 1) {
+        printf("Need at least one worker and a queue capacity of at least one\n");
+        return 1;
+    }
+
+    if (hash_mb < 1) {
+        printf("The hash table needs at least 1 MB\n");
+        return 1;
+    }
+
+    hash_table = HashTable_new(hash_mb);
+
+    if (cache_path != NULL) {
+        analysis_cache = AnalysisCache_new(cache_path, cache_mb);
+
+        if (analysis_cache == NULL) {
+            return 1;
+        }
+    }
+
+    struct sigaction sa = {.sa_handler = handle_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    queue_init(queue_capacity, num_workers);
+
+    pthread_t *workers = calloc(num_workers, sizeof(pthread_t));
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_create(&workers[i], NULL, worker, (void *)(intptr_t)i);
+    }
+
+    int listen_fd = listen_on(socket_path);
+    int epoll_fd = epoll_create1(0);
+
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = listen_fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+    printf("Listening on %s with %d workers, queue capacity %d\n", socket_path, num_workers, queue_capacity);
+
+    struct epoll_event events[MAX_EVENTS];
+
+    while (running) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listen_fd) {
+                accept_clients(epoll_fd, listen_fd);
+            } else if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                read_client(epoll_fd, &clients[fd]);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    queue.shutdown = true;
+
+    for (int i = 0; i < queue.count; i++) {
+        atomic_store(&queue.ring[(queue.head + i) % queue.capacity]->cancel, true);
+    }
+
+    for (int i = 0; i < queue.num_workers; i++) {
+        if (queue.running[i] != NULL) {
+            atomic_store(&queue.running[i]->cancel, true);
+        }
+    }
+
+    pthread_cond_broadcast(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    close(listen_fd);
+    close(epoll_fd);
+    unlink(socket_path);
+    free(workers);
+    HashTable_free(hash_table);
+    AnalysisCache_free(analysis_cache);
+
+    return 0;
+}
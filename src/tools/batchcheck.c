@@ -0,0 +1,120 @@
+// Compares the batch kernel (Batch_analyze, chess/batch.h) with the move generator of the core on
+// positions of random games: the legal move count against Game_legal_moves, in_check against
+// Engine_in_check and the attack sets against Chess_is_square_attacked, square by square.
+//
+//   ./bin/batchcheck --positions 100000 --seed 1
+//
+// Prints the FEN of the first few positions that differ, exits with 1 when any does.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../chess/batch.h"
+#include "../engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// longest random game, the positions are sampled from all of its plies
+#define MAX_GAME_PLIES 200
+#define MAX_REPORTED 10
+
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Attack set of `by` over the Position squares, from the core
+static uint64_t core_attacks(const Chess *chess, enum Color by) {
+    uint64_t attacks = 0;
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            Pos pos = {row, col};
+
+            if (Chess_is_square_attacked(chess, pos, by)) {
+                attacks |= 1ull << relative_square(chess, ColorWhite, pos);
+            }
+        }
+    }
+
+    return attacks;
+}
+
+static bool check_position(Game *game, int *differ) {
+    Position position;
+    BatchInfo info;
+    Move moves[ENGINE_MAX_MOVES];
+
+    Game_to_position(game, &position);
+    Batch_analyze(&position, 1, &info);
+
+    int legal = Game_legal_moves(game, moves);
+    bool in_check = Engine_in_check(&game->chess, game->chess.current_turn);
+    uint64_t attacks[2];
+
+    attacks[ColorWhite] = core_attacks(&game->chess, ColorWhite);
+    attacks[ColorBlack] = core_attacks(&game->chess, ColorBlack);
+
+    if (info.legal_moves == legal && info.in_check == in_check && info.attacks[ColorWhite] == attacks[ColorWhite] &&
+        info.attacks[ColorBlack] == attacks[ColorBlack]) {
+        return true;
+    }
+
+    if ((*differ)++ < MAX_REPORTED) {
+        char fen[128];
+        Game_to_fen(game, fen);
+        printf("%s: legal moves %d / %d, check %d / %d, attacks %s (batch / core)\n", fen, info.legal_moves, legal, info.in_check, in_check,
+               info.attacks[ColorWhite] == attacks[ColorWhite] && info.attacks[ColorBlack] == attacks[ColorBlack] ? "equal" : "differ");
+    }
+
+    return false;
+}
+
+int main(int argc, char **argv) {
+    long num_positions = 100000;
+    uint64_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--positions") == 0) {
+            num_positions = atol(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            printf("Usage: %s [--positions <n>] [--seed <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    uint64_t state = seed * 0x9E3779B97F4A7C15ull | 1;
+    Game *game = Game_new();
+    Move moves[ENGINE_MAX_MOVES];
+    long checked = 0, games = 0;
+    int differ = 0;
+
+    while (checked < num_positions) {
+        Game_reset(game);
+        games++;
+
+        for (int ply = 0; ply < MAX_GAME_PLIES && checked < num_positions; ply++) {
+            check_position(game, &differ);
+            checked++;
+
+            int n = Game_legal_moves(game, moves);
+
+            enum GameEndReason reason;
+
+            if (n == 0 || Game_result(game, &reason) != GameOngoing) {
+                break;
+            }
+
+            Game_play_move(game, moves[next_random(&state) % n]);
+        }
+    }
+
+    printf("%ld positions of %ld games, %d differ\n", checked, games, differ);
+    Game_free(game);
+
+    return differ != 0;
+}
@@ -0,0 +1,442 @@
+// Micro-benchmarks for the rules core over a fixed corpus of positions. Reports the median ns/op
+// of the repetitions with a 95% confidence interval and optionally compares against a stored baseline.
+//
+//   ./bin/bench                                   run everything
+//   ./bin/bench --filter make_move --reps 30      only benchmarks whose name contains make_move
+//   ./bin/bench --json bench/baseline.json        store the results as the new baseline
+//   ./bin/bench --baseline bench/baseline.json    exits with 1 if something got slower than
+//                                                 --threshold percent (default 10)
+//
+// Numbers are only comparable on the same machine and build flags, record a baseline on the
+// machine that runs the comparison (before the change) and keep it quiet while measuring.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../chess/batch.h"
+#include "../chess/packed.h"
+#include "../engine/engine.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_BENCHMARKS 32
+#define WARMUP_REPS 3
+// minimum duration of one repetition, the number of ops per repetition is calibrated to it
+#define MIN_REP_NS 5000000.0
+
+// clang-format off
+static const char *Corpus[] = {
+    // openings
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5",
+    // middlegames
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "2rq1rk1/pb1nbppp/1p2pn2/3p4/2PP4/1PNBPN2/PB3PPP/2RQ1RK1 b - - 0 12",
+    // endgames
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/5pk1/6p1/1r6/4R3/6P1/5PK1/8 b - - 0 40",
+};
+// clang-format on
+
+#define CORPUS_SIZE ((int)(sizeof(Corpus) / sizeof(Corpus[0])))
+
+// Each corpus position, loaded with moves calculated, and a legal move to play from it
+static Chess positions[CORPUS_SIZE];
+static Move corpus_moves[CORPUS_SIZE];
+static Chess scratch;
+// only ever holds the initial position, so Chess_init_board always does the same work
+static Chess initial;
+static Arena bench_arena;
+static PositionBlock blocks[(CORPUS_SIZE + CHESS_BATCH_WIDTH - 1) / CHESS_BATCH_WIDTH];
+static Position corpus_positions[CORPUS_SIZE];
+static PackedPosition packed[CORPUS_SIZE];
+
+// keeps the compiler from dropping the benchmarked calls
+static volatile uintptr_t sink;
+
+struct Benchmark {
+    const char *name;
+    // prepares op i, not timed, may be NULL. Ops with a setup are timed one by one.
+    void (*setup)(int i);
+    void (*run)(int i);
+};
+
+struct Result {
+    char name[64];
+    double median, ci95;
+    int reps;
+};
+
+static void run_init_board(int i) {
+    (void)i;
+    Chess_init_board(&initial);
+    sink = initial.hash;
+}
+
+static void setup_copy(int i) { Chess_copy(&scratch, &positions[i % CORPUS_SIZE]); }
+
+static void run_calculate_moves(int i) {
+    (void)i;
+    Chess_calculate_moves(&scratch);
+    sink = scratch.arena.allocated_bytes;
+}
+
+static void run_make_move(int i) {
+    Move move = corpus_moves[i % CORPUS_SIZE];
+    sink = Chess_make_move(&scratch, &scratch.board[move.from.row][move.from.col].piece, move.to);
+}
+
+// Generates the moves of every piece of one type, the move lists were allocated by setup_copy
+static void run_type(enum PieceType type, void (*calculate)(Chess *, Piece *, int)) {
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            Piece *piece = &scratch.board[row][col].piece;
+
+            if (piece->type == type) {
+                calculate(&scratch, piece, 0);
+                sink = piece->num_moves;
+            }
+        }
+    }
+}
+
+static void run_king_moves(int i) { (void)i, run_type(King, Chess_calculate_king_moves); }
+static void run_knight_moves(int i) { (void)i, run_type(Knight, Chess_calculate_knight_moves); }
+static void run_rook_moves(int i) { (void)i, run_type(Rook, Chess_calculate_rook_moves); }
+static void run_bishop_moves(int i) { (void)i, run_type(Bishop, Chess_calculate_bishop_moves); }
+static void run_pawn_moves(int i) { (void)i, run_type(Pawn, Chess_calculate_pawn_moves); }
+
+static void run_find_piece(int i) {
+    Chess *game = &positions[i % CORPUS_SIZE];
+    sink = (uintptr_t)Chess_find_piece(game, King, i & 1 ? ColorWhite : ColorBlack);
+}
+
+static void run_arena_alloc(int i) {
+    if (i % 1024 == 0) {
+        arena_reset(&bench_arena);
+    }
+
+    sink = (uintptr_t)arena_alloc(&bench_arena, sizeof(Pos) * 64);
+}
+
+static void run_copy(int i) {
+    Chess_copy(&scratch, &positions[i % CORPUS_SIZE]);
+    sink = scratch.hash;
+}
+
+static void run_batch_block(int i) {
+    BatchInfo out[CHESS_BATCH_WIDTH];
+    Batch_analyze_block(&blocks[i % (int)(sizeof(blocks) / sizeof(blocks[0]))], out);
+    sink = out[0].legal_moves;
+}
+
+static void run_pack(int i) {
+    PackedPosition out;
+    PackedPosition_pack(&out, &corpus_positions[i % CORPUS_SIZE]);
+    sink = out.occupied;
+}
+
+static void run_unpack(int i) {
+    Position out;
+    PackedPosition_unpack(&out, &packed[i % CORPUS_SIZE]);
+    sink = out.hash;
+}
+
+// clang-format off
+static const struct Benchmark Benchmarks[] = {
+    {"Chess_init_board",            NULL,       run_init_board},
+    {"Chess_calculate_moves",       setup_copy, run_calculate_moves},
+    {"Chess_calculate_king_moves",  setup_copy, run_king_moves},
+    {"Chess_calculate_knight_moves",setup_copy, run_knight_moves},
+    {"Chess_calculate_rook_moves",  setup_copy, run_rook_moves},
+    {"Chess_calculate_bishop_moves",setup_copy, run_bishop_moves},
+    {"Chess_calculate_pawn_moves",  setup_copy, run_pawn_moves},
+    {"Chess_make_move",             setup_copy, run_make_move},
+    {"Chess_find_piece",            NULL,       run_find_piece},
+    {"Chess_copy",                  NULL,       run_copy},
+    {"arena_alloc",                 NULL,       run_arena_alloc},
+    {"Batch_analyze_block",         NULL,       run_batch_block},
+    {"PackedPosition_pack",         NULL,       run_pack},
+    {"PackedPosition_unpack",       NULL,       run_unpack},
+};
+// clang-format on
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// cost of one now_ns() pair, subtracted from ops that are timed one by one
+static double timer_overhead_ns(void) {
+    double best = 1e9;
+
+    for (int i = 0; i < 1000; i++) {
+        double start = now_ns();
+        double end = now_ns();
+
+        if (end - start < best) {
+            best = end - start;
+        }
+    }
+
+    return best;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// ns/op of one repetition of n ops
+static double measure(const struct Benchmark *bench, int n, double overhead) {
+    if (bench->setup == NULL) {
+        double start = now_ns();
+
+        for (int i = 0; i < n; i++) {
+            bench->run(i);
+        }
+
+        return (now_ns() - start) / n;
+    }
+
+    double total = 0;
+
+    for (int i = 0; i < n; i++) {
+        bench->setup(i);
+
+        double start = now_ns();
+        bench->run(i);
+        total += now_ns() - start - overhead;
+    }
+
+    return total / n;
+}
+
+static struct Result run_benchmark(const struct Benchmark *bench, int reps, double overhead) {
+    // calibrate the ops per repetition during warmup
+    int n = CORPUS_SIZE;
+
+    for (int i = 0; i < WARMUP_REPS; i++) {
+        while (measure(bench, n, overhead) * n < MIN_REP_NS / 4) {
+            n *= 2;
+        }
+    }
+
+    while (measure(bench, n, overhead) * n < MIN_REP_NS) {
+        n *= 2;
+    }
+
+    double samples[256];
+
+    for (int i = 0; i < reps; i++) {
+        samples[i] = measure(bench, n, overhead);
+    }
+
+    // Median, with a distribution free 95% confidence interval from the order statistics
+    // (normal approximation of the binomial), so a few disturbed repetitions don't move it
+    qsort(samples, reps, sizeof(double), compare_doubles);
+
+    int spread = (int)ceil(0.98 * sqrt(reps));
+    int low = reps / 2 - spread < 0 ? 0 : reps / 2 - spread;
+    int high = (reps - 1) / 2 + spread >= reps ? reps - 1 : (reps - 1) / 2 + spread;
+    double median = (samples[reps / 2] + samples[(reps - 1) / 2]) / 2;
+
+    struct Result result = {.median = median, .ci95 = (samples[high] - samples[low]) / 2, .reps = reps};
+    snprintf(result.name, sizeof(result.name), "%s", bench->name);
+
+    return result;
+}
+
+static bool write_json(const char *path, const struct Result *results, int count) {
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "{\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n");
+
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"ci95\": %.2f, \"reps\": %d}%s\n", results[i].name, results[i].median, results[i].ci95,
+                results[i].reps, i + 1 < count ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+
+    return true;
+}
+
+// Reads the files written by write_json, one benchmark per line
+static int read_json(const char *path, struct Result *results) {
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        printf("Failed to open %s\n", path);
+        return -1;
+    }
+
+    char line[512];
+    int count = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL && count < MAX_BENCHMARKS) {
+        struct Result *result = &results[count];
+
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"ns_per_op\": %lf, \"ci95\": %lf", result->name, &result->median, &result->ci95) == 3) {
+            count++;
+        }
+    }
+
+    fclose(f);
+
+    return count;
+}
+
+static void load_corpus(void) {
+    Game *game = Game_new();
+
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        Engine_init_chess(&positions[i]);
+
+        if (!Game_load_fen(game, Corpus[i])) {
+            printf("Bad corpus position %s\n", Corpus[i]);
+            exit(1);
+        }
+
+        Chess_copy(&positions[i], &game->chess);
+
+        Move moves[ENGINE_MAX_MOVES];
+
+        if (Game_legal_moves(game, moves) == 0) {
+            printf("No legal move in corpus position %s\n", Corpus[i]);
+            exit(1);
+        }
+
+        corpus_moves[i] = moves[0];
+    }
+
+    Game_free(game);
+
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        Position_from_chess(&corpus_positions[i], &positions[i]);
+    }
+
+    for (int i = 0; i < CORPUS_SIZE; i += CHESS_BATCH_WIDTH) {
+        int n = CORPUS_SIZE - i < CHESS_BATCH_WIDTH ? CORPUS_SIZE - i : CHESS_BATCH_WIDTH;
+        Batch_load_block(&blocks[i / CHESS_BATCH_WIDTH], corpus_positions + i, n);
+    }
+
+    PackedPosition_pack_batch(packed, corpus_positions, CORPUS_SIZE);
+
+    Engine_init_chess(&scratch);
+    Engine_init_chess(&initial);
+    bench_arena = arena_init(sizeof(Pos) * 64 * 1024);
+}
+
+static void usage(const char *program) {
+    printf("Usage: %s [--filter substring] [--reps n] [--json out.json] [--baseline baseline.json] [--threshold percent]\n", program);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = NULL;
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold = 10.0;
+    int reps = 20;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        i++;
+
+        if (strcmp(arg, "--filter") == 0) {
+            filter = value;
+        } else if (strcmp(arg, "--reps") == 0) {
+            reps = atoi(value);
+        } else if (strcmp(arg, "--json") == 0) {
+            json_path = value;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            baseline_path = value;
+        } else if (strcmp(arg, "--threshold") == 0) {
+            threshold = atof(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (reps < 2 || reps > 256) {
+        printf("--reps has to be between 2 and 256\n");
+        return 1;
+    }
+
+    struct Result baseline[MAX_BENCHMARKS];
+    int baseline_count = 0;
+
+    if (baseline_path != NULL && (baseline_count = read_json(baseline_path, baseline)) < 0) {
+        return 1;
+    }
+
+    load_corpus();
+
+    double overhead = timer_overhead_ns();
+
+    struct Result results[MAX_BENCHMARKS];
+    int count = 0;
+    int regressions = 0;
+
+    printf("%-30s %12s %10s %10s\n", "benchmark", "ns/op", "+-95%", baseline_count ? "vs base" : "");
+
+    for (int i = 0; i < (int)(sizeof(Benchmarks) / sizeof(Benchmarks[0])); i++) {
+        if (filter != NULL && strstr(Benchmarks[i].name, filter) == NULL) {
+            continue;
+        }
+
+        struct Result *result = &results[count++];
+        *result = run_benchmark(&Benchmarks[i], reps, overhead);
+
+        printf("%-30s %12.1f %10.1f", result->name, result->median, result->ci95);
+
+        for (int j = 0; j < baseline_count; j++) {
+            if (strcmp(baseline[j].name, result->name) != 0) {
+                continue;
+            }
+
+            double change = (result->median - baseline[j].median) / baseline[j].median * 100.0;
+            // only flagged when the difference is bigger than the noise of both runs
+            bool regressed = change > threshold && result->median - baseline[j].median > result->ci95 + baseline[j].ci95;
+
+            printf(" %+9.1f%%%s", change, regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+        }
+
+        printf("\n");
+    }
+
+    if (json_path != NULL && !write_json(json_path, results, count)) {
+        return 1;
+    }
+
+    if (regressions) {
+        printf("%d benchmark(s) regressed by more than %.1f%%\n", regressions, threshold);
+        return 1;
+    }
+
+    return 0;
+}
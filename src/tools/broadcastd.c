@@ -0,0 +1,662 @@
+// Live game fan-out to spectators over a Unix domain socket and/or TCP on localhost.
+//
+//   ./bin/broadcastd --socket /tmp/chess-broadcast.sock --port 7070 --ring 64 --keyframe 32
+//
+// Every connection starts with one text line:
+//
+//   publish <game> [<fen>]     the connection now sends moves for <game>, one per line, e2e4,
+//                              and "end <result>" when it's over. Illegal moves are answered
+//                              with "error illegal_move <move>", nothing else is answered
+//   watch <game>               the connection now receives <game>'s frames
+//
+// Spectators get a binary stream of frames:
+//
+//   'K' ply:u16le len:u8 fen[len]    keyframe, the position after ply plies
+//   'M' move:u16le                   a move from the last position, from | to << 6 with squares
+//                                    from white's point of view (0 = a8 ... 63 = h1)
+//   'E' len:u8 result[len]           the game is over
+//
+// A watcher starts at the latest keyframe. Every game has one ring of frames that all of its
+// watchers are sent from directly, a move is encoded once whatever the number of watchers, and
+// the watchers of a game are flushed once per event loop round however many moves came in. A
+// watcher that falls a whole ring behind is disconnected, keyframes come at least every
+// --keyframe moves (and before the ring could lose the last one) so it can reconnect and resync.
+//
+// Thousands of watchers need a raised file descriptor limit (ulimit -n).
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS 16384
+#define MAX_GAMES 256
+#define MAX_EVENTS 256
+#define MAX_LINE 256
+#define MAX_NAME 32
+
+// 'K' ply len fen
+#define KEYFRAME_MAX (4 + 128)
+
+#define STARTPOS_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+enum ClientRole { RoleNone, RolePublisher, RoleWatcher };
+
+struct _Client {
+    int fd;
+    enum ClientRole role;
+    int game;
+
+    // watchers: ring offset of the next byte to send, and whether the socket buffer is full
+    uint64_t pos;
+    bool blocked;
+    // the game's watchers are a list through the fds
+    int prev, next;
+
+    char buf[MAX_LINE];
+    int len;
+};
+typedef struct _Client Client;
+
+struct _Broadcast {
+    char name[MAX_NAME];
+    Game *game;
+    int publisher;
+
+    // head only grows, a byte at offset o lives at ring[o & ring_mask] until head passes o + size
+    uint8_t *ring;
+    uint64_t head;
+    uint64_t keyframe;
+    int since_keyframe;
+
+    int first_watcher;
+    int num_watchers;
+
+    bool dirty;
+};
+typedef struct _Broadcast Broadcast;
+
+struct _Stats {
+    uint64_t moves;
+    uint64_t frames_bytes;
+    uint64_t sent_bytes;
+    uint64_t flushes;
+    uint64_t flush_ns;
+    uint64_t evicted;
+};
+typedef struct _Stats Stats;
+
+static volatile sig_atomic_t running = 1;
+
+static Client clients[MAX_CLIENTS];
+static Broadcast games[MAX_GAMES];
+static int num_games;
+
+static int dirty[MAX_GAMES];
+static int num_dirty;
+
+static size_t ring_size = 64 * 1024;
+static int keyframe_interval = 32;
+static Stats stats;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static void ring_write(Broadcast *b, const void *data, size_t len) {
+    size_t offset = b->head & (ring_size - 1);
+    size_t first = len < ring_size - offset ? len : ring_size - offset;
+
+    memcpy(b->ring + offset, data, first);
+    memcpy(b->ring, (const uint8_t *)data + first, len - first);
+
+    b->head += len;
+    stats.frames_bytes += len;
+
+    if (!b->dirty && b->num_watchers > 0) {
+        b->dirty = true;
+        dirty[num_dirty++] = (int)(b - games);
+    }
+}
+
+static void write_keyframe(Broadcast *b) {
+    uint8_t frame[KEYFRAME_MAX];
+    char fen[128];
+
+    Game_to_fen(b->game, fen);
+
+    size_t len = strlen(fen);
+    frame[0] = 'K';
+    frame[1] = b->game->ply & 0xff;
+    frame[2] = b->game->ply >> 8;
+    frame[3] = (uint8_t)len;
+    memcpy(frame + 4, fen, len);
+
+    b->keyframe = b->head;
+    b->since_keyframe = 0;
+    ring_write(b, frame, 4 + len);
+}
+
+static void write_move(Broadcast *b, uint16_t move) {
+    uint8_t frame[3] = {'M', move & 0xff, move >> 8};
+    ring_write(b, frame, sizeof(frame));
+
+    // new watchers start at the last keyframe, it must never be overwritten
+    if (++b->since_keyframe >= keyframe_interval || b->head - b->keyframe + sizeof(frame) + KEYFRAME_MAX > ring_size / 2) {
+        write_keyframe(b);
+    }
+}
+
+static void write_end(Broadcast *b, const char *result) {
+    uint8_t frame[2 + MAX_LINE];
+    size_t len = strlen(result);
+
+    frame[0] = 'E';
+    frame[1] = (uint8_t)len;
+    memcpy(frame + 2, result, len);
+    ring_write(b, frame, 2 + len);
+}
+
+static int find_game(const char *name, bool create) {
+    for (int i = 0; i < num_games; i++) {
+        if (strcmp(games[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    if (!create || num_games == MAX_GAMES) {
+        return -1;
+    }
+
+    Broadcast *b = &games[num_games];
+    *b = (Broadcast){.publisher = -1, .first_watcher = -1, .game = Game_new(), .ring = malloc(ring_size)};
+
+    if (b->ring == NULL) {
+        printf("Failed to allocate a %zu KB ring\n", ring_size / 1024);
+        exit(1);
+    }
+
+    snprintf(b->name, sizeof(b->name), "%s", name);
+
+    return num_games++;
+}
+
+static void respond(Client *client, const char *line) {
+    // publishers are the only ones answered and only on errors, a full socket drops the answer
+    if (write(client->fd, line, strlen(line)) < 0) {
+        return;
+    }
+}
+
+static void close_client(int epoll_fd, Client *client) {
+    if (client->role == RoleWatcher) {
+        Broadcast *b = &games[client->game];
+
+        if (client->prev >= 0) {
+            clients[client->prev].next = client->next;
+        } else {
+            b->first_watcher = client->next;
+        }
+
+        if (client->next >= 0) {
+            clients[client->next].prev = client->prev;
+        }
+
+        b->num_watchers--;
+    } else if (client->role == RolePublisher) {
+        games[client->game].publisher = -1;
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    client->role = RoleNone;
+    client->len = 0;
+}
+
+// Sends everything the watcher hasn't got yet straight from the ring, false if it was evicted
+static bool flush_watcher(int epoll_fd, Client *client) {
+    const Broadcast *b = &games[client->game];
+
+    while (client->pos < b->head) {
+        if (b->head - client->pos > ring_size) {
+            stats.evicted++;
+            close_client(epoll_fd, client);
+            return false;
+        }
+
+        size_t offset = client->pos & (ring_size - 1);
+        size_t len = b->head - client->pos;
+
+        if (len > ring_size - offset) {
+            len = ring_size - offset;
+        }
+
+        ssize_t n = write(client->fd, b->ring + offset, len);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!client->blocked) {
+                client->blocked = true;
+                struct epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP, .data.fd = client->fd};
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+            }
+
+            return true;
+        }
+
+        if (n < 0) {
+            close_client(epoll_fd, client);
+            return false;
+        }
+
+        client->pos += n;
+        stats.sent_bytes += n;
+    }
+
+    if (client->blocked) {
+        client->blocked = false;
+        struct epoll_event event = {.events = EPOLLIN | EPOLLRDHUP, .data.fd = client->fd};
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+    }
+
+    return true;
+}
+
+static void flush_dirty(int epoll_fd) {
+    uint64_t start = Engine_now_ns();
+
+    for (int i = 0; i < num_dirty; i++) {
+        Broadcast *b = &games[dirty[i]];
+        b->dirty = false;
+
+        for (int fd = b->first_watcher; fd >= 0;) {
+            int next = clients[fd].next;
+
+            // blocked watchers continue on EPOLLOUT, unless they already lost data
+            if (!clients[fd].blocked || b->head - clients[fd].pos > ring_size) {
+                flush_watcher(epoll_fd, &clients[fd]);
+                stats.flushes++;
+            }
+
+            fd = next;
+        }
+    }
+
+    if (num_dirty > 0) {
+        stats.flush_ns += Engine_now_ns() - start;
+    }
+
+    num_dirty = 0;
+}
+
+static void start_publishing(Client *client, char *args) {
+    char *name = strtok(args, " ");
+    char *fen = name != NULL ? strtok(NULL, "") : NULL;
+
+    if (name == NULL || strlen(name) >= MAX_NAME) {
+        respond(client, "error bad_game\n");
+        return;
+    }
+
+    int index = find_game(name, true);
+
+    if (index < 0) {
+        respond(client, "error too_many_games\n");
+        return;
+    }
+
+    Broadcast *b = &games[index];
+
+    if (b->publisher >= 0) {
+        respond(client, "error already_published\n");
+        return;
+    }
+
+    if (!Game_load_fen(b->game, fen != NULL ? fen : STARTPOS_FEN)) {
+        respond(client, "error bad_fen\n");
+        return;
+    }
+
+    b->publisher = client->fd;
+    client->role = RolePublisher;
+    client->game = index;
+
+    write_keyframe(b);
+}
+
+static void start_watching(Client *client, const char *name) {
+    int index = find_game(name, strlen(name) < MAX_NAME);
+
+    if (index < 0) {
+        respond(client, "error bad_game\n");
+        return;
+    }
+
+    Broadcast *b = &games[index];
+
+    client->role = RoleWatcher;
+    client->game = index;
+    // a game nobody published yet has no keyframe, the watcher starts with its first one
+    client->pos = b->head > 0 ? b->keyframe : 0;
+    client->prev = -1;
+    client->next = b->first_watcher;
+
+    if (b->first_watcher >= 0) {
+        clients[b->first_watcher].prev = client->fd;
+    }
+
+    b->first_watcher = client->fd;
+    b->num_watchers++;
+
+    if (client->pos < b->head && !b->dirty) {
+        b->dirty = true;
+        dirty[num_dirty++] = index;
+    }
+}
+
+static void handle_line(Client *client, char *line) {
+    if (client->role == RoleNone) {
+        if (strncmp(line, "publish ", 8) == 0) {
+            start_publishing(client, line + 8);
+        } else if (strncmp(line, "watch ", 6) == 0) {
+            start_watching(client, line + 6);
+        } else {
+            respond(client, "error unknown_command\n");
+        }
+
+        return;
+    }
+
+    if (client->role != RolePublisher) {
+        return;
+    }
+
+    Broadcast *b = &games[client->game];
+
+    if (strncmp(line, "end ", 4) == 0) {
+        write_end(b, line + 4);
+        return;
+    }
+
+    Move move;
+    char error[MAX_LINE + 32];
+
+    if (!Game_parse_uci(b->game, line, &move)) {
+        snprintf(error, sizeof(error), "error illegal_move %s\n", line);
+        respond(client, error);
+        return;
+    }
+
+    uint16_t encoded = PositionIndex_encode_move(&b->game->chess, move);
+
+    if (!Game_play_move(b->game, move)) {
+        snprintf(error, sizeof(error), "error illegal_move %s\n", line);
+        respond(client, error);
+        return;
+    }
+
+    stats.moves++;
+    write_move(b, encoded);
+}
+
+static void read_client(int epoll_fd, Client *client) {
+    for (;;) {
+        ssize_t n = read(client->fd, client->buf + client->len, sizeof(client->buf) - client->len);
+
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            close_client(epoll_fd, client);
+            return;
+        }
+
+        if (n < 0) {
+            return;
+        }
+
+        // watchers have nothing more to say
+        if (client->role == RoleWatcher) {
+            continue;
+        }
+
+        client->len += n;
+
+        char *start = client->buf;
+        char *newline;
+
+        while ((newline = memchr(start, '\n', client->len - (start - client->buf))) != NULL) {
+            *newline = '\0';
+
+            if (newline > start && newline[-1] == '\r') {
+                newline[-1] = '\0';
+            }
+
+            handle_line(client, start);
+            start = newline + 1;
+
+            if (client->role == RoleWatcher) {
+                client->len = 0;
+                return;
+            }
+        }
+
+        client->len -= start - client->buf;
+        memmove(client->buf, start, client->len);
+
+        if (client->len == sizeof(client->buf)) {
+            respond(client, "error line_too_long\n");
+            close_client(epoll_fd, client);
+            return;
+        }
+    }
+}
+
+static void set_nonblocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+static int listen_unix(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0) {
+        perror("bind");
+        exit(1);
+    }
+
+    set_nonblocking(fd);
+
+    return fd;
+}
+
+static int listen_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    // localhost only, there is no authentication
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0) {
+        perror("bind");
+        exit(1);
+    }
+
+    set_nonblocking(fd);
+
+    return fd;
+}
+
+static void accept_clients(int epoll_fd, int listen_fd, bool tcp) {
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        if (fd >= MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+
+        set_nonblocking(fd);
+
+        if (tcp) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        clients[fd] = (Client){.fd = fd, .prev = -1, .next = -1};
+
+        struct epoll_event event = {.events = EPOLLIN | EPOLLRDHUP, .data.fd = fd};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+static void print_stats(void) {
+    int watchers = 0;
+
+    for (int i = 0; i < num_games; i++) {
+        watchers += games[i].num_watchers;
+    }
+
+    printf("%d games, %d watchers, %lu moves, %lu frame bytes, %lu bytes sent, %lu evicted, %.2f us per watcher flush\n", num_games, watchers,
+           (unsigned long)stats.moves, (unsigned long)stats.frames_bytes, (unsigned long)stats.sent_bytes, (unsigned long)stats.evicted,
+           stats.flushes > 0 ? stats.flush_ns / 1000.0 / stats.flushes : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = "/tmp/chess-broadcast.sock";
+    int port = 0;
+    int stats_seconds = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--socket") == 0) {
+            socket_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--port") == 0) {
+            port = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--ring") == 0) {
+            ring_size = strtoull(argv[i + 1], NULL, 10) * 1024;
+        } else if (strcmp(argv[i], "--keyframe") == 0) {
+            keyframe_interval = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_seconds = atoi(argv[i + 1]);
+        } else {
+            printf("Usage: %s [--socket <path>] [--port <tcp port>] [--ring <kb>] [--keyframe <moves>] [--stats <seconds>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (ring_size < 4096 || (ring_size & (ring_size - 1)) != 0 || keyframe_interval < 1) {
+        printf("The ring has to be a power of two of at least 4 KB, keyframes at least every move\n");
+        return 1;
+    }
+
+    struct sigaction sa = {.sa_handler = handle_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    int epoll_fd = epoll_create1(0);
+    int unix_fd = listen_unix(socket_path);
+    int tcp_fd = port > 0 ? listen_tcp(port) : -1;
+
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = unix_fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, unix_fd, &event);
+
+    if (tcp_fd >= 0) {
+        event.data.fd = tcp_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, tcp_fd, &event);
+    }
+
+    printf("Listening on %s", socket_path);
+
+    if (tcp_fd >= 0) {
+        printf(" and 127.0.0.1:%d", port);
+    }
+
+    printf(", %zu KB ring per game, keyframe every %d moves\n", ring_size / 1024, keyframe_interval);
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t last_stats = Engine_now_ns();
+
+    while (running) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, stats_seconds > 0 ? 1000 : -1);
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == unix_fd || fd == tcp_fd) {
+                accept_clients(epoll_fd, fd, fd == tcp_fd);
+                continue;
+            }
+
+            Client *client = &clients[fd];
+
+            if ((events[i].events & EPOLLOUT) && client->role == RoleWatcher && !flush_watcher(epoll_fd, client)) {
+                continue;
+            }
+
+            if (client->fd >= 0 && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                read_client(epoll_fd, client);
+            }
+        }
+
+        flush_dirty(epoll_fd);
+
+        if (stats_seconds > 0 && Engine_now_ns() - last_stats >= (uint64_t)stats_seconds * 1000000000ull) {
+            print_stats();
+            last_stats = Engine_now_ns();
+        }
+    }
+
+    print_stats();
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            close(clients[i].fd);
+        }
+    }
+
+    for (int i = 0; i < num_games; i++) {
+        Game_free(games[i].game);
+        free(games[i].ring);
+    }
+
+    close(unix_fd);
+
+    if (tcp_fd >= 0) {
+        close(tcp_fd);
+    }
+
+    close(epoll_fd);
+    unlink(socket_path);
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+// Fills, inspects and maintains persistent analysis caches (AnalysisCache in engine/engine.h).
+//
+//   ./bin/cachetool analyze analysis.cache [--fen <fen>] [--moves <uci>...] [--depth <n>] [--hash <mb>]
+//   ./bin/cachetool probe analysis.cache [--fen <fen>] [--moves <uci>...]
+//   ./bin/cachetool info analysis.cache
+//   ./bin/cachetool merge analysis.cache other.cache ...
+//   ./bin/cachetool compact analysis.cache [--mb <n>] [--min-depth <n>]
+//
+// Any number of processes (analysisd --cache, engines with cache=<file>, cachetool analyze) can use
+// the same file at once, their results are merged as they are stored. merge adds files written
+// elsewhere, keeping the deeper result of a position. compact rewrites the file without damaged and
+// shallow entries, optionally at another size, and is meant to be run periodically while nothing
+// else has the file open.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// size of a cache created by analyze or merge
+#define DEFAULT_CACHE_MB 256
+
+struct _AnalyzeContext {
+    const Game *game;
+    uint64_t start;
+};
+typedef struct _AnalyzeContext AnalyzeContext;
+
+static void usage(const char *name) {
+    printf("Usage: %s analyze <cache> [--fen <fen>] [--moves <uci>...] [--depth <n>] [--hash <mb>]\n", name);
+    printf("       %s probe <cache> [--fen <fen>] [--moves <uci>...]\n", name);
+    printf("       %s info <cache>\n", name);
+    printf("       %s merge <cache> <other>...\n", name);
+    printf("       %s compact <cache> [--mb <n>] [--min-depth <n>]\n", name);
+}
+
+static const char *bound_name(enum HashBound bound) {
+    switch (bound) {
+    case HashBoundExact:
+        return "exact";
+    case HashBoundLower:
+        return "lower";
+    case HashBoundUpper:
+        return "upper";
+    default:
+        return "none";
+    }
+}
+
+// --fen, --moves and the options of the command (value taken, the rest rejected). False with a
+// message on a bad position or option
+static bool parse_args(Game *game, int argc, char **argv, int *depth, int *hash_mb) {
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            if (!Game_load_fen(game, argv[++i])) {
+                printf("Bad FEN: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--moves") == 0) {
+            for (; i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0; i++) {
+                Move move;
+
+                if (!Game_parse_uci(game, argv[i + 1], &move) || !Game_play_move(game, move)) {
+                    printf("Illegal move: %s\n", argv[i + 1]);
+                    return false;
+                }
+            }
+        } else if (strcmp(argv[i], "--depth") == 0 && depth != NULL && i + 1 < argc) {
+            *depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash") == 0 && hash_mb != NULL && i + 1 < argc) {
+            *hash_mb = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void print_iteration(const SearchResult *result, void *ctx) {
+    AnalyzeContext *analyze = ctx;
+    char move[6];
+
+    Game_move_to_uci(analyze->game, result->best_move, move);
+    printf("depth %2d score %6d nodes %10llu time %9.1f ms bestmove %s\n", result->depth, result->score, (unsigned long long)result->nodes,
+           (Engine_now_ns() - analyze->start) / 1e6, move);
+}
+
+// Searches the position with the cache, a second run shows how fast a warm restart gets back
+static int analyze(int argc, char **argv) {
+    Game *game = Game_new();
+    int depth = 8;
+    int hash_mb = 64;
+
+    if (!parse_args(game, argc, argv, &depth, &hash_mb)) {
+        return 1;
+    }
+
+    if (depth < 1 || depth >= ENGINE_MAX_PLY || hash_mb < 1) {
+        printf("Depth has to be between 1 and %d, the hash table at least 1 MB\n", ENGINE_MAX_PLY - 1);
+        return 1;
+    }
+
+    AnalysisCache *cache = AnalysisCache_new(argv[2], DEFAULT_CACHE_MB);
+
+    if (cache == NULL) {
+        return 1;
+    }
+
+    Engine *engine = Engine_new((EngineConfig){.name = "cachetool", .depth = depth, .hash_mb = hash_mb});
+    AnalyzeContext ctx = {.game = game, .start = Engine_now_ns()};
+
+    engine->cache = cache;
+    engine->on_iteration = print_iteration;
+    engine->callback_ctx = &ctx;
+
+    Engine_search(engine, &game->chess, game->history, game->ply);
+
+    uint64_t cache_hits = 0;
+
+    for (int i = 1; i <= engine->stats.max_depth; i++) {
+        cache_hits += engine->stats.depths[i].cache_hits;
+    }
+
+    printf("%.1f ms, %llu cache hits\n", (Engine_now_ns() - ctx.start) / 1e6, (unsigned long long)cache_hits);
+
+    Engine_free(engine);
+    AnalysisCache_free(cache);
+    Game_free(game);
+
+    return 0;
+}
+
+static int probe(int argc, char **argv) {
+    Game *game = Game_new();
+
+    if (!parse_args(game, argc, argv, NULL, NULL)) {
+        return 1;
+    }
+
+    // an existing file only, probing doesn't create one
+    AnalysisCache *cache = AnalysisCache_new(argv[2], 0);
+    AnalysisCacheInfo info;
+
+    if (cache == NULL || !AnalysisCache_info(cache, &info)) {
+        return 1;
+    }
+
+    HashHit hit;
+
+    if (!AnalysisCache_probe(cache, &game->chess, &hit)) {
+        printf("Not in the cache\n");
+    } else {
+        char move[6] = "-";
+
+        if (hit.has_move) {
+            Game_move_to_uci(game, hit.move, move);
+        }
+
+        printf("depth %d score %d bound %s bestmove %s\n", hit.depth, hit.score, bound_name(hit.bound), move);
+    }
+
+    AnalysisCache_free(cache);
+    Game_free(game);
+
+    return 0;
+}
+
+static int info(const char *path) {
+    AnalysisCache *cache = AnalysisCache_new(path, 0);
+    AnalysisCacheInfo info;
+
+    if (cache == NULL || !AnalysisCache_info(cache, &info)) {
+        return 1;
+    }
+
+    printf("%llu of %llu entries used (%.1f%%), %llu damaged\n", (unsigned long long)info.used, (unsigned long long)info.capacity,
+           100.0 * info.used / info.capacity, (unsigned long long)info.corrupt);
+
+    for (int depth = 0; depth < ENGINE_MAX_PLY; depth++) {
+        if (info.depths[depth] != 0) {
+            printf("  depth %2d: %llu\n", depth, (unsigned long long)info.depths[depth]);
+        }
+    }
+
+    AnalysisCache_free(cache);
+
+    return 0;
+}
+
+static int merge(int argc, char **argv) {
+    AnalysisCache *cache = AnalysisCache_new(argv[2], DEFAULT_CACHE_MB);
+
+    if (cache == NULL) {
+        return 1;
+    }
+
+    for (int i = 3; i < argc; i++) {
+        int64_t merged = AnalysisCache_merge(cache, argv[i]);
+
+        if (merged < 0) {
+            return 1;
+        }
+
+        printf("%s: %lld entries\n", argv[i], (long long)merged);
+    }
+
+    AnalysisCache_free(cache);
+
+    return 0;
+}
+
+static int compact(int argc, char **argv) {
+    int size_mb = 0;
+    int min_depth = ANALYSIS_CACHE_MIN_DEPTH;
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc) {
+            size_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-depth") == 0 && i + 1 < argc) {
+            min_depth = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (size_mb < 0) {
+        printf("The size can't be negative\n");
+        return 1;
+    }
+
+    if (!AnalysisCache_compact(argv[2], size_mb, min_depth)) {
+        return 1;
+    }
+
+    return info(argv[2]);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "analyze") == 0) {
+        return analyze(argc, argv);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "probe") == 0) {
+        return probe(argc, argv);
+    }
+
+    if (argc == 3 && strcmp(argv[1], "info") == 0) {
+        return info(argv[2]);
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "merge") == 0) {
+        return merge(argc, argv);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "compact") == 0) {
+        return compact(argc, argv);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,536 @@
+// Self-play training data generator. Every worker thread plays its own games with its own Engine
+// and Game (so its own Chess and arena), samples the quiet positions with their search score and
+// stamps them with the result once the game is over.
+//
+//   ./bin/datagen -e name=gen,depth=6,hash=16 --games 100000 --out data --shard-mb 256
+//
+// Output: data/shard-000001.bin, data/shard-000002.bin, ... each a header followed by records.
+//
+//   header  "CHESSDAT", uint32 version, uint32 record size (16 bytes)
+//   record  PackedPosition (32 bytes), int16 score in centipawns for the side to move,
+//           uint8 result for white (0 = loss, 1 = draw, 2 = win), uint8 0 (36 bytes)
+//
+// Integers are in host byte order. Workers hand full buffers to the writer thread through a ring of
+// their own, nothing on the write path takes a lock. The shard being written is named .part and
+// synced to disk every --flush-sec seconds. It is only renamed to .bin once it is full (or the run
+// ends) and synced, so a crash leaves every .bin complete and the .part readable up to its last
+// whole record. A new run continues after the highest existing shard number.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../chess/packed.h"
+#include "../engine/engine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DATAGEN_MAGIC "CHESSDAT"
+#define DATAGEN_VERSION 1
+#define HEADER_SIZE 16
+#define RECORD_SIZE 36
+
+#define RING_SIZE 4
+#define BUFFER_RECORDS 4096
+#define IDLE_SLEEP_NS 1000000
+
+struct _Sample {
+    PackedPosition position;
+    int16_t score;
+};
+typedef struct _Sample Sample;
+
+// Single producer (the worker), single consumer (the writer). head and tail only ever grow,
+// buffers[head % RING_SIZE] is the one being filled
+struct _Channel {
+    uint8_t buffers[RING_SIZE][BUFFER_RECORDS * RECORD_SIZE];
+    int counts[RING_SIZE];
+
+    _Alignas(64) atomic_uint_fast64_t head;
+    _Alignas(64) atomic_uint_fast64_t tail;
+    atomic_bool done;
+    atomic_uint_fast64_t games;
+};
+typedef struct _Channel Channel;
+
+struct _Generator {
+    EngineConfig engine;
+    int num_games;
+    int max_plies;
+    int random_plies;
+    uint64_t seed;
+
+    const char *out_dir;
+    uint64_t shard_bytes;
+    int flush_sec;
+
+    atomic_int next_game;
+
+    Channel *channels;
+    int num_workers;
+};
+typedef struct _Generator Generator;
+
+struct _Worker {
+    Generator *gen;
+    Channel *channel;
+    Sample samples[GAME_MAX_PLIES];
+};
+typedef struct _Worker Worker;
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void sleep_ns(long ns) {
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = ns};
+    nanosleep(&ts, NULL);
+}
+
+static inline bool is_capture(const Game *game, Move move) { return game->chess.board[move.to.row][move.to.col].piece.type != UndefPieceType; }
+
+// The core doesn't promote, a pawn on the first or last rank stands on a square it can't be in chess
+static bool has_back_rank_pawn(const Chess *chess) {
+    for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+        if (chess->board[0][col].piece.type == Pawn || chess->board[CHESS_BOARD_ROWS - 1][col].piece.type == Pawn) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Plays game idx, returns the number of samples. The random opening only depends on the seed and
+// idx, not on the thread that plays it. A game is dropped once a pawn reaches the last rank, what
+// follows isn't chess and its result would label the samples wrongly
+static int play_game(const Generator *gen, Engine *engine, Game *game, int idx, Sample *samples, enum GameResult *result) {
+    uint64_t rng = splitmix64(gen->seed ^ splitmix64((uint64_t)idx)) | 1;
+
+    Game_reset(game);
+
+    for (int i = 0; i < gen->random_plies; i++) {
+        Move moves[ENGINE_MAX_MOVES];
+        int n = Game_legal_moves(game, moves);
+
+        if (n == 0) {
+            // over before it started, nothing worth keeping
+            return 0;
+        }
+
+        Game_play_move(game, moves[next_random(&rng) % n]);
+
+        if (has_back_rank_pawn(&game->chess)) {
+            return 0;
+        }
+    }
+
+    int count = 0;
+    enum GameEndReason reason;
+
+    while ((*result = Game_result(game, &reason)) == GameOngoing && game->ply < gen->max_plies) {
+        SearchResult search = Engine_search(engine, &game->chess, game->history, game->ply + 1);
+
+        // only positions the evaluation can judge by itself: not in check, no capture pending,
+        // no mate on the board, no pawn on a back rank
+        bool quiet = !Engine_in_check(&game->chess, game->chess.current_turn) && !is_capture(game, search.best_move) &&
+                     abs(search.score) < ENGINE_MATE_BOUND && !has_back_rank_pawn(&game->chess);
+
+        if (quiet) {
+            Position position;
+            Game_to_position(game, &position);
+
+            if (PackedPosition_pack(&samples[count].position, &position)) {
+                samples[count].score = (int16_t)(search.score > INT16_MAX ? INT16_MAX : search.score < -INT16_MAX ? -INT16_MAX : search.score);
+                count++;
+            }
+        }
+
+        if (!Game_play_move(game, search.best_move)) {
+            printf("Engine %s played an illegal move\n", gen->engine.name);
+            break;
+        }
+
+        if (has_back_rank_pawn(&game->chess)) {
+            return 0;
+        }
+    }
+
+    if (*result == GameOngoing) {
+        *result = GameDraw;
+    }
+
+    return count;
+}
+
+static void write_record(uint8_t *out, const Sample *sample, uint8_t result) {
+    memcpy(out, &sample->position, sizeof(PackedPosition));
+    memcpy(out + sizeof(PackedPosition), &sample->score, sizeof(int16_t));
+    out[sizeof(PackedPosition) + 2] = result;
+    out[sizeof(PackedPosition) + 3] = 0;
+}
+
+// Hands the buffer being filled to the writer, waits while all of them are still queued
+static void publish(Channel *channel, int count) {
+    uint64_t head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+
+    channel->counts[head % RING_SIZE] = count;
+    atomic_store_explicit(&channel->head, head + 1, memory_order_release);
+
+    while (head + 1 - atomic_load_explicit(&channel->tail, memory_order_acquire) >= RING_SIZE) {
+        sleep_ns(IDLE_SLEEP_NS);
+    }
+}
+
+static void *worker(void *arg) {
+    Worker *w = arg;
+    Generator *gen = w->gen;
+    Channel *channel = w->channel;
+
+    Engine *engine = Engine_new(gen->engine);
+    Game *game = Game_new();
+    int fill = 0;
+
+    while (running) {
+        int idx = atomic_fetch_add(&gen->next_game, 1);
+
+        if (idx >= gen->num_games) {
+            break;
+        }
+
+        enum GameResult result;
+        int count = play_game(gen, engine, game, idx, w->samples, &result);
+        uint8_t white_result = result == GameWhiteWins ? 2 : result == GameDraw ? 1 : 0;
+
+        for (int i = 0; i < count; i++) {
+            uint64_t head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+            write_record(channel->buffers[head % RING_SIZE] + fill * RECORD_SIZE, &w->samples[i], white_result);
+
+            if (++fill == BUFFER_RECORDS) {
+                publish(channel, fill);
+                fill = 0;
+            }
+        }
+
+        atomic_fetch_add_explicit(&channel->games, 1, memory_order_relaxed);
+    }
+
+    if (fill > 0) {
+        publish(channel, fill);
+    }
+
+    atomic_store_explicit(&channel->done, true, memory_order_release);
+
+    Engine_free(engine);
+    Game_free(game);
+
+    return NULL;
+}
+
+struct _Shard {
+    FILE *file;
+    int number;
+    uint64_t bytes;
+    char part_path[512];
+    char path[512];
+};
+typedef struct _Shard Shard;
+
+static void sync_file(FILE *file) {
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        printf("Failed to write a shard: %s\n", strerror(errno));
+        exit(1);
+    }
+}
+
+static void shard_open(Shard *shard, const char *dir) {
+    snprintf(shard->path, sizeof(shard->path), "%s/shard-%06d.bin", dir, shard->number);
+    snprintf(shard->part_path, sizeof(shard->part_path), "%s/shard-%06d.bin.part", dir, shard->number);
+
+    shard->file = fopen(shard->part_path, "wb");
+
+    if (shard->file == NULL) {
+        printf("Failed to open %s\n", shard->part_path);
+        exit(1);
+    }
+
+    uint8_t header[HEADER_SIZE] = {0};
+    uint32_t version = DATAGEN_VERSION, record_size = RECORD_SIZE;
+
+    memcpy(header, DATAGEN_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 12, &record_size, sizeof(record_size));
+
+    fwrite(header, 1, sizeof(header), shard->file);
+    shard->bytes = sizeof(header);
+}
+
+// Synced before the rename and the directory after it, a .bin is never seen half written
+static void shard_close(Shard *shard, const char *dir) {
+    sync_file(shard->file);
+    fclose(shard->file);
+    shard->file = NULL;
+
+    if (rename(shard->part_path, shard->path) != 0) {
+        printf("Failed to rename %s\n", shard->part_path);
+        exit(1);
+    }
+
+    int fd = open(dir, O_RDONLY);
+
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    printf("Wrote %s, %llu records\n", shard->path, (unsigned long long)((shard->bytes - HEADER_SIZE) / RECORD_SIZE));
+}
+
+// after the highest shard number taken, finished or not
+static int first_free_shard(const char *dir) {
+    char path[512];
+    int number = 1;
+
+    for (;;) {
+        snprintf(path, sizeof(path), "%s/shard-%06d.bin", dir, number);
+        bool taken = access(path, F_OK) == 0;
+
+        snprintf(path, sizeof(path), "%s/shard-%06d.bin.part", dir, number);
+        taken = taken || access(path, F_OK) == 0;
+
+        if (!taken) {
+            return number;
+        }
+
+        number++;
+    }
+}
+
+// Drains the workers' rings round robin into the current shard until every worker is done
+static void write_shards(Generator *gen) {
+    Shard shard = {.number = first_free_shard(gen->out_dir)};
+    shard_open(&shard, gen->out_dir);
+
+    uint64_t start = Engine_now_ns();
+    uint64_t last_flush = start, last_report = start;
+    uint64_t records = 0;
+
+    for (;;) {
+        bool idle = true;
+        bool all_done = true;
+
+        for (int i = 0; i < gen->num_workers; i++) {
+            Channel *channel = &gen->channels[i];
+
+            // done is read first: a worker that is done has published everything before it
+            bool done = atomic_load_explicit(&channel->done, memory_order_acquire);
+            uint64_t tail = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+
+            if (tail == atomic_load_explicit(&channel->head, memory_order_acquire)) {
+                all_done = all_done && done;
+                continue;
+            }
+
+            all_done = false;
+            idle = false;
+
+            int count = channel->counts[tail % RING_SIZE];
+
+            if (fwrite(channel->buffers[tail % RING_SIZE], RECORD_SIZE, count, shard.file) != (size_t)count) {
+                printf("Failed to write %s\n", shard.part_path);
+                exit(1);
+            }
+
+            atomic_store_explicit(&channel->tail, tail + 1, memory_order_release);
+
+            shard.bytes += (uint64_t)count * RECORD_SIZE;
+            records += count;
+
+            if (shard.bytes >= gen->shard_bytes) {
+                shard_close(&shard, gen->out_dir);
+                shard.number++;
+                shard_open(&shard, gen->out_dir);
+            }
+        }
+
+        if (all_done) {
+            break;
+        }
+
+        uint64_t now = Engine_now_ns();
+
+        if (now - last_flush >= (uint64_t)gen->flush_sec * 1000000000ull) {
+            sync_file(shard.file);
+            last_flush = now;
+        }
+
+        if (now - last_report >= 10000000000ull) {
+            uint64_t games = 0;
+
+            for (int i = 0; i < gen->num_workers; i++) {
+                games += atomic_load_explicit(&gen->channels[i].games, memory_order_relaxed);
+            }
+
+            printf("Games: %llu  Positions: %llu  %.0f positions/s\n", (unsigned long long)games, (unsigned long long)records,
+                   records / ((now - start) / 1e9));
+            last_report = now;
+        }
+
+        if (idle) {
+            sleep_ns(IDLE_SLEEP_NS);
+        }
+    }
+
+    if (shard.bytes > HEADER_SIZE) {
+        shard_close(&shard, gen->out_dir);
+    } else {
+        fclose(shard.file);
+        remove(shard.part_path);
+    }
+
+    printf("%llu positions in %.1f s\n", (unsigned long long)records, (Engine_now_ns() - start) / 1e9);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s --out <dir> [options]\n", prog);
+    printf("  -e <engine>          name=<name>,depth=<n>,nodes=<n>,hash=<mb>,nnue (default depth=6)\n");
+    printf("  --games <n>          number of games (default 10000)\n");
+    printf("  --threads <n>        worker threads (default: all cores)\n");
+    printf("  --random-plies <n>   random moves at the start of every game (default 8)\n");
+    printf("  --max-plies <n>      adjudicate a draw after this many plies (default 400)\n");
+    printf("  --seed <n>           seed of the random openings (default 1)\n");
+    printf("  --shard-mb <n>       start a new shard after this many MB (default 256)\n");
+    printf("  --flush-sec <n>      sync the open shard this often (default 10)\n");
+    printf("  --nnue <file>        network for an engine with the nnue option\n");
+}
+
+int main(int argc, char **argv) {
+    Generator gen = {.num_games = 10000, .max_plies = 400, .random_plies = 8, .seed = 1, .shard_bytes = 256ull << 20, .flush_sec = 10};
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    Engine_parse_config("name=datagen,depth=6", &gen.engine);
+
+    for (int i = 1; i < argc; i += 2) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(arg, "-e") == 0) {
+            if (!Engine_parse_config(value, &gen.engine)) {
+                return 1;
+            }
+        } else if (strcmp(arg, "--out") == 0) {
+            gen.out_dir = value;
+        } else if (strcmp(arg, "--games") == 0) {
+            gen.num_games = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--random-plies") == 0) {
+            gen.random_plies = atoi(value);
+        } else if (strcmp(arg, "--max-plies") == 0) {
+            gen.max_plies = atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            gen.seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--shard-mb") == 0) {
+            gen.shard_bytes = strtoull(value, NULL, 10) << 20;
+        } else if (strcmp(arg, "--flush-sec") == 0) {
+            gen.flush_sec = atoi(value);
+        } else if (strcmp(arg, "--nnue") == 0) {
+            if (!NNUE_load(value)) {
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (gen.out_dir == NULL || gen.shard_bytes == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (gen.max_plies > GAME_MAX_PLIES) {
+        gen.max_plies = GAME_MAX_PLIES;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    if (mkdir(gen.out_dir, 0755) != 0 && errno != EEXIST) {
+        printf("Failed to create %s\n", gen.out_dir);
+        return 1;
+    }
+
+    gen.num_workers = threads;
+    gen.channels = aligned_alloc(64, sizeof(Channel) * threads);
+    Worker *workers = calloc(threads, sizeof(Worker));
+
+    if (gen.channels == NULL || workers == NULL) {
+        printf("Failed to allocate the workers\n");
+        return 1;
+    }
+
+    atomic_init(&gen.next_game, 0);
+
+    for (int i = 0; i < threads; i++) {
+        atomic_init(&gen.channels[i].head, 0);
+        atomic_init(&gen.channels[i].tail, 0);
+        atomic_init(&gen.channels[i].done, false);
+        atomic_init(&gen.channels[i].games, 0);
+        workers[i] = (Worker){.gen = &gen, .channel = &gen.channels[i]};
+    }
+
+    // stops after the games being played, what they sampled is still written
+    struct sigaction sa = {.sa_handler = handle_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("%s, %d games on %d threads into %s\n", gen.engine.name, gen.num_games, threads, gen.out_dir);
+
+    pthread_t *handles = calloc(threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&handles[i], NULL, worker, &workers[i]);
+    }
+
+    write_shards(&gen);
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+    }
+
+    free(handles);
+    free(workers);
+    free(gen.channels);
+
+    return 0;
+}
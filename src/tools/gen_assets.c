@@ -0,0 +1,211 @@
+// Bakes the GUI assets into the binary, run by build.sh:
+//   ./bin/gen_assets src/assets src/embedded_assets.h src/embedded_assets.c
+//
+// The sprite sheet is decoded to RGBA32 pixels (bytes R, G, B, A) that can be handed to
+// SDL_CreateRGBSurfaceWithFormatFrom as they are. The printable ASCII characters of the font
+// are rasterized side by side into one atlas of coverage bytes, with the glyph widths, at the
+// size the GUI used to open the font with. Only this tool links SDL_image and SDL_ttf.
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPRITES_FILE "chesssprites.png"
+#define FONT_FILE "Arial.ttf"
+#define FONT_SIZE 10
+
+#define GLYPH_FIRST ' '
+#define GLYPH_LAST '~'
+#define GLYPH_COUNT (GLYPH_LAST - GLYPH_FIRST + 1)
+
+static FILE *header;
+static FILE *source;
+
+static void fail(const char *what) {
+    printf("%s: %s\n", what, SDL_GetError());
+    exit(1);
+}
+
+static void print_bytes(const char *name, const uint8_t *bytes, size_t count) {
+    fprintf(header, "extern const uint8_t %s[%zu];\n", name, count);
+    fprintf(source, "const uint8_t %s[%zu] = {\n", name, count);
+
+    for (size_t i = 0; i < count; i += 24) {
+        fprintf(source, "   ");
+
+        for (size_t j = i; j < i + 24 && j < count; j++) {
+            fprintf(source, " 0x%02x,", bytes[j]);
+        }
+
+        fprintf(source, "\n");
+    }
+
+    fprintf(source, "};\n\n");
+}
+
+static void print_sprites(const char *path) {
+    SDL_Surface *loaded = IMG_Load(path);
+    SDL_Surface *sprites = loaded != NULL ? SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0) : NULL;
+
+    if (sprites == NULL) {
+        fail(path);
+    }
+
+    size_t row_bytes = (size_t)sprites->w * 4;
+    uint8_t *pixels = malloc(row_bytes * sprites->h);
+
+    if (pixels == NULL) {
+        printf("Failed to allocate the sprite sheet\n");
+        exit(1);
+    }
+
+    SDL_LockSurface(sprites);
+
+    for (int row = 0; row < sprites->h; row++) {
+        memcpy(pixels + row * row_bytes, (const uint8_t *)sprites->pixels + (size_t)row * sprites->pitch, row_bytes);
+    }
+
+    SDL_UnlockSurface(sprites);
+
+    fprintf(header, "// %s, SDL_PIXELFORMAT_RGBA32 rows without padding\n", SPRITES_FILE);
+    fprintf(header, "#define SPRITES_WIDTH %d\n#define SPRITES_HEIGHT %d\n", sprites->w, sprites->h);
+    print_bytes("SpritesPixels", pixels, row_bytes * sprites->h);
+
+    free(pixels);
+    SDL_FreeSurface(sprites);
+    SDL_FreeSurface(loaded);
+}
+
+static void print_glyphs(const char *path) {
+    TTF_Font *font = TTF_OpenFont(path, FONT_SIZE);
+
+    if (font == NULL) {
+        fail(path);
+    }
+
+    int height = TTF_FontHeight(font);
+    int x[GLYPH_COUNT + 1] = {0};
+    SDL_Surface *rendered[GLYPH_COUNT] = {0};
+
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        char text[2] = {(char)(GLYPH_FIRST + i), '\0'};
+        int width = 0;
+
+        if (TTF_SizeText(font, text, &width, NULL) != 0) {
+            fail("TTF_SizeText");
+        }
+
+        // the space has nothing to draw, some versions of SDL_ttf refuse to render it
+        if (text[0] != ' ') {
+            SDL_Surface *surface = TTF_RenderText_Blended(font, text, (SDL_Color){255, 255, 255, 255});
+            rendered[i] = surface != NULL ? SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0) : NULL;
+
+            if (rendered[i] == NULL) {
+                fail("TTF_RenderText_Blended");
+            }
+
+            SDL_FreeSurface(surface);
+        }
+
+        x[i + 1] = x[i] + width;
+    }
+
+    int atlas_width = x[GLYPH_COUNT];
+    uint8_t *atlas = calloc((size_t)atlas_width * height, 1);
+
+    if (atlas == NULL) {
+        printf("Failed to allocate the glyph atlas\n");
+        exit(1);
+    }
+
+    // only the alpha of the white text is kept, the color is picked when drawing
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        SDL_Surface *glyph = rendered[i];
+
+        if (glyph == NULL) {
+            continue;
+        }
+
+        SDL_LockSurface(glyph);
+
+        for (int row = 0; row < height && row < glyph->h; row++) {
+            const uint8_t *pixels = (const uint8_t *)glyph->pixels + (size_t)row * glyph->pitch;
+
+            for (int col = 0; col < x[i + 1] - x[i] && col < glyph->w; col++) {
+                atlas[(size_t)row * atlas_width + x[i] + col] = pixels[col * 4 + 3];
+            }
+        }
+
+        SDL_UnlockSurface(glyph);
+        SDL_FreeSurface(glyph);
+    }
+
+    fprintf(header, "\n// %s at size %d, characters %d-%d next to each other, one coverage byte per pixel\n", FONT_FILE, FONT_SIZE,
+            GLYPH_FIRST, GLYPH_LAST);
+    fprintf(header, "#define GLYPH_FIRST %d\n#define GLYPH_COUNT %d\n", GLYPH_FIRST, GLYPH_COUNT);
+    fprintf(header, "#define GLYPH_ATLAS_WIDTH %d\n#define GLYPH_ATLAS_HEIGHT %d\n", atlas_width, height);
+    print_bytes("GlyphAtlas", atlas, (size_t)atlas_width * height);
+
+    // glyph i covers columns GlyphX[i] up to GlyphX[i + 1]
+    fprintf(header, "extern const uint16_t GlyphX[%d];\n", GLYPH_COUNT + 1);
+    fprintf(source, "const uint16_t GlyphX[%d] = {", GLYPH_COUNT + 1);
+
+    for (int i = 0; i <= GLYPH_COUNT; i++) {
+        fprintf(source, "%s%d", i ? ", " : "", x[i]);
+    }
+
+    fprintf(source, "};\n");
+
+    free(atlas);
+    TTF_CloseFont(font);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        printf("Usage: %s <assets dir> <header> <source>\n", argv[0]);
+        return 1;
+    }
+
+    if (SDL_Init(0) < 0 || TTF_Init() < 0) {
+        fail("SDL initialization failed");
+    }
+
+    header = fopen(argv[2], "w");
+    source = fopen(argv[3], "w");
+
+    if (header == NULL || source == NULL) {
+        printf("Failed to open the output files\n");
+        return 1;
+    }
+
+    char path[512];
+
+    fprintf(header, "// Generated by src/tools/gen_assets.c, do not edit\n\n");
+    fprintf(header, "#include <stdint.h>\n\n");
+    fprintf(header, "#ifndef EMBEDDED_ASSETS\n#define EMBEDDED_ASSETS\n\n");
+
+    fprintf(source, "// Generated by src/tools/gen_assets.c, do not edit\n\n");
+    fprintf(source, "#include \"embedded_assets.h\"\n\n");
+    fprintf(source, "// clang-format off\n");
+
+    snprintf(path, sizeof(path), "%s/%s", argv[1], SPRITES_FILE);
+    print_sprites(path);
+
+    snprintf(path, sizeof(path), "%s/%s", argv[1], FONT_FILE);
+    print_glyphs(path);
+
+    fprintf(header, "\n#endif // !EMBEDDED_ASSETS\n");
+    fprintf(source, "// clang-format on\n");
+
+    fclose(header);
+    fclose(source);
+
+    TTF_Quit();
+    SDL_Quit();
+
+    return 0;
+}
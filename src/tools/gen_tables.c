@@ -0,0 +1,314 @@
+// Generates the per-square attack, ray, between / line and distance tables used by the move
+// generator, run by build.sh: ./bin/gen_tables src/chess/tables.h src/chess/tables.c
+//
+// Squares are board indices, row * 8 + col, in board coordinates (not relative to a color), so
+// the same tables work for both board orientations. Bitboards use the square as the bit index.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROWS 8
+#define COLS 8
+#define SQUARES (ROWS * COLS)
+
+// clang-format off
+// straight directions first (see RAY_IS_STRAIGHT), opposite directions differ in bit 1
+static const struct {
+    const char *name;
+    int row_adder, col_adder;
+} Directions[8] = {
+    {"RayUp",        -1,  0},
+    {"RayRight",      0,  1},
+    {"RayDown",       1,  0},
+    {"RayLeft",       0, -1},
+    {"RayUpRight",   -1,  1},
+    {"RayUpLeft",    -1, -1},
+    {"RayDownLeft",   1, -1},
+    {"RayDownRight",  1,  1},
+};
+
+static const int KnightOffsets[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+static const int KingOffsets[8][2]   = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+// clang-format on
+
+struct List {
+    int count;
+    int squares[8];
+};
+
+static uint64_t Between[SQUARES][SQUARES];
+static uint64_t Line[SQUARES][SQUARES];
+
+static FILE *header;
+static FILE *source;
+
+static inline int within_bounds(int row, int col) { return row >= 0 && row < ROWS && col >= 0 && col < COLS; }
+
+static struct List offsets_list(int square, const int offsets[][2], int count) {
+    struct List list = {0};
+
+    for (int i = 0; i < count; i++) {
+        int row = square / COLS + offsets[i][0];
+        int col = square % COLS + offsets[i][1];
+
+        if (within_bounds(row, col)) {
+            list.squares[list.count++] = row * COLS + col;
+        }
+    }
+
+    return list;
+}
+
+static struct List ray_list(int square, int direction) {
+    struct List list = {0};
+
+    int row = square / COLS + Directions[direction].row_adder;
+    int col = square % COLS + Directions[direction].col_adder;
+
+    for (; within_bounds(row, col); row += Directions[direction].row_adder, col += Directions[direction].col_adder) {
+        list.squares[list.count++] = row * COLS + col;
+    }
+
+    return list;
+}
+
+static uint64_t list_mask(struct List list) {
+    uint64_t mask = 0;
+
+    for (int i = 0; i < list.count; i++) {
+        mask |= 1ull << list.squares[i];
+    }
+
+    return mask;
+}
+
+static void print_list(struct List list) {
+    fprintf(source, "{%d, {", list.count);
+
+    if (list.count == 0) {
+        fprintf(source, "0");
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        fprintf(source, i ? ", %d" : "%d", list.squares[i]);
+    }
+
+    fprintf(source, "}}");
+}
+
+// declared in the header, defined in the source
+static void print_table_start(const char *type, const char *name, const char *dimensions) {
+    fprintf(header, "extern const %s %s%s;\n", type, name, dimensions);
+    fprintf(source, "const %s %s%s = {\n", type, name, dimensions);
+}
+
+static void print_list_table(const char *name, const int offsets[][2], int count) {
+    print_table_start("SquareList", name, "[64]");
+
+    for (int square = 0; square < SQUARES; square++) {
+        fprintf(source, "    ");
+        print_list(offsets_list(square, offsets, count));
+        fprintf(source, ",\n");
+    }
+
+    fprintf(source, "};\n\n");
+}
+
+static void print_mask_table(const char *name, const int offsets[][2], int count) {
+    print_table_start("uint64_t", name, "[64]");
+
+    for (int square = 0; square < SQUARES; square++) {
+        fprintf(source, "    0x%016llxull,\n", (unsigned long long)list_mask(offsets_list(square, offsets, count)));
+    }
+
+    fprintf(source, "};\n\n");
+}
+
+static void print_square_mask_table(const char *name, uint64_t table[SQUARES][SQUARES]) {
+    print_table_start("uint64_t", name, "[64][64]");
+
+    for (int from = 0; from < SQUARES; from++) {
+        fprintf(source, "    {");
+
+        for (int to = 0; to < SQUARES; to++) {
+            fprintf(source, "%s0x%llxull", to ? ", " : "", (unsigned long long)table[from][to]);
+        }
+
+        fprintf(source, "},\n");
+    }
+
+    fprintf(source, "};\n\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        printf("Usage: %s <header> <source>\n", argv[0]);
+        return 1;
+    }
+
+    header = fopen(argv[1], "w");
+    source = fopen(argv[2], "w");
+
+    if (header == NULL || source == NULL) {
+        printf("Failed to open the output files\n");
+        return 1;
+    }
+
+    // Between: squares strictly between two squares on a common line, Line: the whole line
+    // through both (including them), 0 when they don't share one
+    for (int from = 0; from < SQUARES; from++) {
+        for (int direction = 0; direction < 8; direction++) {
+            struct List ray = ray_list(from, direction);
+            struct List opposite = ray_list(from, direction ^ 2);
+            uint64_t line = list_mask(ray) | list_mask(opposite) | 1ull << from;
+            uint64_t between = 0;
+
+            for (int i = 0; i < ray.count; i++) {
+                Between[from][ray.squares[i]] = between;
+                Line[from][ray.squares[i]] = line;
+                between |= 1ull << ray.squares[i];
+            }
+        }
+    }
+
+    fprintf(header, "// Generated by src/tools/gen_tables.c, do not edit\n\n");
+    fprintf(header, "#include <stdint.h>\n\n");
+    fprintf(header, "#ifndef CHESS_TABLES\n#define CHESS_TABLES\n\n");
+
+    fprintf(header, "struct _SquareList {\n    uint8_t count;\n    uint8_t squares[8];\n};\n");
+    fprintf(header, "typedef struct _SquareList SquareList;\n\n");
+
+    fprintf(header, "#define SQUARE(row, col) ((row) * %d + (col))\n", COLS);
+    fprintf(header, "#define SQUARE_ROW(square) ((square) / %d)\n", COLS);
+    fprintf(header, "#define SQUARE_COL(square) ((square) %% %d)\n\n", COLS);
+
+    fprintf(header, "enum RayDirection {\n");
+
+    for (int direction = 0; direction < 8; direction++) {
+        fprintf(header, "    %s,\n", Directions[direction].name);
+    }
+
+    fprintf(header, "};\n\n");
+    fprintf(header, "#define RAY_IS_STRAIGHT(direction) ((direction) < RayUpRight)\n");
+    fprintf(header, "#define RAY_OPPOSITE(direction) ((direction) ^ 2)\n\n");
+
+    fprintf(header, "// Squares are row * 8 + col in board coordinates, bitboards use them as bit indices\n");
+
+    fprintf(source, "// Generated by src/tools/gen_tables.c, do not edit\n\n");
+    fprintf(source, "#include \"tables.h\"\n\n");
+    fprintf(source, "// clang-format off\n");
+
+    print_list_table("KnightTargets", KnightOffsets, 8);
+    print_list_table("KingTargets", KingOffsets, 8);
+    print_mask_table("KnightMask", KnightOffsets, 8);
+    print_mask_table("KingMask", KingOffsets, 8);
+
+    // [0] for pawns moving up the board (row - 1), [1] for pawns moving down
+    static const int pawn_offsets[2][2][2] = {{{-1, -1}, {-1, 1}}, {{1, -1}, {1, 1}}};
+
+    fprintf(header, "// [0] for pawns moving up the board, [1] for pawns moving down\n");
+    print_table_start("SquareList", "PawnCaptureTargets", "[2][64]");
+
+    for (int down = 0; down < 2; down++) {
+        fprintf(source, "    {\n");
+
+        for (int square = 0; square < SQUARES; square++) {
+            fprintf(source, "        ");
+            print_list(offsets_list(square, pawn_offsets[down], 2));
+            fprintf(source, ",\n");
+        }
+
+        fprintf(source, "    },\n");
+    }
+
+    fprintf(source, "};\n\n");
+
+    fprintf(header, "// [square][enum RayDirection], ordered from the square outwards\n");
+    print_table_start("SquareList", "Rays", "[64][8]");
+
+    for (int square = 0; square < SQUARES; square++) {
+        fprintf(source, "    {");
+
+        for (int direction = 0; direction < 8; direction++) {
+            fprintf(source, direction ? ", " : "");
+            print_list(ray_list(square, direction));
+        }
+
+        fprintf(source, "},\n");
+    }
+
+    fprintf(source, "};\n\n");
+
+    fprintf(header, "// squares strictly between the two, 0 when they aren't on a common line\n");
+    print_square_mask_table("BetweenMask", Between);
+    fprintf(header, "// the whole line through both squares, 0 when they aren't on a common line\n");
+    print_square_mask_table("LineMask", Line);
+
+    // Chebyshev distance, the number of king moves between two squares
+    fprintf(header, "// number of king moves between two squares\n");
+    print_table_start("uint8_t", "SquareDistance", "[64][64]");
+
+    for (int from = 0; from < SQUARES; from++) {
+        fprintf(source, "    {");
+
+        for (int to = 0; to < SQUARES; to++) {
+            int rows = abs(from / COLS - to / COLS);
+            int cols = abs(from % COLS - to % COLS);
+
+            fprintf(source, "%s%d", to ? ", " : "", rows > cols ? rows : cols);
+        }
+
+        fprintf(source, "},\n");
+    }
+
+    fprintf(source, "};\n\n");
+
+    // pshufb masks of the packed position codec, 0x80 selects a zero byte
+    fprintf(header, "// [byte][bit] number of set bits of byte below bit, 0x80 when bit isn't set\n");
+    print_table_start("uint8_t", "ByteExpand", "[256][8]");
+
+    for (int byte = 0; byte < 256; byte++) {
+        fprintf(source, "    {");
+
+        for (int bit = 0, rank = 0; bit < 8; bit++) {
+            fprintf(source, "%s%d", bit ? ", " : "", byte >> bit & 1 ? rank++ : 0x80);
+        }
+
+        fprintf(source, "},\n");
+    }
+
+    fprintf(source, "};\n\n");
+
+    fprintf(header, "// [byte][i] the i-th set bit of byte, 0x80 past the last one\n");
+    print_table_start("uint8_t", "ByteCompress", "[256][8]");
+
+    for (int byte = 0; byte < 256; byte++) {
+        int bits[8];
+        int count = 0;
+
+        for (int bit = 0; bit < 8; bit++) {
+            if (byte >> bit & 1) {
+                bits[count++] = bit;
+            }
+        }
+
+        fprintf(source, "    {");
+
+        for (int i = 0; i < 8; i++) {
+            fprintf(source, "%s%d", i ? ", " : "", i < count ? bits[i] : 0x80);
+        }
+
+        fprintf(source, "},\n");
+    }
+
+    fprintf(source, "};\n");
+    fprintf(source, "// clang-format on\n");
+
+    fprintf(header, "\n#endif // !CHESS_TABLES\n");
+
+    fclose(header);
+    fclose(source);
+
+    return 0;
+}
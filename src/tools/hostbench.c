@@ -0,0 +1,197 @@
+// Load test of the GameHost: creates many games, plays random legal moves on random games from
+// several threads and reports moves per second and the memory per hosted game. Every game is
+// checked afterwards by replaying its move history on a fresh Game.
+//
+//   ./bin/hostbench --games 50000 --threads 8 --moves 2000000 --shards 64
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct _Bench {
+    GameHost *host;
+    uint64_t *ids;
+    int num_games;
+    int moves_per_thread;
+};
+typedef struct _Bench Bench;
+
+struct _Worker {
+    Bench *bench;
+    uint64_t seed;
+    int played;
+    int finished;
+};
+typedef struct _Worker Worker;
+
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void *worker(void *arg) {
+    Worker *w = arg;
+    Bench *bench = w->bench;
+    Move moves[ENGINE_MAX_MOVES];
+
+    for (int i = 0; i < bench->moves_per_thread; i++) {
+        uint64_t id = bench->ids[next_random(&w->seed) % bench->num_games];
+        int count;
+
+        // another thread can get in between, then the move may be illegal or the game over
+        if (GameHost_legal_moves(bench->host, id, moves, &count) != HostOk || count == 0) {
+            continue;
+        }
+
+        HostedGameInfo info;
+
+        if (GameHost_play(bench->host, id, moves[next_random(&w->seed) % count], &info) == HostOk) {
+            w->played++;
+            w->finished += info.result != GameOngoing;
+        }
+    }
+
+    return NULL;
+}
+
+// The host's position and result have to match the same moves played on a Game
+static bool check_game(GameHost *host, Game *game, uint64_t id) {
+    static Move moves[GAME_MAX_PLIES];
+    int count;
+    HostedGameInfo info;
+
+    if (GameHost_moves(host, id, moves, GAME_MAX_PLIES, &count) != HostOk || GameHost_query(host, id, &info) != HostOk) {
+        return false;
+    }
+
+    Game_reset(game);
+
+    for (int i = 0; i < count; i++) {
+        if (!Game_play_move(game, moves[i])) {
+            return false;
+        }
+    }
+
+    Position expected;
+    Game_to_position(game, &expected);
+
+    enum GameEndReason reason;
+    enum GameResult result = Game_result(game, &reason);
+
+    // the host adjudicates a draw when every legal move is a promotion, which it can't play
+    if (result == GameOngoing) {
+        Move legal[ENGINE_MAX_MOVES];
+        int n = Game_legal_moves(game, legal), promotions = 0;
+
+        for (int i = 0; i < n; i++) {
+            promotions += Game_is_promotion(game, legal[i]);
+        }
+
+        if (n > 0 && promotions == n) {
+            result = GameDraw;
+            reason = GameEndPromotion;
+        }
+    }
+
+    return memcmp(expected.squares, info.position.squares, sizeof(expected.squares)) == 0 && expected.hash == info.position.hash &&
+           expected.castling == info.position.castling && expected.halfmove_clock == info.position.halfmove_clock &&
+           expected.fullmove_number == info.position.fullmove_number && result == info.result && reason == info.reason &&
+           count == info.ply;
+}
+
+int main(int argc, char **argv) {
+    int num_games = 50000;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int total_moves = 1000000;
+    int shards = 64;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--games") == 0) {
+            num_games = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--moves") == 0) {
+            total_moves = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--shards") == 0) {
+            shards = atoi(argv[i + 1]);
+        } else {
+            printf("Usage: %s [--games <n>] [--threads <n>] [--moves <n>] [--shards <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (num_games < 1 || threads < 1) {
+        printf("Need at least one game and one thread\n");
+        return 1;
+    }
+
+    Bench bench = {.host = GameHost_new(shards), .num_games = num_games, .moves_per_thread = total_moves / threads};
+    bench.ids = malloc(num_games * sizeof(uint64_t));
+
+    uint64_t start = Engine_now_ns();
+
+    for (int i = 0; i < num_games; i++) {
+        GameHost_create(bench.host, NULL, &bench.ids[i]);
+    }
+
+    HostStats stats;
+    GameHost_stats(bench.host, &stats);
+    printf("Created %zu games in %.2f s, %zu bytes per game\n", stats.games, (Engine_now_ns() - start) / 1e9, stats.bytes / stats.games);
+
+    Worker *workers = calloc(threads, sizeof(Worker));
+    pthread_t *handles = calloc(threads, sizeof(pthread_t));
+
+    start = Engine_now_ns();
+
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (Worker){.bench = &bench, .seed = 0x9E3779B97F4A7C15ull * (i + 1)};
+        pthread_create(&handles[i], NULL, worker, &workers[i]);
+    }
+
+    int played = 0, finished = 0;
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+        played += workers[i].played;
+        finished += workers[i].finished;
+    }
+
+    double seconds = (Engine_now_ns() - start) / 1e9;
+    GameHost_stats(bench.host, &stats);
+
+    printf("%d moves on %d threads in %.2f s, %.0f moves/s, %d games finished\n", played, threads, seconds, played / seconds, finished);
+    printf("%zu bytes per game (%.1f plies each), %d pooled Games\n", stats.bytes / stats.games, (double)played / num_games, stats.pooled_games);
+
+    Game *game = Game_new();
+    int bad = 0;
+
+    for (int i = 0; i < num_games; i++) {
+        bad += !check_game(bench.host, game, bench.ids[i]);
+    }
+
+    printf("%d of %d games differ from a replay\n", bad, num_games);
+
+    // every other game removed, the rest expired
+    for (int i = 0; i < num_games; i += 2) {
+        GameHost_remove(bench.host, bench.ids[i]);
+    }
+
+    int expired = GameHost_expire(bench.host, 0);
+    GameHost_stats(bench.host, &stats);
+    printf("Removed %d, expired %d, %zu left\n", (num_games + 1) / 2, expired, stats.games);
+
+    Game_free(game);
+    GameHost_free(bench.host);
+    free(bench.ids);
+    free(workers);
+    free(handles);
+
+    return bad != 0 || stats.games != 0;
+}
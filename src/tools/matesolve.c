@@ -0,0 +1,241 @@
+// Batch mate solver for puzzle collections.
+//
+//   ./bin/matesolve --max-moves 5 --hash 256 puzzles.epd more.epd
+//
+// One position per line, a FEN optionally followed by EPD operations, "dm N" asks for a mate in
+// exactly N (the bound then is N) and is checked against the result. Lines starting with '#' are
+// skipped. Prints one line per puzzle in input order:
+//
+//   puzzles.epd:12 mate 3 nodes=5120 pv=h5f7 e8d7 c4e6 d7c6 f7d5
+//   puzzles.epd:13 none nodes=48211 expected=2 MISMATCH
+//
+// and exits with 1 when any dm didn't match. Puzzles are spread over --threads solvers, each with
+// an equal share of the --hash megabytes.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_LINE 512
+
+struct _Puzzle {
+    char fen[128];
+    // "file:line"
+    char where[96];
+    // from "dm N", 0 = not given
+    int expected;
+    MateResult result;
+};
+typedef struct _Puzzle Puzzle;
+
+struct _Batch {
+    Puzzle *puzzles;
+    int count;
+    int capacity;
+
+    int max_moves;
+    uint64_t max_nodes;
+    size_t table_mb;
+
+    atomic_int next;
+};
+typedef struct _Batch Batch;
+
+static void usage(const char *name) {
+    printf("Usage: %s [--max-moves <n>] [--nodes <per puzzle>] [--hash <mb>] [--threads <n>] <file>...\n", name);
+}
+
+static void load_puzzles(Batch *batch, const char *path) {
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        printf("Failed to open %s\n", path);
+        exit(1);
+    }
+
+    char line[MAX_LINE];
+
+    for (int number = 1; fgets(line, sizeof(line), f) != NULL; number++) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+
+        if (batch->count == batch->capacity) {
+            batch->capacity = batch->capacity ? batch->capacity * 2 : 1024;
+            batch->puzzles = realloc(batch->puzzles, sizeof(Puzzle) * batch->capacity);
+
+            if (batch->puzzles == NULL) {
+                printf("Failed to allocate puzzles\n");
+                exit(1);
+            }
+        }
+
+        Puzzle *puzzle = &batch->puzzles[batch->count++];
+        *puzzle = (Puzzle){0};
+        snprintf(puzzle->where, sizeof(puzzle->where), "%s:%d", path, number);
+
+        // EPD operations follow the four position fields, a plain FEN has the clocks there
+        char *dm = strstr(line, "dm ");
+
+        if (dm != NULL) {
+            puzzle->expected = atoi(dm + 3);
+            *dm = '\0';
+        }
+
+        line[strcspn(line, ";")] = '\0';
+        snprintf(puzzle->fen, sizeof(puzzle->fen), "%.*s", (int)sizeof(puzzle->fen) - 1, line);
+    }
+
+    fclose(f);
+}
+
+static void *solve_thread(void *arg) {
+    Batch *batch = arg;
+    MateSolver *solver = MateSolver_new(batch->table_mb);
+    Game *game = Game_new();
+
+    for (int i = atomic_fetch_add(&batch->next, 1); i < batch->count; i = atomic_fetch_add(&batch->next, 1)) {
+        Puzzle *puzzle = &batch->puzzles[i];
+
+        if (!Game_load_fen(game, puzzle->fen)) {
+            puzzle->result = (MateResult){.status = MateUnknown};
+            puzzle->fen[0] = '\0';
+            continue;
+        }
+
+        int max_moves = puzzle->expected > 0 ? puzzle->expected : batch->max_moves;
+        puzzle->result = MateSolver_solve(solver, &game->chess, max_moves, batch->max_nodes);
+    }
+
+    MateSolver_free(solver);
+    Game_free(game);
+
+    return NULL;
+}
+
+// "puzzles.epd:12 mate 3 nodes=5120 pv=h5f7 e8d7", false on a dm mismatch
+static bool print_puzzle(Game *game, const Puzzle *puzzle) {
+    const MateResult *result = &puzzle->result;
+
+    if (puzzle->fen[0] == '\0') {
+        printf("%s error reason=bad_fen\n", puzzle->where);
+        return true;
+    }
+
+    printf("%s %s", puzzle->where, Mate_status_string(result->status));
+
+    if (result->status == MateFound) {
+        printf(" %d", result->moves);
+    }
+
+    printf(" nodes=%lu", (unsigned long)result->nodes);
+
+    if (result->pv_length > 0) {
+        printf(" pv=");
+        Game_load_fen(game, puzzle->fen);
+
+        for (int i = 0; i < result->pv_length; i++) {
+            char uci[6];
+            Game_move_to_uci(game, result->pv[i], uci);
+            printf("%s%s", i ? " " : "", uci);
+            Game_play_move(game, result->pv[i]);
+        }
+    }
+
+    bool ok = puzzle->expected == 0 || result->status == MateUnknown || (result->status == MateFound && result->moves == puzzle->expected);
+
+    if (puzzle->expected > 0) {
+        printf(" expected=%d%s", puzzle->expected, ok ? "" : " MISMATCH");
+    }
+
+    printf("\n");
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    Batch batch = {.max_moves = 5, .max_nodes = 10000000};
+    size_t hash_mb = 256;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            first_file = i;
+            break;
+        }
+
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+
+        if (strcmp(argv[i - 1], "--max-moves") == 0) {
+            batch.max_moves = atoi(value);
+        } else if (strcmp(argv[i - 1], "--nodes") == 0) {
+            batch.max_nodes = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i - 1], "--hash") == 0) {
+            hash_mb = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i - 1], "--threads") == 0) {
+            threads = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (first_file == argc || threads < 1 || batch.max_moves < 1 || batch.max_moves > MATE_MAX_MOVES) {
+        usage(argv[0]);
+        printf("Mates up to %d moves, at least one thread\n", MATE_MAX_MOVES);
+        return 1;
+    }
+
+    for (int i = first_file; i < argc; i++) {
+        load_puzzles(&batch, argv[i]);
+    }
+
+    batch.table_mb = hash_mb / threads > 0 ? hash_mb / threads : 1;
+
+    uint64_t start = Engine_now_ns();
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, solve_thread, &batch);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    double seconds = (Engine_now_ns() - start) / 1e9;
+
+    Game *game = Game_new();
+    int counts[3] = {0};
+    int mismatches = 0;
+    uint64_t nodes = 0;
+
+    for (int i = 0; i < batch.count; i++) {
+        mismatches += !print_puzzle(game, &batch.puzzles[i]);
+        counts[batch.puzzles[i].result.status]++;
+        nodes += batch.puzzles[i].result.nodes;
+    }
+
+    printf("%d puzzles: %d mate, %d none, %d unknown, %d mismatches, %lu nodes in %.1f s\n", batch.count, counts[MateFound], counts[MateNone],
+           counts[MateUnknown], mismatches, (unsigned long)nodes, seconds);
+
+    Game_free(game);
+    free(workers);
+    free(batch.puzzles);
+
+    return mismatches > 0;
+}
@@ -0,0 +1,425 @@
+// Parallel perft, counts the leaf nodes of the legal move tree to verify the move generator.
+//
+//   ./bin/perft --depth 6 --fen "<fen>" --threads 8 --hash 256 --split-ply 2 --divide
+//
+// The tree is cut at --split-ply into tasks (one per move sequence of that length) that the
+// threads take from a shared counter, so a thread that finishes early keeps picking up work.
+// Each thread walks its tasks on its own Chess stack. Subtree counts go into a shared lock-free
+// (position, depth) -> count cache, transposed subtrees are only counted once.
+//
+// --divide prints the count per root move, in move generation order, so the output doesn't
+// depend on the number of threads. Timing goes to stderr.
+//
+// --verify compares the counts of the standard test positions with the published ones, see
+// References. Exits with 1 on any mismatch.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_DEPTH 16
+#define MAX_SPLIT_PLY 4
+
+#define STARTPOS_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define KIWIPETE_FEN "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"
+#define POSITION3_FEN "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+
+// Key and data xor-ed together like the engine's HashTable, a torn entry fails the key check.
+// data = count << 8 | depth
+struct _PerftEntry {
+    _Atomic uint64_t key;
+    _Atomic uint64_t data;
+};
+typedef struct _PerftEntry PerftEntry;
+
+struct _PerftTask {
+    // index of the root move, for --divide
+    int root;
+    Move moves[MAX_SPLIT_PLY];
+    int num_moves;
+};
+typedef struct _PerftTask PerftTask;
+
+struct _Perft {
+    Chess root;
+    int depth;
+
+    PerftEntry *cache;
+    uint64_t cache_mask;
+
+    PerftTask *tasks;
+    int num_tasks;
+    int capacity;
+
+    Move root_moves[ENGINE_MAX_MOVES];
+    int num_root_moves;
+    _Atomic uint64_t root_counts[ENGINE_MAX_MOVES];
+
+    atomic_int next_task;
+};
+typedef struct _Perft Perft;
+
+struct _PerftThread {
+    Perft *perft;
+    Chess stack[MAX_DEPTH + 1];
+};
+typedef struct _PerftThread PerftThread;
+
+static void usage(const char *name) {
+    printf("Usage: %s --depth <n> [--fen <fen>] [--threads <n>] [--hash <mb>] [--split-ply <n>] [--divide]\n", name);
+    printf("       %s --verify [--threads <n>] [--hash <mb>] [--split-ply <n>]\n", name);
+}
+
+// the hash has no castling rights, positions that only differ in them have different subtrees
+static inline uint64_t cache_key(const Chess *game) { return game->hash ^ Chess_zobrist_castling_key(Chess_castling_rights(game)); }
+
+static bool cache_probe(const Perft *perft, uint64_t key, int depth, uint64_t *count) {
+    PerftEntry *entry = &perft->cache[key & perft->cache_mask];
+
+    uint64_t stored = atomic_load_explicit(&entry->key, memory_order_relaxed);
+    uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+    if ((stored ^ data) != key || (int)(data & 0xff) != depth) {
+        return false;
+    }
+
+    *count = data >> 8;
+
+    return true;
+}
+
+static void cache_store(Perft *perft, uint64_t key, int depth, uint64_t count) {
+    PerftEntry *entry = &perft->cache[key & perft->cache_mask];
+    uint64_t data = count << 8 | (uint64_t)depth;
+
+    atomic_store_explicit(&entry->key, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
+
+static uint64_t count_leaves(PerftThread *thread, int ply, int depth) {
+    Chess *game = &thread->stack[ply];
+    Perft *shared = thread->perft;
+
+    // depth 1 is cheaper to count than to look up
+    uint64_t key = 0;
+    bool cached = shared->cache != NULL && depth > 1;
+    uint64_t count = 0;
+
+    if (cached) {
+        key = cache_key(game);
+
+        if (cache_probe(shared, key, depth, &count)) {
+            return count;
+        }
+    }
+
+    Move moves[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(game, moves);
+
+    for (int i = 0; i < n; i++) {
+        if (!Engine_make_move(&thread->stack[ply + 1], game, moves[i])) {
+            continue;
+        }
+
+        count += depth == 1 ? 1 : count_leaves(thread, ply + 1, depth - 1);
+    }
+
+    if (cached) {
+        cache_store(shared, key, depth, count);
+    }
+
+    return count;
+}
+
+static void add_task(Perft *perft, const PerftTask *task) {
+    if (perft->num_tasks == perft->capacity) {
+        perft->capacity = perft->capacity ? perft->capacity * 2 : 1024;
+        perft->tasks = realloc(perft->tasks, sizeof(PerftTask) * perft->capacity);
+
+        if (perft->tasks == NULL) {
+            printf("Failed to allocate perft tasks\n");
+            exit(1);
+        }
+    }
+
+    perft->tasks[perft->num_tasks++] = *task;
+}
+
+// Every legal move sequence of split_ply moves from the root, shorter ones end in mate / stalemate
+// and count as nothing
+static void split(Perft *perft, Chess *stack, int ply, int split_ply, PerftTask *task) {
+    // split_ply is at most MAX_SPLIT_PLY, the bound also shows the compiler task->moves fits
+    if (ply == split_ply || ply == MAX_SPLIT_PLY) {
+        add_task(perft, task);
+        return;
+    }
+
+    Move moves[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(&stack[ply], moves);
+
+    for (int i = 0; i < n; i++) {
+        if (!Engine_make_move(&stack[ply + 1], &stack[ply], moves[i])) {
+            continue;
+        }
+
+        if (ply == 0) {
+            task->root = perft->num_root_moves;
+            perft->root_moves[perft->num_root_moves++] = moves[i];
+        }
+
+        task->moves[ply] = moves[i];
+        task->num_moves = ply + 1;
+        split(perft, stack, ply + 1, split_ply, task);
+    }
+}
+
+static void *perft_thread(void *arg) {
+    PerftThread *thread = arg;
+    Perft *perft = thread->perft;
+
+    for (int i = atomic_fetch_add(&perft->next_task, 1); i < perft->num_tasks; i = atomic_fetch_add(&perft->next_task, 1)) {
+        const PerftTask *task = &perft->tasks[i];
+
+        Chess_copy(&thread->stack[0], &perft->root);
+
+        for (int ply = 0; ply < task->num_moves; ply++) {
+            Engine_make_move(&thread->stack[ply + 1], &thread->stack[ply], task->moves[ply]);
+        }
+
+        int remaining = perft->depth - task->num_moves;
+        uint64_t count = remaining == 0 ? 1 : count_leaves(thread, task->num_moves, remaining);
+
+        atomic_fetch_add_explicit(&perft->root_counts[task->root], count, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+// Counts the leaves of root's tree, the counts per root move are left in the returned Perft
+static Perft *perft_run(const Chess *root, int depth, int threads, int split_ply, size_t hash_mb) {
+    Perft *perft = calloc(1, sizeof(Perft));
+
+    if (perft == NULL) {
+        printf("Failed to allocate perft\n");
+        exit(1);
+    }
+
+    Engine_init_chess(&perft->root);
+    Chess_copy(&perft->root, root);
+    perft->depth = depth;
+
+    if (hash_mb > 0) {
+        size_t count = 1;
+
+        while (count * 2 * sizeof(PerftEntry) <= hash_mb * 1024 * 1024) {
+            count *= 2;
+        }
+
+        perft->cache = calloc(count, sizeof(PerftEntry));
+        perft->cache_mask = count - 1;
+
+        if (perft->cache == NULL) {
+            printf("Failed to allocate a %zu MB perft cache\n", hash_mb);
+            exit(1);
+        }
+    }
+
+    PerftThread *workers = calloc(threads, sizeof(PerftThread));
+    pthread_t *ids = calloc(threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].perft = perft;
+
+        for (int ply = 0; ply <= MAX_DEPTH; ply++) {
+            Engine_init_chess(&workers[i].stack[ply]);
+        }
+    }
+
+    // the split happens on the first thread's stack, it's free until the threads start
+    PerftTask task = {0};
+    Chess_copy(&workers[0].stack[0], &perft->root);
+    split(perft, workers[0].stack, 0, split_ply < depth ? split_ply : depth, &task);
+
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&ids[i], NULL, perft_thread, &workers[i]);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        for (int ply = 0; ply <= MAX_DEPTH; ply++) {
+            Engine_free_chess(&workers[i].stack[ply]);
+        }
+    }
+
+    free(workers);
+    free(ids);
+
+    return perft;
+}
+
+static uint64_t perft_total(Perft *perft) {
+    uint64_t total = 0;
+
+    for (int i = 0; i < perft->num_root_moves; i++) {
+        total += atomic_load(&perft->root_counts[i]);
+    }
+
+    return total;
+}
+
+static void perft_free(Perft *perft) {
+    Engine_free_chess(&perft->root);
+    free(perft->cache);
+    free(perft->tasks);
+    free(perft);
+}
+
+// Published counts (chessprogramming.org, Perft Results) the core can be held to. It has no en
+// passant and no promotion, so only depths where neither happens before the last ply are used, and
+// the en passant captures of the last ply are taken off the published count
+struct _Reference {
+    const char *name;
+    const char *fen;
+    int depth;
+    uint64_t published;
+    uint64_t en_passant;
+};
+typedef struct _Reference Reference;
+
+static const Reference References[] = {
+    {"startpos", STARTPOS_FEN, 1, 20, 0},
+    {"startpos", STARTPOS_FEN, 2, 400, 0},
+    {"startpos", STARTPOS_FEN, 3, 8902, 0},
+    {"startpos", STARTPOS_FEN, 4, 197281, 0},
+    {"startpos", STARTPOS_FEN, 5, 4865609, 258},
+    {"kiwipete", KIWIPETE_FEN, 1, 48, 0},
+    {"kiwipete", KIWIPETE_FEN, 2, 2039, 1},
+    {"position 3", POSITION3_FEN, 1, 14, 0},
+    {"position 3", POSITION3_FEN, 2, 191, 0},
+    {"position 3", POSITION3_FEN, 3, 2812, 2},
+};
+
+static int verify(int threads, int split_ply, size_t hash_mb) {
+    Game *game = Game_new();
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(References) / sizeof(References[0]); i++) {
+        const Reference *ref = &References[i];
+
+        if (!Game_load_fen(game, ref->fen)) {
+            printf("Bad FEN: %s\n", ref->fen);
+            return 1;
+        }
+
+        Perft *perft = perft_run(&game->chess, ref->depth, threads, split_ply, hash_mb);
+        uint64_t total = perft_total(perft);
+        uint64_t expected = ref->published - ref->en_passant;
+
+        perft_free(perft);
+
+        printf("%-10s depth %d: %10lu, expected %10lu", ref->name, ref->depth, (unsigned long)total, (unsigned long)expected);
+
+        if (ref->en_passant != 0) {
+            printf(" (%lu published, %lu en passant)", (unsigned long)ref->published, (unsigned long)ref->en_passant);
+        }
+
+        printf("%s\n", total == expected ? "" : "  MISMATCH");
+        failed += total != expected;
+    }
+
+    Game_free(game);
+
+    return failed != 0;
+}
+
+int main(int argc, char **argv) {
+    const char *fen = STARTPOS_FEN;
+    int depth = 0;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int split_ply = 2;
+    size_t hash_mb = 64;
+    bool divide = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--divide") == 0) {
+            divide = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--verify") == 0) {
+            check = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+
+        if (strcmp(argv[i - 1], "--depth") == 0) {
+            depth = atoi(value);
+        } else if (strcmp(argv[i - 1], "--fen") == 0) {
+            fen = value;
+        } else if (strcmp(argv[i - 1], "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(argv[i - 1], "--hash") == 0) {
+            hash_mb = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i - 1], "--split-ply") == 0) {
+            split_ply = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((!check && (depth < 1 || depth > MAX_DEPTH)) || threads < 1 || split_ply < 1 || split_ply > MAX_SPLIT_PLY) {
+        usage(argv[0]);
+        printf("Depth 1 to %d, split ply 1 to %d, at least one thread\n", MAX_DEPTH, MAX_SPLIT_PLY);
+        return 1;
+    }
+
+    if (check) {
+        return verify(threads, split_ply, hash_mb);
+    }
+
+    Game *game = Game_new();
+
+    if (!Game_load_fen(game, fen)) {
+        printf("Bad FEN: %s\n", fen);
+        return 1;
+    }
+
+    uint64_t start = Engine_now_ns();
+    Perft *perft = perft_run(&game->chess, depth, threads, split_ply, hash_mb);
+    double seconds = (Engine_now_ns() - start) / 1e9;
+
+    if (divide) {
+        for (int i = 0; i < perft->num_root_moves; i++) {
+            char uci[6];
+            Game_move_to_uci(game, perft->root_moves[i], uci);
+            printf("%s: %lu\n", uci, (unsigned long)atomic_load(&perft->root_counts[i]));
+        }
+    }
+
+    uint64_t total = perft_total(perft);
+
+    printf("%sNodes searched: %lu\n", divide ? "\n" : "", (unsigned long)total);
+    fprintf(stderr, "%d tasks on %d threads in %.2f s, %.1f Mnps\n", perft->num_tasks, threads, seconds, total / seconds / 1e6);
+
+    perft_free(perft);
+    Game_free(game);
+
+    return 0;
+}
@@ -0,0 +1,740 @@
+// Builds and queries the position index over PGN archives (PositionIndex in engine/engine.h).
+//
+//   ./bin/pgnindex build --out games.idx [--threads <n>] [--memory <mb>] [--tmp <dir>] a.pgn b.pgn
+//   ./bin/pgnindex query games.idx [--fen <fen>] [--moves e2e4 e7e5 ...] [--limit <n>]
+//
+// Build: the PGN files are mapped and cut into games, the threads replay them through
+// Game_play_move and collect a (position key, game, ply, next move) entry per position. Each
+// thread sorts its entries in runs of --memory / threads and spills them to --tmp, the runs are
+// then merged into the index, so memory stays bounded however large the archive is.
+//
+// Games are numbered in input order, the index doesn't depend on the number of threads. A game
+// stops being indexed at the first move the move generator can't play (promotions, en passant),
+// the position it reached is still indexed, with no next move, like the end of a game.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_FILES 1024
+#define MAX_QUERY_MOVES 256
+
+// read buffer of each run while merging
+#define MERGE_BUFFER (64 * 1024)
+// runs open at once while merging, more runs are merged in passes into larger runs first
+#define MERGE_FAN_IN 64
+
+struct _PgnFile {
+    const char *path;
+    const char *data;
+    size_t size;
+};
+typedef struct _PgnFile PgnFile;
+
+struct _PgnGame {
+    uint32_t file;
+    uint64_t offset;
+    uint64_t length;
+};
+typedef struct _PgnGame PgnGame;
+
+struct _Builder {
+    PgnFile files[MAX_FILES];
+    int num_files;
+
+    PgnGame *games;
+    IndexGame *index_games;
+    uint64_t num_games;
+    uint64_t capacity;
+
+    const char *tmp_dir;
+    size_t run_entries;
+
+    atomic_uint_fast64_t next_game;
+    atomic_int num_runs;
+    atomic_uint_fast64_t truncated;
+};
+typedef struct _Builder Builder;
+
+struct _BuildThread {
+    Builder *builder;
+    Game *game;
+    IndexEntry *run;
+    size_t count;
+};
+typedef struct _BuildThread BuildThread;
+
+static void usage(const char *name) {
+    printf("Usage: %s build --out <index> [--threads <n>] [--memory <mb>] [--tmp <dir>] <pgn>...\n", name);
+    printf("       %s query <index> [--fen <fen>] [--moves <uci>...] [--limit <n>]\n", name);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const IndexEntry *x = a, *y = b;
+
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+
+    if (x->game != y->game) {
+        return x->game < y->game ? -1 : 1;
+    }
+
+    return (x->ply > y->ply) - (x->ply < y->ply);
+}
+
+static void run_path(const Builder *builder, int run, char *out, size_t size) {
+    snprintf(out, size, "%s/pgnindex.%d.%d.run", builder->tmp_dir, (int)getpid(), run);
+}
+
+static void map_file(Builder *builder, const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Failed to open %s\n", path);
+        exit(1);
+    }
+
+    PgnFile *file = &builder->files[builder->num_files++];
+    file->path = path;
+    file->size = st.st_size;
+    file->data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+
+    if (file->data == MAP_FAILED) {
+        printf("Failed to map %s\n", path);
+        exit(1);
+    }
+}
+
+static void add_game(Builder *builder, uint32_t file, uint64_t offset, uint64_t length) {
+    if (builder->num_games == builder->capacity) {
+        builder->capacity = builder->capacity ? builder->capacity * 2 : 4096;
+        builder->games = realloc(builder->games, sizeof(PgnGame) * builder->capacity);
+
+        if (builder->games == NULL) {
+            printf("Failed to allocate games\n");
+            exit(1);
+        }
+    }
+
+    builder->games[builder->num_games++] = (PgnGame){.file = file, .offset = offset, .length = length};
+}
+
+// A game starts at the first line of the file and at every tag line that follows movetext
+static void split_games(Builder *builder, uint32_t file_index) {
+    const PgnFile *file = &builder->files[file_index];
+    uint64_t start = 0;
+    bool movetext = false;
+
+    for (uint64_t line = 0; line < file->size;) {
+        const char *end = memchr(file->data + line, '\n', file->size - line);
+        uint64_t next = end != NULL ? (uint64_t)(end - file->data) + 1 : file->size;
+
+        if (file->data[line] == '[') {
+            if (movetext) {
+                add_game(builder, file_index, start, line - start);
+                start = line;
+                movetext = false;
+            }
+        } else if (!(file->data[line] == '\n' || file->data[line] == '\r')) {
+            movetext = true;
+        }
+
+        line = next;
+    }
+
+    if (movetext) {
+        add_game(builder, file_index, start, file->size - start);
+    }
+}
+
+static void flush_run(BuildThread *thread) {
+    if (thread->count == 0) {
+        return;
+    }
+
+    Builder *builder = thread->builder;
+    qsort(thread->run, thread->count, sizeof(IndexEntry), compare_entries);
+
+    char path[512];
+    run_path(builder, atomic_fetch_add(&builder->num_runs, 1), path, sizeof(path));
+
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL || fwrite(thread->run, sizeof(IndexEntry), thread->count, f) != thread->count || fclose(f) != 0) {
+        printf("Failed to write %s\n", path);
+        exit(1);
+    }
+
+    thread->count = 0;
+}
+
+static void add_entry(BuildThread *thread, uint64_t key, uint32_t game, int ply, uint16_t next_move) {
+    if (thread->count == thread->builder->run_entries) {
+        flush_run(thread);
+    }
+
+    thread->run[thread->count++] = (IndexEntry){.key = key, .game = game, .ply = (uint16_t)ply, .next_move = next_move};
+}
+
+static bool is_result(const char *token, size_t len) {
+    return (len == 3 && (memcmp(token, "1-0", 3) == 0 || memcmp(token, "0-1", 3) == 0)) || (len == 7 && memcmp(token, "1/2-1/2", 7) == 0) ||
+           (len == 1 && token[0] == '*');
+}
+
+// Replays one game, adding an entry for every position it reaches
+static void index_game(BuildThread *thread, uint32_t id) {
+    const PgnGame *pgn = &thread->builder->games[id];
+    const char *p = thread->builder->files[pgn->file].data + pgn->offset;
+    const char *end = p + pgn->length;
+    Game *game = thread->game;
+
+    Game_reset(game);
+
+    bool ok = true;
+    bool loaded = true;
+
+    while (p < end && ok) {
+        char c = *p;
+
+        if (c == '[') {
+            // only the FEN tag matters, for games that don't start from the initial position
+            const char *line_end = memchr(p, '\n', end - p);
+            line_end = line_end != NULL ? line_end : end;
+
+            if (line_end - p > 6 && memcmp(p, "[FEN \"", 6) == 0) {
+                char fen[128];
+                const char *quote = memchr(p + 6, '"', line_end - p - 6);
+                int len = quote != NULL ? (int)(quote - p - 6) : 0;
+
+                snprintf(fen, sizeof(fen), "%.*s", len, p + 6);
+                ok = loaded = Game_load_fen(game, fen);
+            }
+
+            p = line_end;
+        } else if (c == '{') {
+            const char *close = memchr(p, '}', end - p);
+            p = close != NULL ? close + 1 : end;
+        } else if (c == ';') {
+            const char *line_end = memchr(p, '\n', end - p);
+            p = line_end != NULL ? line_end : end;
+        } else if (c == '(') {
+            // variations, possibly nested
+            int depth = 0;
+
+            for (; p < end; p++) {
+                depth += *p == '(';
+                depth -= *p == ')';
+
+                if (depth == 0) {
+                    p++;
+                    break;
+                }
+            }
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ')') {
+            p++;
+        } else {
+            const char *token = p;
+
+            while (p < end && !strchr(" \t\r\n{}();", *p)) {
+                p++;
+            }
+
+            size_t len = p - token;
+
+            if (is_result(token, len)) {
+                break;
+            }
+
+            if (token[0] == '$') {
+                continue;
+            }
+
+            // move numbers, "12." "12..." or glued to the move "12.e4", castling can start with 0
+            if (token[0] >= '0' && token[0] <= '9' && !(len >= 3 && memcmp(token, "0-0", 3) == 0)) {
+                while (len > 0 && ((*token >= '0' && *token <= '9') || *token == '.')) {
+                    token++;
+                    len--;
+                }
+
+                if (len == 0) {
+                    continue;
+                }
+            }
+
+            char san[16];
+            snprintf(san, sizeof(san), "%.*s", (int)(len < sizeof(san) ? len : sizeof(san) - 1), token);
+
+            Move move;
+            uint64_t key = PositionIndex_key(&game->chess);
+            int ply = game->ply;
+
+            if (!Game_parse_san(game, san, &move)) {
+                ok = false;
+                break;
+            }
+
+            uint16_t encoded = PositionIndex_encode_move(&game->chess, move);
+
+            if (!Game_play_move(game, move)) {
+                ok = false;
+                break;
+            }
+
+            add_entry(thread, key, id, ply, encoded);
+        }
+    }
+
+    // a failed move leaves the game where it was, a failed FEN doesn't leave a position to index
+    if (loaded) {
+        add_entry(thread, PositionIndex_key(&game->chess), id, game->ply, INDEX_NO_MOVE);
+    }
+
+    if (!ok) {
+        atomic_fetch_add(&thread->builder->truncated, 1);
+    }
+
+    thread->builder->index_games[id] = (IndexGame){.offset = pgn->offset, .file = pgn->file, .plies = game->ply};
+}
+
+static void *build_thread(void *arg) {
+    BuildThread *thread = arg;
+    Builder *builder = thread->builder;
+
+    for (uint64_t id = atomic_fetch_add(&builder->next_game, 1); id < builder->num_games; id = atomic_fetch_add(&builder->next_game, 1)) {
+        index_game(thread, (uint32_t)id);
+    }
+
+    flush_run(thread);
+
+    return NULL;
+}
+
+struct _RunReader {
+    FILE *f;
+    IndexEntry head;
+};
+typedef struct _RunReader RunReader;
+
+static bool run_next(RunReader *run) { return fread(&run->head, sizeof(IndexEntry), 1, run->f) == 1; }
+
+static void heap_down(RunReader **heap, int count, int i) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+
+        if (left < count && compare_entries(&heap[left]->head, &heap[smallest]->head) < 0) {
+            smallest = left;
+        }
+
+        if (right < count && compare_entries(&heap[right]->head, &heap[smallest]->head) < 0) {
+            smallest = right;
+        }
+
+        if (smallest == i) {
+            return;
+        }
+
+        RunReader *tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void write_or_die(FILE *f, const void *data, size_t size, size_t count) {
+    if (fwrite(data, size, count, f) != count) {
+        printf("Failed to write the index\n");
+        exit(1);
+    }
+}
+
+// Opens runs [first, first + count) into a heap on their first entry, deleting the files on the way
+static int open_runs(const Builder *builder, int first, int count, RunReader *runs, RunReader **heap) {
+    int heap_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        char path[512];
+        run_path(builder, first + i, path, sizeof(path));
+
+        runs[i].f = fopen(path, "rb");
+
+        if (runs[i].f == NULL) {
+            printf("Failed to open %s\n", path);
+            exit(1);
+        }
+
+        setvbuf(runs[i].f, NULL, _IOFBF, MERGE_BUFFER);
+        unlink(path);
+
+        if (run_next(&runs[i])) {
+            heap[heap_count++] = &runs[i];
+        } else {
+            fclose(runs[i].f);
+        }
+    }
+
+    for (int i = heap_count / 2 - 1; i >= 0; i--) {
+        heap_down(heap, heap_count, i);
+    }
+
+    return heap_count;
+}
+
+// Takes the smallest entry off the heap, closing its run once it's drained
+static IndexEntry heap_pop(RunReader **heap, int *heap_count) {
+    RunReader *run = heap[0];
+    IndexEntry entry = run->head;
+
+    if (!run_next(run)) {
+        fclose(run->f);
+        heap[0] = heap[--*heap_count];
+    }
+
+    heap_down(heap, *heap_count, 0);
+
+    return entry;
+}
+
+// Merges runs [first, first + count) into the run numbered into
+static void merge_pass(const Builder *builder, int first, int count, int into, RunReader *runs, RunReader **heap) {
+    char path[512];
+    run_path(builder, into, path, sizeof(path));
+
+    FILE *out = fopen(path, "wb");
+
+    if (out == NULL) {
+        printf("Failed to create %s\n", path);
+        exit(1);
+    }
+
+    setvbuf(out, NULL, _IOFBF, MERGE_BUFFER);
+
+    int heap_count = open_runs(builder, first, count, runs, heap);
+
+    while (heap_count > 0) {
+        IndexEntry entry = heap_pop(heap, &heap_count);
+
+        if (fwrite(&entry, sizeof(IndexEntry), 1, out) != 1) {
+            printf("Failed to write %s\n", path);
+            exit(1);
+        }
+    }
+
+    if (fclose(out) != 0) {
+        printf("Failed to write %s\n", path);
+        exit(1);
+    }
+}
+
+// k-way merge of the sorted runs into the index file, deleting them on the way. At most
+// MERGE_FAN_IN runs are open at once, so the number of runs isn't bounded by the file limit:
+// the oldest runs are merged into a new run until few enough are left for the final merge
+static uint64_t merge_runs(Builder *builder, const char *out_path) {
+    int first = 0, last = atomic_load(&builder->num_runs);
+    RunReader *runs = calloc(MERGE_FAN_IN, sizeof(RunReader));
+    RunReader **heap = calloc(MERGE_FAN_IN, sizeof(RunReader *));
+    uint64_t *directory = calloc((1ull << INDEX_DIRECTORY_BITS) + 1, sizeof(uint64_t));
+
+    if (runs == NULL || heap == NULL || directory == NULL) {
+        printf("Failed to allocate the merge\n");
+        exit(1);
+    }
+
+    for (; last - first > MERGE_FAN_IN; first += MERGE_FAN_IN) {
+        merge_pass(builder, first, MERGE_FAN_IN, last++, runs, heap);
+    }
+
+    FILE *out = fopen(out_path, "wb");
+
+    if (out == NULL) {
+        printf("Failed to create %s\n", out_path);
+        exit(1);
+    }
+
+    int heap_count = open_runs(builder, first, last - first, runs, heap);
+
+    IndexHeader header = {.version = INDEX_VERSION, .num_files = builder->num_files, .num_games = builder->num_games};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.entries_offset = sizeof(IndexHeader);
+
+    write_or_die(out, &header, sizeof(header), 1);
+
+    uint64_t count = 0;
+    uint64_t next_bucket = 0;
+
+    while (heap_count > 0) {
+        IndexEntry entry = heap_pop(heap, &heap_count);
+        uint64_t bucket = entry.key >> INDEX_DIRECTORY_SHIFT;
+
+        for (; next_bucket <= bucket; next_bucket++) {
+            directory[next_bucket] = count;
+        }
+
+        write_or_die(out, &entry, sizeof(IndexEntry), 1);
+        count++;
+    }
+
+    for (; next_bucket <= 1ull << INDEX_DIRECTORY_BITS; next_bucket++) {
+        directory[next_bucket] = count;
+    }
+
+    header.num_entries = count;
+    header.directory_offset = header.entries_offset + count * sizeof(IndexEntry);
+    write_or_die(out, directory, sizeof(uint64_t), (1ull << INDEX_DIRECTORY_BITS) + 1);
+
+    header.games_offset = header.directory_offset + ((1ull << INDEX_DIRECTORY_BITS) + 1) * sizeof(uint64_t);
+    write_or_die(out, builder->index_games, sizeof(IndexGame), builder->num_games);
+
+    header.files_offset = header.games_offset + builder->num_games * sizeof(IndexGame);
+
+    for (int i = 0; i < builder->num_files; i++) {
+        char name[INDEX_FILE_NAME] = {0};
+        snprintf(name, sizeof(name), "%s", builder->files[i].path);
+        write_or_die(out, name, sizeof(name), 1);
+    }
+
+    if (fseek(out, 0, SEEK_SET) != 0) {
+        printf("Failed to write the index\n");
+        exit(1);
+    }
+
+    write_or_die(out, &header, sizeof(header), 1);
+
+    if (fclose(out) != 0) {
+        printf("Failed to write the index\n");
+        exit(1);
+    }
+
+    free(runs);
+    free(heap);
+    free(directory);
+
+    return count;
+}
+
+static int build(int argc, char **argv) {
+    Builder *builder = calloc(1, sizeof(Builder));
+    const char *out_path = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t memory_mb = 1024;
+
+    builder->tmp_dir = "/tmp";
+
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            if (builder->num_files == MAX_FILES) {
+                printf("At most %d PGN files\n", MAX_FILES);
+                return 1;
+            }
+
+            map_file(builder, argv[i]);
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+
+        if (strcmp(argv[i - 1], "--out") == 0) {
+            out_path = value;
+        } else if (strcmp(argv[i - 1], "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(argv[i - 1], "--memory") == 0) {
+            memory_mb = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i - 1], "--tmp") == 0) {
+            builder->tmp_dir = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (out_path == NULL || builder->num_files == 0 || threads < 1 || memory_mb < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint64_t start = Engine_now_ns();
+
+    for (int i = 0; i < builder->num_files; i++) {
+        split_games(builder, i);
+    }
+
+    builder->index_games = calloc(builder->num_games + 1, sizeof(IndexGame));
+    builder->run_entries = memory_mb * 1024 * 1024 / threads / sizeof(IndexEntry);
+
+    BuildThread *workers = calloc(threads, sizeof(BuildThread));
+    pthread_t *ids = calloc(threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].builder = builder;
+        workers[i].game = Game_new();
+        workers[i].run = malloc(builder->run_entries * sizeof(IndexEntry));
+
+        if (workers[i].run == NULL) {
+            printf("Failed to allocate %zu MB of run buffers\n", memory_mb);
+            return 1;
+        }
+
+        pthread_create(&ids[i], NULL, build_thread, &workers[i]);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        Game_free(workers[i].game);
+        free(workers[i].run);
+    }
+
+    uint64_t replayed = Engine_now_ns();
+    uint64_t entries = merge_runs(builder, out_path);
+
+    printf("%lu games (%lu cut short), %lu positions, %d runs: replay %.2f s, merge %.2f s\n", (unsigned long)builder->num_games,
+           (unsigned long)atomic_load(&builder->truncated), (unsigned long)entries, atomic_load(&builder->num_runs), (replayed - start) / 1e9,
+           (Engine_now_ns() - replayed) / 1e9);
+
+    for (int i = 0; i < builder->num_files; i++) {
+        if (builder->files[i].data != NULL) {
+            munmap((void *)builder->files[i].data, builder->files[i].size);
+        }
+    }
+
+    free(workers);
+    free(ids);
+    free(builder->games);
+    free(builder->index_games);
+    free(builder);
+
+    return 0;
+}
+
+static int compare_counts(const void *a, const void *b) {
+    const uint32_t *x = a, *y = b;
+    return (x[1] < y[1]) - (x[1] > y[1]);
+}
+
+static int query(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    PositionIndex index;
+
+    if (!PositionIndex_open(&index, argv[2])) {
+        return 1;
+    }
+
+    Game *game = Game_new();
+    int limit = 10;
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            if (!Game_load_fen(game, argv[++i])) {
+                printf("Bad FEN: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--moves") == 0) {
+            for (; i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0; i++) {
+                Move move;
+
+                if (!Game_parse_uci(game, argv[i + 1], &move) || !Game_play_move(game, move)) {
+                    printf("Illegal move: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    uint64_t key = PositionIndex_key(&game->chess);
+    const IndexEntry *entries;
+
+    uint64_t start = Engine_now_ns();
+    size_t count = PositionIndex_find(&index, key, &entries);
+    uint64_t elapsed = Engine_now_ns() - start;
+
+    // the first lookup pays for the page faults, repeat it to show the warm cost too
+    start = Engine_now_ns();
+
+    for (int i = 0; i < 1000; i++) {
+        count = PositionIndex_find(&index, key ^ (uint64_t)(i & 1), &entries);
+    }
+
+    count = PositionIndex_find(&index, key, &entries);
+    double warm_us = (Engine_now_ns() - start) / 1000.0 / 1000.0;
+
+    printf("%zu occurrences, lookup %.1f us cold, %.2f us warm\n", count, elapsed / 1000.0, warm_us);
+
+    // next moves by popularity, [move, count]
+    uint32_t (*moves)[2] = calloc(count + 1, sizeof(*moves));
+    int num_moves = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int m = 0;
+
+        while (m < num_moves && moves[m][0] != entries[i].next_move) {
+            m++;
+        }
+
+        if (m == num_moves) {
+            moves[num_moves][0] = entries[i].next_move;
+            moves[num_moves++][1] = 0;
+        }
+
+        moves[m][1]++;
+    }
+
+    qsort(moves, num_moves, sizeof(*moves), compare_counts);
+
+    for (int m = 0; m < num_moves; m++) {
+        char name[6];
+        PositionIndex_move_name((uint16_t)moves[m][0], name);
+        printf("  %-5s %u\n", name, moves[m][1]);
+    }
+
+    for (size_t i = 0; i < count && (int)i < limit; i++) {
+        const IndexGame *g = &index.games[entries[i].game];
+        char name[6];
+        PositionIndex_move_name(entries[i].next_move, name);
+        printf("game %u (%s @ %lu, %u plies) ply %u next %s\n", entries[i].game, index.files[g->file], (unsigned long)g->offset, g->plies,
+               entries[i].ply, name);
+    }
+
+    free(moves);
+    Game_free(game);
+    PositionIndex_close(&index);
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "build") == 0) {
+        return build(argc, argv);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "query") == 0) {
+        return query(argc, argv);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,241 @@
+// Headless board thumbnails, no window: every instance draws with an SDL software renderer on
+// its own surface.
+//
+//   ./bin/thumbnail --size 256 --instances 8 --out thumbs positions.fen
+//
+// One FEN per line (lines starting with '#' are skipped), images are written as
+// <out>/<n>.png, numbered from 0 in input order, or as raw RGBA pixels (<n>.rgba, size * size * 4
+// bytes) with --raw. Without --out nothing is written, the images only end up in the instances'
+// buffers, --repeat renders the list that many times. Sprites and labels are embedded in the
+// binary and every instance keeps them as textures, so an image costs only the drawing and the
+// encoding.
+// Prints the number of images per second at the end.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../board_view.h"
+#include "../engine/engine.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_LINE 512
+
+struct _Batch {
+    char (*fens)[128];
+    int count;
+    int capacity;
+
+    int size;
+    int repeat;
+    const char *out_dir;
+    bool raw;
+
+    BoardAssets assets;
+    // textures are created from the shared assets one instance at a time
+    pthread_mutex_t init_lock;
+
+    atomic_long next;
+    atomic_long failed;
+};
+typedef struct _Batch Batch;
+
+static void usage(const char *name) {
+    printf("Usage: %s [--size <px>] [--instances <n>] [--out <dir>] [--raw] [--repeat <n>] <file>...\n", name);
+}
+
+static void load_fens(Batch *batch, const char *path) {
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        printf("Failed to open %s\n", path);
+        exit(1);
+    }
+
+    char line[MAX_LINE];
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+
+        if (batch->count == batch->capacity) {
+            batch->capacity = batch->capacity ? batch->capacity * 2 : 1024;
+            batch->fens = realloc(batch->fens, sizeof(*batch->fens) * batch->capacity);
+
+            if (batch->fens == NULL) {
+                printf("Failed to allocate positions\n");
+                exit(1);
+            }
+        }
+
+        snprintf(batch->fens[batch->count++], sizeof(*batch->fens), "%.*s", (int)sizeof(*batch->fens) - 1, line);
+    }
+
+    fclose(f);
+}
+
+static bool write_image(const Batch *batch, SDL_Surface *surface, long index) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%ld.%s", batch->out_dir, index, batch->raw ? "rgba" : "png");
+
+    if (!batch->raw) {
+        return IMG_SavePNG(surface, path) == 0;
+    }
+
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+
+    for (int row = 0; row < surface->h && ok; row++) {
+        ok = fwrite((const char *)surface->pixels + (size_t)row * surface->pitch, 4, surface->w, f) == (size_t)surface->w;
+    }
+
+    return fclose(f) == 0 && ok;
+}
+
+static void *render_thread(void *arg) {
+    Batch *batch = arg;
+    // the board fills the image, whatever doesn't divide into cells stays background
+    int cell_size = batch->size / CHESS_BOARD_COLS;
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, batch->size, batch->size, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer *renderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    BoardView view = {0};
+
+    pthread_mutex_lock(&batch->init_lock);
+    bool ok = renderer != NULL && BoardView_init(&view, renderer, &batch->assets, cell_size);
+    pthread_mutex_unlock(&batch->init_lock);
+
+    if (!ok) {
+        printf("Failed to create a renderer. Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+    Game *game = Game_new();
+    long total = (long)batch->count * batch->repeat;
+
+    for (long i = atomic_fetch_add(&batch->next, 1); i < total; i = atomic_fetch_add(&batch->next, 1)) {
+        if (!Game_load_fen(game, batch->fens[i % batch->count])) {
+            atomic_fetch_add(&batch->failed, 1);
+            continue;
+        }
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        BoardView_draw(&view, &game->chess, 0, 0, (Pos){-1, -1});
+
+        if (batch->out_dir != NULL && !write_image(batch, surface, i)) {
+            atomic_fetch_add(&batch->failed, 1);
+        }
+    }
+
+    Game_free(game);
+    BoardView_free(&view);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    Batch batch = {.size = 256, .repeat = 1};
+    int instances = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            first_file = i;
+            break;
+        }
+
+        if (strcmp(argv[i], "--raw") == 0) {
+            batch.raw = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+
+        if (strcmp(argv[i - 1], "--size") == 0) {
+            batch.size = atoi(value);
+        } else if (strcmp(argv[i - 1], "--instances") == 0) {
+            instances = atoi(value);
+        } else if (strcmp(argv[i - 1], "--out") == 0) {
+            batch.out_dir = value;
+        } else if (strcmp(argv[i - 1], "--repeat") == 0) {
+            batch.repeat = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (first_file == argc || instances < 1 || batch.repeat < 1 || batch.size < CHESS_BOARD_COLS * 5) {
+        usage(argv[0]);
+        printf("At least one instance, images of at least %d pixels\n", CHESS_BOARD_COLS * 5);
+        return 1;
+    }
+
+    for (int i = first_file; i < argc; i++) {
+        load_fens(&batch, argv[i]);
+    }
+
+    if (batch.count == 0) {
+        printf("No positions\n");
+        return 1;
+    }
+
+    if (SDL_Init(0) < 0) {
+        printf("SDL initialization failed! %s\n", SDL_GetError());
+        return 1;
+    }
+
+    if (!BoardAssets_init(&batch.assets)) {
+        return 1;
+    }
+
+    pthread_mutex_init(&batch.init_lock, NULL);
+
+    uint64_t start = Engine_now_ns();
+    pthread_t *workers = calloc(instances, sizeof(pthread_t));
+
+    for (int i = 0; i < instances; i++) {
+        pthread_create(&workers[i], NULL, render_thread, &batch);
+    }
+
+    for (int i = 0; i < instances; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    double seconds = (Engine_now_ns() - start) / 1e9;
+    long images = (long)batch.count * batch.repeat - atomic_load(&batch.failed);
+
+    printf("%ld images of %dx%d (%ld failed) on %d instances in %.2f s, %.0f images/s\n", images, batch.size, batch.size,
+           atomic_load(&batch.failed), instances, seconds, images / seconds);
+
+    pthread_mutex_destroy(&batch.init_lock);
+    BoardAssets_free(&batch.assets);
+    SDL_Quit();
+    free(workers);
+    free(batch.fens);
+
+    return 0;
+}
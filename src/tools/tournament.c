@@ -0,0 +1,426 @@
+// Headless self-play tournament between two engine configurations.
+// Plays one game per thread, streams PGN and stops early once the SPRT is decided. The core has no
+// promotions: a game is stopped before one and written with result "*", it doesn't count for the
+// SPRT. An illegal engine move loses the game.
+//
+//   ./bin/tournament -a name=base,depth=3 -b name=new,depth=3,nnue --games 2000 --pgn games.pgn
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../engine/engine.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_OPENINGS 4096
+#define MAX_OPENING_LENGTH 256
+// headers plus at most 16 bytes per ply ("512. Qxe7+" and a separator)
+#define PGN_MAX_LENGTH (512 + GAME_MAX_PLIES * 16)
+
+// used when no --openings file is given, one line of moves per opening
+static const char *DefaultOpenings[] = {
+    "e2e4 e7e5 g1f3 b8c6", "e2e4 c7c5 g1f3 d7d6", "e2e4 e7e6 d2d4 d7d5", "e2e4 c7c6 d2d4 d7d5", "d2d4 d7d5 c2c4 e7e6",
+    "d2d4 g8f6 c2c4 e7e6", "d2d4 g8f6 c2c4 g7g6", "c2c4 e7e5 b1c3 g8f6", "g1f3 d7d5 g2g3 g8f6", "e2e4 d7d6 d2d4 g8f6",
+    "d2d4 d7d5 c2c4 c7c6", "e2e4 e7e5 f1c4 g8f6", "e2e4 g7g6 d2d4 f8g7", "c2c4 c7c5 g1f3 b8c6", "d2d4 f7f5 g2g3 g8f6",
+    "e2e4 e7e5 g1f3 g8f6",
+};
+
+struct _Tournament {
+    EngineConfig engines[2];
+
+    char openings[MAX_OPENINGS][MAX_OPENING_LENGTH];
+    int num_openings;
+
+    int num_games;
+    int max_plies;
+
+    double elo0, elo1, alpha, beta;
+
+    FILE *pgn;
+
+    atomic_int next_game;
+    atomic_bool stop;
+
+    // everything below is guarded by lock, counts are from engine a's point of view
+    pthread_mutex_t lock;
+    int wins, losses, draws;
+    // games stopped at a promotion, left out of the counts and the SPRT
+    int unfinished;
+
+    // search statistics of all threads, merged as the workers finish
+    SearchStats stats[2];
+};
+typedef struct _Tournament Tournament;
+
+static double elo_to_score(double elo) { return 1.0 / (1.0 + pow(10.0, -elo / 400.0)); }
+
+static double score_to_elo(double score) { return -400.0 * log10(1.0 / score - 1.0); }
+
+// Log likelihood ratio of H1 (elo1) vs H0 (elo0), normal approximation of the trinomial model
+static double sprt_llr(int wins, int losses, int draws, double elo0, double elo1) {
+    int n = wins + losses + draws;
+
+    if (wins == 0 || losses == 0 || n == 0) {
+        return 0.0;
+    }
+
+    double score = (wins + 0.5 * draws) / n;
+    double variance = (wins * pow(1.0 - score, 2) + losses * pow(score, 2) + draws * pow(0.5 - score, 2)) / n;
+
+    double s0 = elo_to_score(elo0);
+    double s1 = elo_to_score(elo1);
+
+    return (s1 - s0) * (2.0 * (wins + 0.5 * draws) - n * (s0 + s1)) / (2.0 * variance);
+}
+
+// Formats the game as PGN into out (PGN_MAX_LENGTH bytes), returns its length. Runs in the worker,
+// only the finished text is written under the lock
+static int format_pgn(const Tournament *t, Game *game, int round, int white, enum GameResult result, enum GameEndReason reason, char *out) {
+    char line[128] = {0};
+    int line_len = 0;
+    int len = 0;
+
+    // moves are re-played to get the SAN for each of them
+    Move moves[GAME_MAX_PLIES];
+    int n = game->ply;
+    memcpy(moves, game->moves, sizeof(Move) * n);
+
+    Game_reset(game);
+
+    len += snprintf(out + len, PGN_MAX_LENGTH - len, "[Event \"Self-play tournament\"]\n[Site \"local\"]\n[Round \"%d\"]\n", round);
+    len += snprintf(out + len, PGN_MAX_LENGTH - len, "[White \"%s\"]\n[Black \"%s\"]\n", t->engines[white].name, t->engines[1 - white].name);
+    len += snprintf(out + len, PGN_MAX_LENGTH - len, "[Result \"%s\"]\n[Termination \"%s\"]\n\n", Game_result_string(result),
+                    Game_end_reason_string(reason));
+
+    for (int i = 0; i < n; i++) {
+        char token[16];
+        char san[8];
+
+        Game_move_to_san(game, moves[i], san);
+        Game_play_move(game, moves[i]);
+
+        int token_len = i % 2 == 0 ? snprintf(token, sizeof(token), "%d. %s", i / 2 + 1, san) : snprintf(token, sizeof(token), "%s", san);
+
+        if (line_len + token_len + 1 > 79) {
+            len += snprintf(out + len, PGN_MAX_LENGTH - len, "%s\n", line);
+            line_len = 0;
+        }
+
+        line_len += sprintf(line + line_len, "%s%s", line_len ? " " : "", token);
+    }
+
+    len += snprintf(out + len, PGN_MAX_LENGTH - len, "%s%s%s\n\n", line, line_len ? " " : "", Game_result_string(result));
+
+    return len;
+}
+
+// result is GameOngoing for a game stopped at a promotion, it's only written to the PGN. pgn is the
+// game's text from format_pgn, NULL without --pgn
+static void record_result(Tournament *t, int white, enum GameResult result, const char *pgn, int pgn_len) {
+    pthread_mutex_lock(&t->lock);
+
+    // white = index of the engine playing white
+    if (result == GameOngoing) {
+        t->unfinished++;
+    } else if (result == GameDraw) {
+        t->draws++;
+    } else if ((result == GameWhiteWins) == (white == 0)) {
+        t->wins++;
+    } else {
+        t->losses++;
+    }
+
+    if (pgn != NULL) {
+        fwrite(pgn, 1, pgn_len, t->pgn);
+        fflush(t->pgn);
+    }
+
+    int n = t->wins + t->losses + t->draws;
+
+    if (n == 0) {
+        pthread_mutex_unlock(&t->lock);
+        return;
+    }
+
+    double score = (t->wins + 0.5 * t->draws) / n;
+    double elo = score <= 0.0 ? -INFINITY : (score >= 1.0 ? INFINITY : score_to_elo(score));
+    double llr = sprt_llr(t->wins, t->losses, t->draws, t->elo0, t->elo1);
+    double lower = log(t->beta / (1.0 - t->alpha));
+    double upper = log((1.0 - t->beta) / t->alpha);
+
+    printf("Games: %d  W: %d L: %d D: %d  Elo: %+.1f  LLR: %.2f (%.2f, %.2f)  Promotions: %d\n", n, t->wins, t->losses, t->draws, elo, llr, lower,
+           upper, t->unfinished);
+
+    if (llr >= upper || llr <= lower) {
+        printf("SPRT: %s accepted\n", llr >= upper ? "H1" : "H0");
+        atomic_store(&t->stop, true);
+    }
+
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void *worker(void *arg) {
+    Tournament *t = arg;
+
+    Engine *engines[2] = {Engine_new(t->engines[0]), Engine_new(t->engines[1])};
+    Game *game = Game_new();
+    SearchStats stats[2] = {0};
+    char *pgn = t->pgn != NULL ? malloc(PGN_MAX_LENGTH) : NULL;
+
+    if (t->pgn != NULL && pgn == NULL) {
+        printf("Failed to allocate the PGN buffer\n");
+        exit(1);
+    }
+
+    while (!atomic_load(&t->stop)) {
+        int idx = atomic_fetch_add(&t->next_game, 1);
+
+        if (idx >= t->num_games) {
+            break;
+        }
+
+        // every opening is played twice, once with each color
+        int white = idx % 2;
+        char opening[MAX_OPENING_LENGTH];
+        snprintf(opening, sizeof(opening), "%s", t->openings[(idx / 2) % t->num_openings]);
+
+        Game_reset(game);
+
+        char *save = NULL;
+        for (char *token = strtok_r(opening, " \t\n", &save); token != NULL; token = strtok_r(NULL, " \t\n", &save)) {
+            Move move;
+
+            if (!Game_parse_uci(game, token, &move) || !Game_play_move(game, move)) {
+                printf("Illegal opening move %s, playing on from here\n", token);
+                break;
+            }
+        }
+
+        enum GameEndReason reason;
+        enum GameResult result;
+
+        while ((result = Game_result(game, &reason)) == GameOngoing && game->ply < t->max_plies) {
+            int side = game->chess.current_turn == ColorWhite ? white : 1 - white;
+
+            SearchResult search = Engine_search(engines[side], &game->chess, game->history, game->ply + 1);
+            SearchStats_merge(&stats[side], &engines[side]->stats);
+
+            // the core can't play a promotion, what followed wouldn't be chess
+            if (Game_is_promotion(game, search.best_move)) {
+                reason = GameEndPromotion;
+                break;
+            }
+
+            if (!Game_play_move(game, search.best_move)) {
+                printf("Engine %s played an illegal move\n", t->engines[side].name);
+                result = game->chess.current_turn == ColorWhite ? GameBlackWins : GameWhiteWins;
+                reason = GameEndIllegalMove;
+                break;
+            }
+        }
+
+        if (result == GameOngoing && reason != GameEndPromotion) {
+            result = GameDraw;
+            reason = GameEndMaxPlies;
+        }
+
+        int pgn_len = t->pgn != NULL ? format_pgn(t, game, idx + 1, white, result, reason, pgn) : 0;
+
+        record_result(t, white, result, t->pgn != NULL ? pgn : NULL, pgn_len);
+    }
+
+    pthread_mutex_lock(&t->lock);
+    SearchStats_merge(&t->stats[0], &stats[0]);
+    SearchStats_merge(&t->stats[1], &stats[1]);
+    pthread_mutex_unlock(&t->lock);
+
+    Engine_free(engines[0]);
+    Engine_free(engines[1]);
+    Game_free(game);
+    free(pgn);
+
+    return NULL;
+}
+
+static void load_openings(Tournament *t, const char *path) {
+    if (path == NULL) {
+        t->num_openings = sizeof(DefaultOpenings) / sizeof(DefaultOpenings[0]);
+
+        for (int i = 0; i < t->num_openings; i++) {
+            snprintf(t->openings[i], MAX_OPENING_LENGTH, "%s", DefaultOpenings[i]);
+        }
+
+        return;
+    }
+
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        printf("Failed to open %s\n", path);
+        exit(1);
+    }
+
+    while (t->num_openings < MAX_OPENINGS && fgets(t->openings[t->num_openings], MAX_OPENING_LENGTH, f) != NULL) {
+        if (t->openings[t->num_openings][0] != '#' && t->openings[t->num_openings][0] != '\n') {
+            t->num_openings++;
+        }
+    }
+
+    fclose(f);
+
+    if (t->num_openings == 0) {
+        printf("No openings in %s\n", path);
+        exit(1);
+    }
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s -a <engine> -b <engine> [options]\n", prog);
+    printf("  engine: name=<name>,depth=<n>,nodes=<n>,nnue,stats=<file>\n");
+    printf("  --games <n>          number of games (default 1000)\n");
+    printf("  --threads <n>        worker threads (default: all cores)\n");
+    printf("  --openings <file>    one opening per line, moves like e2e4 e7e5\n");
+    printf("  --pgn <file>         stream games to this file\n");
+    printf("  --nnue <file>        network for engines with the nnue option\n");
+    printf("  --max-plies <n>      adjudicate a draw after this many plies (default 400)\n");
+    printf("  --stats <file>       append the search statistics of each engine over all games\n");
+    printf("  --elo0 <elo> --elo1 <elo> --alpha <a> --beta <b>   SPRT bounds (default 0 5 0.05 0.05)\n");
+}
+
+int main(int argc, char **argv) {
+    Tournament *t = calloc(1, sizeof(Tournament));
+
+    if (t == NULL) {
+        printf("Failed to allocate tournament\n");
+        return 1;
+    }
+
+    t->num_games = 1000;
+    t->max_plies = 400;
+    t->elo0 = 0;
+    t->elo1 = 5;
+    t->alpha = 0.05;
+    t->beta = 0.05;
+
+    const char *openings_path = NULL;
+    const char *pgn_path = NULL;
+    const char *stats_path = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    bool have_engine[2] = {false, false};
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        i++;
+
+        if (strcmp(arg, "-a") == 0 || strcmp(arg, "-b") == 0) {
+            int idx = arg[1] - 'a';
+
+            if (!Engine_parse_config(value, &t->engines[idx])) {
+                return 1;
+            }
+
+            have_engine[idx] = true;
+        } else if (strcmp(arg, "--games") == 0) {
+            t->num_games = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--openings") == 0) {
+            openings_path = value;
+        } else if (strcmp(arg, "--pgn") == 0) {
+            pgn_path = value;
+        } else if (strcmp(arg, "--nnue") == 0) {
+            if (!NNUE_load(value)) {
+                return 1;
+            }
+        } else if (strcmp(arg, "--stats") == 0) {
+            stats_path = value;
+        } else if (strcmp(arg, "--max-plies") == 0) {
+            t->max_plies = atoi(value);
+        } else if (strcmp(arg, "--elo0") == 0) {
+            t->elo0 = atof(value);
+        } else if (strcmp(arg, "--elo1") == 0) {
+            t->elo1 = atof(value);
+        } else if (strcmp(arg, "--alpha") == 0) {
+            t->alpha = atof(value);
+        } else if (strcmp(arg, "--beta") == 0) {
+            t->beta = atof(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!have_engine[0] || !have_engine[1]) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (t->max_plies > GAME_MAX_PLIES) {
+        t->max_plies = GAME_MAX_PLIES;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    load_openings(t, openings_path);
+
+    if (pgn_path != NULL) {
+        t->pgn = fopen(pgn_path, "w");
+
+        if (t->pgn == NULL) {
+            printf("Failed to open %s\n", pgn_path);
+            return 1;
+        }
+    }
+
+    pthread_mutex_init(&t->lock, NULL);
+    atomic_init(&t->next_game, 0);
+    atomic_init(&t->stop, false);
+
+    printf("%s vs %s, %d games on %d threads, %d openings\n", t->engines[0].name, t->engines[1].name, t->num_games, threads,
+           t->num_openings);
+
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, worker, t);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    if (t->pgn != NULL) {
+        fclose(t->pgn);
+    }
+
+    if (stats_path != NULL) {
+        FILE *f = fopen(stats_path, "a");
+
+        if (f == NULL) {
+            printf("Failed to open %s\n", stats_path);
+        } else {
+            SearchStats_write_json(&t->stats[0], t->engines[0].name, f);
+            SearchStats_write_json(&t->stats[1], t->engines[1].name, f);
+            fclose(f);
+        }
+    }
+
+    pthread_mutex_destroy(&t->lock);
+    free(workers);
+    free(t);
+
+    return 0;
+}
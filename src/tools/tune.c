@@ -0,0 +1,767 @@
+// Texel tuning of the material and piece square tables in src/chess/eval_params.h.
+//
+//   ./bin/tune --threads 8 --epochs 50 --out src/chess/eval_params.h positions.epd
+//
+// One position per line: a FEN followed by the game result, as "1-0" / "0-1" / "1/2-1/2"
+// anywhere after the FEN (EPD c9 "1-0"; works) or as a score for white at the end of the line
+// ("[0.5]", "| 1.0"). Every position is first resolved to a quiet one with a capture search on
+// the current evaluation, positions with the side to move in check are skipped. What is kept
+// is only the leaf's pieces, packed as 16 bit features, so ten million positions take a few
+// hundred MB.
+//
+// The evaluation is linear in the parameters: white minus black of mg / eg per (piece, square),
+// blended by the phase. The error is the mean of (result - sigmoid(k * eval))^2, k is fitted to
+// the starting parameters first, then the parameters are moved by Adam on shuffled mini-batches.
+// The gradient of a batch is summed by all threads, each over its own slice.
+//
+// The header is written after every epoch, same layout as eval_params.h, so stopping early still
+// leaves usable tables. Piece values are the average of the tuned (value + table) per piece, the
+// tables what is left.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../chess/eval_params.h"
+#include "../engine/engine.h"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_LINE 512
+#define MAX_PIECES 32
+#define RESOLVE_MAX_PLY 16
+
+// feature = color << 15 | type << 6 | owner relative square, see relative_square
+#define FEATURE(color, type, square) ((uint16_t)((color) << 15 | (type) << 6 | (square)))
+#define FEATURE_INDEX(feature) ((feature) & 0x1ff)
+#define FEATURE_IS_WHITE(feature) ((feature) >> 15 == ColorWhite)
+
+// mg (value + table) for every (type, square), then eg
+#define PARAMS_PER_PHASE (7 * 64)
+#define NUM_PARAMS (2 * PARAMS_PER_PHASE)
+
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+
+struct _TunePosition {
+    uint32_t first_feature;
+    uint8_t num_features;
+    uint8_t phase;
+    // in half points for white: 0, 1 or 2
+    uint8_t result;
+};
+typedef struct _TunePosition TunePosition;
+
+struct _PositionSet {
+    TunePosition *positions;
+    long count;
+    long capacity;
+
+    uint16_t *features;
+    long num_features;
+    long features_capacity;
+
+    long skipped;
+};
+typedef struct _PositionSet PositionSet;
+
+// A slice of the input file for one loading thread
+struct _Loader {
+    const char *start;
+    const char *end;
+    PositionSet set;
+    pthread_t thread;
+};
+typedef struct _Loader Loader;
+
+struct _Resolver {
+    Chess stack[RESOLVE_MAX_PLY + 1];
+    Move pv[RESOLVE_MAX_PLY][RESOLVE_MAX_PLY];
+    int pv_length[RESOLVE_MAX_PLY];
+};
+typedef struct _Resolver Resolver;
+
+struct _Tuner {
+    PositionSet set;
+    // shuffled once, the batches take consecutive runs of it
+    uint32_t *order;
+
+    double params[NUM_PARAMS];
+    double k;
+
+    int threads;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    bool quit;
+
+    // set by the main thread before releasing the workers. With gradient off they only sum the error
+    long batch_start;
+    long batch_end;
+    bool gradient;
+
+    struct {
+        pthread_t thread;
+        double gradient[NUM_PARAMS];
+        double error;
+    } workers[];
+};
+typedef struct _Tuner Tuner;
+
+static void usage(const char *name) {
+    printf("Usage: %s [--threads <n>] [--epochs <n>] [--batch <positions>] [--rate <cp>] [--out <header>] <file>...\n", name);
+}
+
+static const char *const PieceNames[7] = {"UndefPieceType", "King", "Queen", "Rook", "Bishop", "Knight", "Pawn"};
+
+// Positions
+
+static void reserve(void **data, long *capacity, long needed, size_t size) {
+    if (needed <= *capacity) {
+        return;
+    }
+
+    long grown = *capacity ? *capacity : 4096;
+
+    while (grown < needed) {
+        grown *= 2;
+    }
+
+    *data = realloc(*data, grown * size);
+    *capacity = grown;
+
+    if (*data == NULL) {
+        printf("Failed to allocate %ld positions\n", grown);
+        exit(1);
+    }
+}
+
+static void add_position(PositionSet *set, const Chess *game, int result) {
+    reserve((void **)&set->positions, &set->capacity, set->count + 1, sizeof(TunePosition));
+    reserve((void **)&set->features, &set->features_capacity, set->num_features + MAX_PIECES, sizeof(uint16_t));
+
+    TunePosition *position = &set->positions[set->count++];
+    *position = (TunePosition){
+        .first_feature = (uint32_t)set->num_features,
+        .phase = game->eval_phase > EVAL_MAX_PHASE ? EVAL_MAX_PHASE : game->eval_phase,
+        .result = result,
+    };
+
+    for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+        for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+            const Piece *piece = &game->board[row][col].piece;
+
+            if (piece->type != UndefPieceType && position->num_features < MAX_PIECES) {
+                int square = relative_square(game, piece->color, (Pos){row, col});
+                set->features[set->num_features++] = FEATURE(piece->color, piece->type, square);
+                position->num_features++;
+            }
+        }
+    }
+}
+
+// Capture search on the compiled in evaluation, keeps the principal variation so the quiet leaf
+// can be replayed
+static int resolve(Resolver *resolver, int ply, int alpha, int beta) {
+    Chess *game = &resolver->stack[ply];
+    int stand_pat = Chess_evaluate(game);
+
+    resolver->pv_length[ply] = 0;
+
+    if (ply >= RESOLVE_MAX_PLY - 1 || stand_pat >= beta) {
+        return stand_pat;
+    }
+
+    if (stand_pat > alpha) {
+        alpha = stand_pat;
+    }
+
+    Move moves[ENGINE_MAX_MOVES];
+    int scores[ENGINE_MAX_MOVES];
+    int n = Engine_generate_moves(game, moves);
+    int captures = 0;
+
+    // most valuable victim first, the piece types are ordered from king to pawn
+    for (int i = 0; i < n; i++) {
+        const Piece *victim = &game->board[moves[i].to.row][moves[i].to.col].piece;
+        const Piece *attacker = &game->board[moves[i].from.row][moves[i].from.col].piece;
+
+        if (victim->type != UndefPieceType) {
+            moves[captures] = moves[i];
+            scores[captures++] = (Pawn - victim->type) * 8 + attacker->type;
+        }
+    }
+
+    for (int i = 0; i < captures; i++) {
+        int best = i;
+
+        for (int j = i + 1; j < captures; j++) {
+            best = scores[j] > scores[best] ? j : best;
+        }
+
+        Move move = moves[best];
+        moves[best] = moves[i];
+        scores[best] = scores[i];
+
+        if (!Engine_make_move(&resolver->stack[ply + 1], game, move)) {
+            continue;
+        }
+
+        int score = -resolve(resolver, ply + 1, -beta, -alpha);
+
+        if (score >= beta) {
+            return score;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+            resolver->pv[ply][0] = move;
+            memcpy(&resolver->pv[ply][1], resolver->pv[ply + 1], resolver->pv_length[ply + 1] * sizeof(Move));
+            resolver->pv_length[ply] = resolver->pv_length[ply + 1] + 1;
+        }
+    }
+
+    return alpha;
+}
+
+// Half points for white, -1 when the line has no result
+static int parse_result(const char *line) {
+    // skip the board, side, castling and en passant fields
+    const char *tail = line;
+
+    for (int field = 0; field < 4 && *tail != '\0'; field++) {
+        tail += strspn(tail, " \t");
+        tail += strcspn(tail, " \t");
+    }
+
+    if (strstr(tail, "1/2-1/2") != NULL) {
+        return 1;
+    }
+
+    if (strstr(tail, "1-0") != NULL) {
+        return 2;
+    }
+
+    if (strstr(tail, "0-1") != NULL) {
+        return 0;
+    }
+
+    // a score as the last token, brackets and quotes around it are fine
+    const char *last = tail + strlen(tail);
+
+    while (last > tail && strchr(" \t]\";", last[-1]) != NULL) {
+        last--;
+    }
+
+    while (last > tail && strchr(" \t[\"|,", last[-1]) == NULL) {
+        last--;
+    }
+
+    char *end;
+    double score = strtod(last, &end);
+
+    if (end == last || (score != 0 && score != 0.5 && score != 1)) {
+        return -1;
+    }
+
+    return (int)(score * 2);
+}
+
+static void *load_thread(void *arg) {
+    Loader *loader = arg;
+    Game *game = Game_new();
+    Resolver *resolver = malloc(sizeof(Resolver));
+
+    if (resolver == NULL) {
+        printf("Failed to allocate a resolver\n");
+        exit(1);
+    }
+
+    for (int i = 0; i <= RESOLVE_MAX_PLY; i++) {
+        Engine_init_chess(&resolver->stack[i]);
+    }
+
+    char line[MAX_LINE];
+
+    for (const char *p = loader->start; p < loader->end;) {
+        const char *newline = memchr(p, '\n', loader->end - p);
+        const char *end = newline != NULL ? newline : loader->end;
+        size_t len = end - p < MAX_LINE ? (size_t)(end - p) : MAX_LINE - 1;
+
+        memcpy(line, p, len);
+        line[len] = '\0';
+        p = end + 1;
+
+        if (line[0] == '#' || line[strspn(line, " \t\r")] == '\0') {
+            continue;
+        }
+
+        int result = parse_result(line);
+
+        if (result < 0 || !Game_load_fen(game, line) || Engine_in_check(&game->chess, game->chess.current_turn)) {
+            loader->set.skipped++;
+            continue;
+        }
+
+        Chess_copy(&resolver->stack[0], &game->chess);
+        resolve(resolver, 0, -ENGINE_INF, ENGINE_INF);
+
+        for (int ply = 0; ply < resolver->pv_length[0]; ply++) {
+            Engine_make_move(&resolver->stack[ply + 1], &resolver->stack[ply], resolver->pv[0][ply]);
+        }
+
+        add_position(&loader->set, &resolver->stack[resolver->pv_length[0]], result);
+    }
+
+    for (int i = 0; i <= RESOLVE_MAX_PLY; i++) {
+        Engine_free_chess(&resolver->stack[i]);
+    }
+
+    free(resolver);
+    Game_free(game);
+
+    return NULL;
+}
+
+// Every thread takes a slice of the file cut at line ends, the slices are appended in order
+static void load_file(PositionSet *set, const char *path, int threads) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Failed to open %s\n", path);
+        exit(1);
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        printf("Failed to map %s\n", path);
+        exit(1);
+    }
+
+    Loader *loaders = calloc(threads, sizeof(Loader));
+    const char *end = data + st.st_size;
+    const char *p = data;
+
+    for (int i = 0; i < threads; i++) {
+        const char *cut = i == threads - 1 ? end : data + st.st_size * (i + 1) / threads;
+        const char *newline = cut < p ? NULL : memchr(cut, '\n', end - cut);
+
+        loaders[i].start = p;
+        loaders[i].end = cut < p ? p : newline != NULL ? newline + 1 : end;
+        p = loaders[i].end;
+
+        pthread_create(&loaders[i].thread, NULL, load_thread, &loaders[i]);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(loaders[i].thread, NULL);
+
+        const PositionSet *part = &loaders[i].set;
+
+        reserve((void **)&set->positions, &set->capacity, set->count + part->count, sizeof(TunePosition));
+        reserve((void **)&set->features, &set->features_capacity, set->num_features + part->num_features, sizeof(uint16_t));
+
+        for (long j = 0; j < part->count; j++) {
+            set->positions[set->count + j] = part->positions[j];
+            set->positions[set->count + j].first_feature += (uint32_t)set->num_features;
+        }
+
+        memcpy(set->features + set->num_features, part->features, part->num_features * sizeof(uint16_t));
+
+        set->count += part->count;
+        set->num_features += part->num_features;
+        set->skipped += part->skipped;
+
+        free(part->positions);
+        free(part->features);
+    }
+
+    munmap((void *)data, st.st_size);
+    free(loaders);
+}
+
+// Tuning
+
+static inline double position_eval(const Tuner *tuner, const TunePosition *position) {
+    const uint16_t *features = tuner->set.features + position->first_feature;
+    double mg = 0, eg = 0;
+
+    for (int i = 0; i < position->num_features; i++) {
+        int index = FEATURE_INDEX(features[i]);
+        double sign = FEATURE_IS_WHITE(features[i]) ? 1 : -1;
+
+        mg += sign * tuner->params[index];
+        eg += sign * tuner->params[PARAMS_PER_PHASE + index];
+    }
+
+    return (mg * position->phase + eg * (EVAL_MAX_PHASE - position->phase)) / EVAL_MAX_PHASE;
+}
+
+struct _WorkerArg {
+    Tuner *tuner;
+    int index;
+};
+typedef struct _WorkerArg WorkerArg;
+
+static void worker_slice(Tuner *tuner, int index) {
+    long count = tuner->batch_end - tuner->batch_start;
+    long first = tuner->batch_start + count * index / tuner->threads;
+    long last = tuner->batch_start + count * (index + 1) / tuner->threads;
+
+    double *gradient = tuner->workers[index].gradient;
+    double error = 0;
+
+    if (tuner->gradient) {
+        memset(gradient, 0, sizeof(tuner->workers[index].gradient));
+    }
+
+    for (long i = first; i < last; i++) {
+        const TunePosition *position = &tuner->set.positions[tuner->order[i]];
+        double sigmoid = 1 / (1 + exp(-tuner->k * position_eval(tuner, position)));
+        double diff = position->result / 2. - sigmoid;
+
+        error += diff * diff;
+
+        if (!tuner->gradient) {
+            continue;
+        }
+
+        // d error / d eval, the mg / eg parts are scaled by the phase
+        double slope = -2 * diff * sigmoid * (1 - sigmoid) * tuner->k;
+        double mg = slope * position->phase / EVAL_MAX_PHASE;
+        double eg = slope * (EVAL_MAX_PHASE - position->phase) / EVAL_MAX_PHASE;
+        const uint16_t *features = tuner->set.features + position->first_feature;
+
+        for (int j = 0; j < position->num_features; j++) {
+            int feature_index = FEATURE_INDEX(features[j]);
+            double sign = FEATURE_IS_WHITE(features[j]) ? 1 : -1;
+
+            gradient[feature_index] += sign * mg;
+            gradient[PARAMS_PER_PHASE + feature_index] += sign * eg;
+        }
+    }
+
+    tuner->workers[index].error = error;
+}
+
+static void *tune_thread(void *arg) {
+    WorkerArg *worker = arg;
+    Tuner *tuner = worker->tuner;
+
+    for (;;) {
+        pthread_barrier_wait(&tuner->start);
+
+        if (tuner->quit) {
+            break;
+        }
+
+        worker_slice(tuner, worker->index);
+        pthread_barrier_wait(&tuner->done);
+    }
+
+    return NULL;
+}
+
+// Runs one batch on all threads (the calling one is worker 0), returns the summed error
+static double run_batch(Tuner *tuner, long start, long end, bool gradient) {
+    tuner->batch_start = start;
+    tuner->batch_end = end;
+    tuner->gradient = gradient;
+
+    pthread_barrier_wait(&tuner->start);
+    worker_slice(tuner, 0);
+    pthread_barrier_wait(&tuner->done);
+
+    double error = 0;
+
+    for (int i = 0; i < tuner->threads; i++) {
+        error += tuner->workers[i].error;
+    }
+
+    return error;
+}
+
+static double total_error(Tuner *tuner) { return run_batch(tuner, 0, tuner->set.count, false) / tuner->set.count; }
+
+// Golden section search of the sigmoid scale on the starting parameters
+static void fit_k(Tuner *tuner) {
+    const double ratio = (sqrt(5) - 1) / 2;
+    double low = 0.0001, high = 0.05;
+
+    for (int i = 0; i < 40; i++) {
+        double a = high - ratio * (high - low);
+        double b = low + ratio * (high - low);
+
+        tuner->k = a;
+        double error_a = total_error(tuner);
+        tuner->k = b;
+        double error_b = total_error(tuner);
+
+        if (error_a < error_b) {
+            high = b;
+        } else {
+            low = a;
+        }
+    }
+
+    tuner->k = (low + high) / 2;
+}
+
+// Output
+
+static void print_values(FILE *out, const char *name, const int values[7]) {
+    fprintf(out, "static const int %s[7] = {", name);
+
+    for (int type = 0; type < 7; type++) {
+        fprintf(out, "%s%d", type ? ", " : "", values[type]);
+    }
+
+    fprintf(out, "};\n");
+}
+
+static void print_tables(FILE *out, const char *name, int tables[7][64]) {
+    fprintf(out, "static const int %s[7][64] = {\n    // UndefPieceType\n    {0},\n", name);
+
+    for (int type = King; type <= Pawn; type++) {
+        fprintf(out, "    // %s\n    {\n", PieceNames[type]);
+
+        for (int row = 0; row < CHESS_BOARD_ROWS; row++) {
+            fprintf(out, "       ");
+
+            for (int col = 0; col < CHESS_BOARD_COLS; col++) {
+                fprintf(out, "%4d,", tables[type][row * CHESS_BOARD_COLS + col]);
+            }
+
+            fprintf(out, "\n");
+        }
+
+        fprintf(out, "    },\n");
+    }
+
+    fprintf(out, "};\n");
+}
+
+// Splits (value + table) back into a piece value, the average over the squares the piece can
+// stand on, and the table. Kings keep a value of 0, pawns never stand on the first or last rank
+static void split_params(const double *params, int values[7], int tables[7][64]) {
+    values[UndefPieceType] = 0;
+
+    for (int type = King; type <= Pawn; type++) {
+        int first = type == Pawn ? CHESS_BOARD_COLS : 0;
+        int last = type == Pawn ? 64 - CHESS_BOARD_COLS : 64;
+        double sum = 0;
+
+        for (int square = first; square < last; square++) {
+            sum += params[type * 64 + square];
+        }
+
+        values[type] = type == King ? 0 : (int)lround(sum / (last - first));
+
+        for (int square = 0; square < 64; square++) {
+            tables[type][square] = square < first || square >= last ? 0 : (int)lround(params[type * 64 + square]) - values[type];
+        }
+    }
+}
+
+static bool write_header(const Tuner *tuner, const char *path) {
+    static int mg_tables[7][64], eg_tables[7][64];
+    int mg_values[7], eg_values[7];
+
+    split_params(tuner->params, mg_values, mg_tables);
+    split_params(tuner->params + PARAMS_PER_PHASE, eg_values, eg_tables);
+
+    FILE *out = fopen(path, "w");
+
+    if (out == NULL) {
+        return false;
+    }
+
+    fprintf(out, "// Evaluation parameters, indexed by enum PieceType.\n");
+    fprintf(out, "// Piece square tables are laid out from the piece owner's point of view,\n");
+    fprintf(out, "// index 0 = a8 ... index 63 = h1 for white (mirrored for black).\n");
+    fprintf(out, "// Values tuned by src/tools/tune.c on %ld positions.\n\n", tuner->set.count);
+
+    fprintf(out, "#ifndef CHESS_EVAL_PARAMS__\n#define CHESS_EVAL_PARAMS__\n\n");
+    fprintf(out, "// clang-format off\n");
+    print_values(out, "EvalMgValue", mg_values);
+    print_values(out, "EvalEgValue", eg_values);
+
+    fprintf(out, "\n// contribution of each piece to the game phase, EVAL_MAX_PHASE = all pieces on board\n");
+    fprintf(out, "#define EVAL_MAX_PHASE %d\n", EVAL_MAX_PHASE);
+    print_values(out, "EvalPhaseInc", EvalPhaseInc);
+
+    fprintf(out, "\n");
+    print_tables(out, "EvalMgTable", mg_tables);
+    fprintf(out, "\n");
+    print_tables(out, "EvalEgTable", eg_tables);
+    fprintf(out, "// clang-format on\n\n#endif // !CHESS_EVAL_PARAMS__\n");
+
+    return fclose(out) == 0;
+}
+
+int main(int argc, char **argv) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int epochs = 20;
+    long batch = 65536;
+    double rate = 1;
+    const char *out = "eval_params.h";
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            first_file = i;
+            break;
+        }
+
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+
+        if (strcmp(argv[i - 1], "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(argv[i - 1], "--epochs") == 0) {
+            epochs = atoi(value);
+        } else if (strcmp(argv[i - 1], "--batch") == 0) {
+            batch = atol(value);
+        } else if (strcmp(argv[i - 1], "--rate") == 0) {
+            rate = atof(value);
+        } else if (strcmp(argv[i - 1], "--out") == 0) {
+            out = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (first_file == argc || threads < 1 || epochs < 1 || batch < 1 || rate <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Tuner *tuner = calloc(1, sizeof(Tuner) + threads * sizeof(tuner->workers[0]));
+    tuner->threads = threads;
+
+    uint64_t start = Engine_now_ns();
+
+    for (int i = first_file; i < argc; i++) {
+        load_file(&tuner->set, argv[i], threads);
+    }
+
+    long count = tuner->set.count;
+
+    printf("%ld positions (%ld skipped), %.1f MB, loaded in %.2f s\n", count, tuner->set.skipped,
+           (count * sizeof(TunePosition) + tuner->set.num_features * sizeof(uint16_t)) / 1e6, (Engine_now_ns() - start) / 1e9);
+
+    if (count == 0) {
+        return 1;
+    }
+
+    // fixed seed, the same input gives the same tables
+    tuner->order = malloc(count * sizeof(uint32_t));
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+    for (long i = 0; i < count; i++) {
+        tuner->order[i] = (uint32_t)i;
+    }
+
+    for (long i = count - 1; i > 0; i--) {
+        seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+        long j = (long)(seed % (uint64_t)(i + 1));
+        uint32_t swap = tuner->order[i];
+        tuner->order[i] = tuner->order[j];
+        tuner->order[j] = swap;
+    }
+
+    for (int type = King; type <= Pawn; type++) {
+        for (int square = 0; square < 64; square++) {
+            tuner->params[type * 64 + square] = EvalMgValue[type] + EvalMgTable[type][square];
+            tuner->params[PARAMS_PER_PHASE + type * 64 + square] = EvalEgValue[type] + EvalEgTable[type][square];
+        }
+    }
+
+    pthread_barrier_init(&tuner->start, NULL, threads);
+    pthread_barrier_init(&tuner->done, NULL, threads);
+
+    WorkerArg *args = calloc(threads, sizeof(WorkerArg));
+
+    for (int i = 1; i < threads; i++) {
+        args[i] = (WorkerArg){tuner, i};
+        pthread_create(&tuner->workers[i].thread, NULL, tune_thread, &args[i]);
+    }
+
+    fit_k(tuner);
+    printf("k = %.6f, error %.6f\n", tuner->k, total_error(tuner));
+
+    static double m[NUM_PARAMS], v[NUM_PARAMS];
+    long step = 0;
+
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        uint64_t epoch_start = Engine_now_ns();
+        double error = 0;
+
+        for (long first = 0; first < count; first += batch) {
+            long last = first + batch < count ? first + batch : count;
+            error += run_batch(tuner, first, last, true);
+            step++;
+
+            double correction1 = 1 - pow(ADAM_BETA1, step);
+            double correction2 = 1 - pow(ADAM_BETA2, step);
+
+            for (int i = 0; i < NUM_PARAMS; i++) {
+                double gradient = 0;
+
+                for (int t = 0; t < threads; t++) {
+                    gradient += tuner->workers[t].gradient[i];
+                }
+
+                gradient /= last - first;
+                m[i] = ADAM_BETA1 * m[i] + (1 - ADAM_BETA1) * gradient;
+                v[i] = ADAM_BETA2 * v[i] + (1 - ADAM_BETA2) * gradient * gradient;
+                tuner->params[i] -= rate * (m[i] / correction1) / (sqrt(v[i] / correction2) + ADAM_EPSILON);
+            }
+        }
+
+        if (!write_header(tuner, out)) {
+            printf("Failed to write %s\n", out);
+            return 1;
+        }
+
+        printf("epoch %d: error %.6f, %.2f s\n", epoch, error / count, (Engine_now_ns() - epoch_start) / 1e9);
+        fflush(stdout);
+    }
+
+    printf("final error %.6f, written to %s\n", total_error(tuner), out);
+
+    tuner->quit = true;
+    pthread_barrier_wait(&tuner->start);
+
+    for (int i = 1; i < threads; i++) {
+        pthread_join(tuner->workers[i].thread, NULL);
+    }
+
+    pthread_barrier_destroy(&tuner->start);
+    pthread_barrier_destroy(&tuner->done);
+    free(args);
+    free(tuner->order);
+    free(tuner->set.positions);
+    free(tuner->set.features);
+    free(tuner);
+
+    return 0;
+}